@@ -0,0 +1,543 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BandDecompositions.h>
+#include <mlsm/BatchedBlockMatrix.h>
+#include <mlsm/BlockGivensQR.h>
+#include <mlsm/BlockMatrix.h>
+#include <mlsm/BlockTriDiagonalCholesky.h>
+#include <mlsm/FixedMatrix.h>
+#include <mlsm/SimpleMatrix.h>
+
+#include <Eigen/Cholesky>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+
+using namespace mls;
+
+// Unless specified otherwise, the benchmarks below use square band block matrices with
+// range(0): number of blocks, range(1): size of the blocks, range(2): bandwidth (lower and upper).
+namespace
+{
+struct BandParam
+{
+  explicit BandParam(const benchmark::State & state)
+  : n(static_cast<int>(state.range(0))), s(static_cast<int>(state.range(1))), b(static_cast<int>(state.range(2)))
+  {}
+  BandParam(int n, int s, int b) : n(n), s(s), b(b) {}
+  int n; // number of blocks
+  int s; // size of the blocks
+  int b; // bandwidth
+};
+
+// Band block matrix with random dense blocks
+std::shared_ptr<BlockMatrix> randomBandMatrix(const BandParam & p)
+{
+  auto M = std::make_shared<BandBlockMatrix>(p.n, p.n, p.b, p.b);
+  for(int c = 0; c < p.n; ++c)
+  {
+    for(int r = std::max(0, c - p.b); r < std::min(p.n, c + p.b + 1); ++r)
+      M->setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(p.s, p.s), true));
+  }
+  M->updateSize();
+  return M;
+}
+
+// Same as randomBandMatrix, with blocks stored in single precision
+std::shared_ptr<BlockMatrix> randomFloatBandMatrix(const BandParam & p)
+{
+  auto M = std::make_shared<BandBlockMatrix>(p.n, p.n, p.b, p.b);
+  for(int c = 0; c < p.n; ++c)
+  {
+    for(int r = std::max(0, c - p.b); r < std::min(p.n, c + p.b + 1); ++r)
+      M->setBlock(r, c, std::make_shared<FloatDenseMatrix>(Eigen::MatrixXd::Random(p.s, p.s)));
+  }
+  M->updateSize();
+  return M;
+}
+
+// Same as randomBandMatrix, with blocks of size S x S known at compile time (p.s is ignored)
+template<int S>
+std::shared_ptr<BlockMatrix> randomFixedBandMatrix(const BandParam & p)
+{
+  auto M = std::make_shared<BandBlockMatrix>(p.n, p.n, p.b, p.b);
+  for(int c = 0; c < p.n; ++c)
+  {
+    for(int r = std::max(0, c - p.b); r < std::min(p.n, c + p.b + 1); ++r)
+      M->setBlock(r, c, std::make_shared<FixedDenseMatrix<S, S>>(Eigen::Matrix<double, S, S>::Random()));
+  }
+  M->updateSize();
+  return M;
+}
+
+void setCounters(benchmark::State & state, const BlockMatrix & M)
+{
+  state.counters["rows"] = M.rows();
+  state.counters["blocks"] = static_cast<double>(M.storageScheme().size());
+}
+
+const std::vector<std::vector<int64_t>> bandArgs = {{10, 100, 1000}, {3, 6, 12}, {1, 2}};
+} // namespace
+
+// Construction with a copy of the data of each block
+static void BM_Construction(benchmark::State & state)
+{
+  BandParam p(state);
+  Eigen::MatrixXd A = Eigen::MatrixXd::Random(p.s, p.s);
+
+  for(auto _ : state)
+  {
+    BandBlockMatrix M(p.n, p.n, p.b, p.b);
+    for(int c = 0; c < p.n; ++c)
+    {
+      for(int r = std::max(0, c - p.b); r < std::min(p.n, c + p.b + 1); ++r)
+        M.setBlock(r, c, std::make_shared<DenseMatrix>(A, true));
+    }
+    M.updateSize();
+    benchmark::DoNotOptimize(M.rows());
+  }
+}
+
+// Construction with all the blocks in a single buffer
+static void BM_ArenaConstruction(benchmark::State & state)
+{
+  BandParam p(state);
+  for(auto _ : state)
+  {
+    BandBlockMatrix M(p.n, p.n, p.b, p.b);
+    for(int i = 0; i < p.n; ++i)
+    {
+      M.setRowsOfBlock(i, p.s);
+      M.setColsOfBlock(i, p.s);
+    }
+    M.allocateArena();
+    benchmark::DoNotOptimize(M.rows());
+  }
+}
+
+// Derivation of the sizes, the structure being marked as changed before each update
+static void BM_UpdateSizeDirty(benchmark::State & state)
+{
+  auto M = randomBandMatrix(BandParam(state));
+  for(auto _ : state)
+  {
+    M->invalidateSize();
+    M->updateSize();
+  }
+  setCounters(state, *M);
+}
+
+// Update of a matrix whose structure did not change since the last update
+static void BM_UpdateSizeClean(benchmark::State & state)
+{
+  auto M = randomBandMatrix(BandParam(state));
+  for(auto _ : state)
+    M->updateSize();
+  setCounters(state, *M);
+}
+
+static void BM_ToDense(benchmark::State & state)
+{
+  auto M = randomBandMatrix(BandParam(state));
+  Eigen::MatrixXd D(M->rows(), M->cols());
+  for(auto _ : state)
+  {
+    M->toDense(D, false);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+// range(3): number of threads
+static void BM_ToDenseParallel(benchmark::State & state)
+{
+  auto M = randomBandMatrix(BandParam(state));
+  Eigen::MatrixXd D(M->rows(), M->cols());
+  for(auto _ : state)
+  {
+    M->toDenseParallel(D, false, static_cast<int>(state.range(3)));
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+// Access to all the blocks, stored or not, with block (range(3) = 0) or blockView (range(3) = 1).
+// The matrix is shared by all the threads.
+static void BM_BlockTraversal(benchmark::State & state)
+{
+  static std::shared_ptr<BlockMatrix> M;
+  if(state.thread_index() == 0)
+    M = randomBandMatrix(BandParam(state));
+  const bool view = state.range(3);
+  for(auto _ : state)
+  {
+    int rows = 0;
+    for(int c = 0; c < M->blkCols(); ++c)
+    {
+      for(int r = 0; r < M->blkRows(); ++r)
+        rows += view ? M->blockView(r, c).rows() : static_cast<const BlockMatrix &>(*M).block(r, c).rows();
+    }
+    benchmark::DoNotOptimize(rows);
+  }
+  if(state.thread_index() == 0)
+    setCounters(state, *M);
+}
+
+// Access to all the elements of the band, column by column
+static void BM_CoeffAccess(benchmark::State & state)
+{
+  BandParam p(state);
+  auto M = randomBandMatrix(p);
+  const MatrixBase & A = *M;
+  const int w = p.s * (p.b + 1);
+  for(auto _ : state)
+  {
+    double sum = 0;
+    for(int j = 0; j < A.cols(); ++j)
+    {
+      for(int i = std::max(0, j - w); i < std::min(A.rows(), j + w); ++i)
+        sum += A(i, j);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  setCounters(state, *M);
+}
+
+static void BM_StorageIndex(benchmark::State & state)
+{
+  BandParam p(state);
+  auto M = randomBandMatrix(p);
+  const auto & S = M->storageScheme();
+  for(auto _ : state)
+  {
+    long sum = 0;
+    for(int c = 0; c < p.n; ++c)
+    {
+      for(int r = std::max(0, c - p.b - 1); r < std::min(p.n, c + p.b + 2); ++r)
+        sum += S.index(r, c).first;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  setCounters(state, *M);
+}
+
+// range(3): whether to compute the transposed product
+static void BM_MatrixVectorProduct(benchmark::State & state)
+{
+  auto M = randomBandMatrix(BandParam(state));
+  const bool transpose = state.range(3);
+  Eigen::VectorXd x = Eigen::VectorXd::Random(M->cols());
+  Eigen::VectorXd y(M->rows());
+  for(auto _ : state)
+  {
+    M->multiply(x, y, 1, 0, transpose);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+// range(3): whether to compute the transposed product
+static void BM_FloatMatrixVectorProduct(benchmark::State & state)
+{
+  auto M = randomFloatBandMatrix(BandParam(state));
+  const bool transpose = state.range(3);
+  Eigen::VectorXd x = Eigen::VectorXd::Random(M->cols());
+  Eigen::VectorXd y(M->rows());
+  for(auto _ : state)
+  {
+    M->multiply(x, y, 1, 0, transpose);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+static void BM_MatrixMatrixProduct(benchmark::State & state)
+{
+  BandParam p(state);
+  auto A = randomBandMatrix(p);
+  auto B = randomBandMatrix(p);
+  for(auto _ : state)
+  {
+    auto C = mult(*A, *B);
+    benchmark::DoNotOptimize(C.get());
+  }
+  setCounters(state, *A);
+}
+
+// Same as BM_MatrixVectorProduct and BM_MatrixMatrixProduct with fixed-size blocks.
+// range(0): number of blocks, range(1): bandwidth, S: size of the blocks
+template<int S>
+static void BM_FixedMatrixVectorProduct(benchmark::State & state)
+{
+  auto M = randomFixedBandMatrix<S>(BandParam(static_cast<int>(state.range(0)), S, static_cast<int>(state.range(1))));
+  Eigen::VectorXd x = Eigen::VectorXd::Random(M->cols());
+  Eigen::VectorXd y(M->rows());
+  for(auto _ : state)
+  {
+    M->multiply(x, y, 1, 0, false);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+template<int S>
+static void BM_FixedMatrixMatrixProduct(benchmark::State & state)
+{
+  BandParam p(static_cast<int>(state.range(0)), S, static_cast<int>(state.range(1)));
+  auto A = randomFixedBandMatrix<S>(p);
+  auto B = randomFixedBandMatrix<S>(p);
+  for(auto _ : state)
+  {
+    auto C = mult(*A, *B);
+    benchmark::DoNotOptimize(C.get());
+  }
+  setCounters(state, *A);
+}
+
+// Symmetric positive definite block tridiagonal matrix, with the lower part stored
+static std::shared_ptr<BlockMatrix> randomTriDiagonalSPD(int n, int s)
+{
+  auto M = std::make_shared<TriDiagonalBlockMatrix>(n, true, false);
+  for(int i = 0; i < n; ++i)
+  {
+    Eigen::MatrixXd A = Eigen::MatrixXd::Random(s, s);
+    M->setBlock(i, i, std::make_shared<DenseMatrix>(A * A.transpose() + 4 * s * Eigen::MatrixXd::Identity(s, s), true));
+    if(i + 1 < n)
+      M->setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(s, s), true));
+  }
+  M->updateSize();
+  return M;
+}
+
+// Factorization and solve of a block tridiagonal matrix.
+// range(0): number of blocks, range(1): size of the blocks, range(2): number of right-hand sides
+static void BM_TriDiagonalCholeskyCompute(benchmark::State & state)
+{
+  auto M = randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  BlockTriDiagonalCholesky llt;
+  for(auto _ : state)
+    llt.compute(*M);
+  setCounters(state, *M);
+}
+
+// Numeric phase only, the pattern being analyzed once
+static void BM_TriDiagonalCholeskyFactorize(benchmark::State & state)
+{
+  auto M = randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  BlockTriDiagonalCholesky llt;
+  llt.analyzePattern(*M);
+  for(auto _ : state)
+    llt.factorize(*M);
+  setCounters(state, *M);
+}
+
+static void BM_TriDiagonalCholeskySolve(benchmark::State & state)
+{
+  auto M = randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  BlockTriDiagonalCholesky llt(*M);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(M->rows(), state.range(2));
+  Eigen::MatrixXd X(B.rows(), B.cols());
+  for(auto _ : state)
+  {
+    X = B;
+    llt.solveInPlace(X);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+// Solve with a single precision factorization and iterative refinement
+static void BM_MixedPrecisionSolve(benchmark::State & state)
+{
+  auto M = randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  MixedPrecisionBlockTriDiagonalSolver solver(*M);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(M->rows(), state.range(2));
+  Eigen::MatrixXd X(B.rows(), B.cols());
+  for(auto _ : state)
+  {
+    X = B;
+    solver.solveInPlace(*M, X);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+// Factorization and solve of a batch of block tridiagonal matrices with the same structure.
+// range(0): number of blocks, range(1): size of the blocks, range(2): size of the batch.
+// BM_LoopCholesky processes the matrices one by one, BM_BatchedCholesky all at once.
+static void BM_LoopCholesky(benchmark::State & state)
+{
+  std::vector<std::shared_ptr<BlockMatrix>> M;
+  std::vector<BlockTriDiagonalCholesky> llt(state.range(2));
+  for(int k = 0; k < state.range(2); ++k)
+    M.push_back(randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1))));
+  Eigen::MatrixXd X = Eigen::MatrixXd::Random(M[0]->rows(), state.range(2));
+  for(auto _ : state)
+  {
+    for(int k = 0; k < state.range(2); ++k)
+    {
+      llt[k].compute(*M[k]);
+      llt[k].solveInPlace(X.col(k));
+    }
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M[0]);
+}
+
+static void BM_BatchedCholesky(benchmark::State & state)
+{
+  auto M = randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  BatchedBlockMatrix batch(*M, static_cast<int>(state.range(2)));
+  for(int k = 0; k < batch.batchSize(); ++k)
+    batch.set(k, *randomTriDiagonalSPD(static_cast<int>(state.range(0)), static_cast<int>(state.range(1))));
+  BatchedBlockTriDiagonalCholesky llt;
+  Eigen::MatrixXd X = Eigen::MatrixXd::Random(batch.batchSize(), batch.rows());
+  for(auto _ : state)
+  {
+    llt.compute(batch);
+    llt.solveInPlace(X);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, *M);
+}
+
+// Block forward substitution with a lower triangular band matrix of bandwidth 2, with many right-hand
+// sides. range(0): number of blocks, range(1): size of the blocks, range(2): number of right-hand sides,
+// range(3): whether all the right-hand sides are solved at once (1) or one by one (0).
+static void BM_TriangularSolve(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  const int s = static_cast<int>(state.range(1));
+  BandBlockMatrix L(n, n, 2, 0);
+  for(int c = 0; c < n; ++c)
+  {
+    L.setBlock(c, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(s, s) + 2 * s * Eigen::MatrixXd::Identity(s, s), true));
+    for(int r = c + 1; r < std::min(n, c + 3); ++r)
+      L.setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(s, s), true));
+  }
+  L.updateSize();
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(L.rows(), state.range(2));
+  Eigen::MatrixXd X(B.rows(), B.cols());
+  const bool allAtOnce = state.range(3);
+  for(auto _ : state)
+  {
+    X = B;
+    if(allAtOnce)
+      solveTriangularInPlace(L, X);
+    else
+    {
+      for(int k = 0; k < X.cols(); ++k)
+        solveTriangularInPlace(L, X.col(k));
+    }
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, L);
+}
+
+// Scalar band matrices: range(0): size, range(1): bandwidth (lower and upper), range(2): whether the
+// matrix is stored as a BandMatrix (1) or a DenseMatrix (0).
+static void BM_ScalarBandMatrixVectorProduct(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  const int b = static_cast<int>(state.range(1));
+  BandMatrix B(Eigen::MatrixXd::Random(n, n), b, b);
+  DenseMatrix D(static_cast<const MatrixBase &>(B).toDense(), true);
+  const MatrixBase & M = state.range(2) ? static_cast<const MatrixBase &>(B) : D;
+  Eigen::VectorXd x = Eigen::VectorXd::Random(n);
+  Eigen::VectorXd y(n);
+  for(auto _ : state)
+  {
+    M.multiply(x, y, 1, 0, false);
+    benchmark::ClobberMemory();
+  }
+  state.counters["memory"] = static_cast<double>(state.range(2) ? B.data().size() : n * n) * sizeof(double);
+}
+
+// Factorization and solve of a symmetric positive definite scalar band matrix, with BandCholesky (range(2) = 1)
+// or a dense Cholesky (range(2) = 0).
+static void BM_ScalarBandCholesky(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  const int b = static_cast<int>(state.range(1));
+  BandMatrix A(Eigen::MatrixXd::Random(n, n), b, 0);
+  A.data().row(0).array() += 4 * b + 1;
+  Eigen::MatrixXd D = static_cast<const MatrixBase &>(A).toDense();
+  D = D.selfadjointView<Eigen::Lower>();
+  BandCholesky llt;
+  Eigen::LLT<Eigen::MatrixXd> denseLlt(n);
+  Eigen::VectorXd x = Eigen::VectorXd::Random(n);
+  for(auto _ : state)
+  {
+    if(state.range(2))
+    {
+      llt.compute(A);
+      llt.solveInPlace(x);
+    }
+    else
+    {
+      denseLlt.compute(D);
+      denseLlt.solveInPlace(x);
+    }
+    benchmark::ClobberMemory();
+  }
+}
+
+// Least squares with a stacked banded Jacobian: n + 2 rows of blocks of size 2s x s, the column of
+// blocks c appearing in the rows of blocks c to c + 2.
+// range(0): number of columns of blocks, range(1): size s.
+static void BM_GivensQRFactorize(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  const int s = static_cast<int>(state.range(1));
+  BandBlockMatrix J(n + 2, n, 2, 0);
+  for(int c = 0; c < n; ++c)
+  {
+    for(int r = c; r < c + 3; ++r)
+      J.setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2 * s, s), true));
+  }
+  J.updateSize();
+  BlockGivensQR qr;
+  qr.analyzePattern(J);
+  Eigen::VectorXd b = Eigen::VectorXd::Random(J.rows());
+  Eigen::VectorXd x(J.rows());
+  for(auto _ : state)
+  {
+    qr.factorize(J);
+    x = b;
+    qr.solveInPlace(x);
+    benchmark::ClobberMemory();
+  }
+  setCounters(state, J);
+}
+
+BENCHMARK(BM_Construction)->ArgsProduct(bandArgs);
+BENCHMARK(BM_ArenaConstruction)->ArgsProduct(bandArgs);
+BENCHMARK(BM_UpdateSizeDirty)->ArgsProduct(bandArgs);
+BENCHMARK(BM_UpdateSizeClean)->ArgsProduct(bandArgs);
+BENCHMARK(BM_ToDense)->ArgsProduct({{10, 100}, {3, 6, 12}, {1, 2}});
+BENCHMARK(BM_ToDenseParallel)->ArgsProduct({{100, 1000}, {6, 12}, {1}, {1, 2, 4}})->UseRealTime();
+BENCHMARK(BM_BlockTraversal)->ArgsProduct({{10, 100}, {3}, {1, 2}, {0, 1}})->ThreadRange(1, 4)->UseRealTime();
+BENCHMARK(BM_CoeffAccess)->ArgsProduct({{10, 100}, {3, 6, 12}, {1, 2}});
+BENCHMARK(BM_StorageIndex)->ArgsProduct(bandArgs);
+BENCHMARK(BM_MatrixVectorProduct)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}, {1, 2}, {0, 1}});
+BENCHMARK(BM_FloatMatrixVectorProduct)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}, {1, 2}, {0, 1}});
+BENCHMARK(BM_MatrixMatrixProduct)->ArgsProduct({{10, 100}, {3, 6, 12}, {1, 2}});
+BENCHMARK_TEMPLATE(BM_FixedMatrixVectorProduct, 3)->ArgsProduct({{10, 100, 1000}, {1, 2}});
+BENCHMARK_TEMPLATE(BM_FixedMatrixVectorProduct, 6)->ArgsProduct({{10, 100, 1000}, {1, 2}});
+BENCHMARK_TEMPLATE(BM_FixedMatrixVectorProduct, 12)->ArgsProduct({{10, 100, 1000}, {1, 2}});
+BENCHMARK_TEMPLATE(BM_FixedMatrixMatrixProduct, 3)->ArgsProduct({{10, 100}, {1, 2}});
+BENCHMARK_TEMPLATE(BM_FixedMatrixMatrixProduct, 6)->ArgsProduct({{10, 100}, {1, 2}});
+BENCHMARK_TEMPLATE(BM_FixedMatrixMatrixProduct, 12)->ArgsProduct({{10, 100}, {1, 2}});
+BENCHMARK(BM_TriDiagonalCholeskyCompute)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}});
+BENCHMARK(BM_TriDiagonalCholeskyFactorize)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}});
+BENCHMARK(BM_TriDiagonalCholeskySolve)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}, {1, 6}});
+BENCHMARK(BM_MixedPrecisionSolve)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}, {1, 6}});
+BENCHMARK(BM_LoopCholesky)->ArgsProduct({{10, 100}, {3, 6, 12}, {16, 256}});
+BENCHMARK(BM_BatchedCholesky)->ArgsProduct({{10, 100}, {3, 6, 12}, {16, 256}});
+BENCHMARK(BM_TriangularSolve)->ArgsProduct({{10, 100}, {3, 6, 12}, {1, 48}, {0, 1}});
+BENCHMARK(BM_ScalarBandMatrixVectorProduct)->ArgsProduct({{100, 1000}, {1, 4}, {0, 1}});
+BENCHMARK(BM_ScalarBandCholesky)->ArgsProduct({{100, 1000}, {1, 4}, {0, 1}});
+BENCHMARK(BM_GivensQRFactorize)->ArgsProduct({{10, 100, 1000}, {3, 6, 12}});
+
+BENCHMARK_MAIN();
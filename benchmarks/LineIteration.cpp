@@ -0,0 +1,122 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/internal/StorageScheme.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace mls::internal;
+
+// Count of the heap allocations made through the global operator new, to check that iterating over
+// shapes and storage schemes does not allocate.
+static std::atomic<long> allocationCount{0};
+
+static void * allocate(std::size_t size)
+{
+  ++allocationCount;
+  if(void * p = std::malloc(size > 0 ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void * operator new(std::size_t size) { return allocate(size); }
+void * operator new[](std::size_t size) { return allocate(size); }
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void * p, std::size_t) noexcept { std::free(p); }
+
+// Report the number of allocations made since start, and fail the benchmark if there were any.
+static void checkNoAllocation(benchmark::State & state, long start)
+{
+  long n = allocationCount - start;
+  state.counters["allocations"] = static_cast<double>(n);
+  if(n > 0)
+    state.SkipWithError("Iteration performed heap allocations.");
+}
+
+// range(0): number of blocks, range(1): bandwidth
+static void BM_BandShapeIteration(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  const int b = static_cast<int>(state.range(1));
+  BandShape shape(n, n, b, b);
+
+  long start = allocationCount;
+  for(auto _ : state)
+  {
+    long sum = 0;
+    for(int r = 0; r < n; ++r)
+    {
+      for(int c : shape.row(r))
+        sum += c;
+    }
+    for(int c = 0; c < n; ++c)
+    {
+      for(int r : shape.col(c))
+        sum += r;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  checkNoAllocation(state, start);
+}
+
+template<SymmetricStorage Sym>
+static void BM_BandStorageIteration(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  const int b = static_cast<int>(state.range(1));
+  BandShape shape(n, n, b, b);
+  BandStorageScheme storage(Sym);
+  storage.setShape(shape);
+
+  long start = allocationCount;
+  for(auto _ : state)
+  {
+    long sum = 0;
+    for(int r = 0; r < n; ++r)
+    {
+      for(const auto & e : storage.row(r))
+        sum += e.idx + e.tr;
+    }
+    for(int c = 0; c < n; ++c)
+    {
+      for(const auto & e : storage.col(c))
+        sum += e.idx + e.tr;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  checkNoAllocation(state, start);
+}
+
+static void BM_DenseStorageIteration(benchmark::State & state)
+{
+  const int n = static_cast<int>(state.range(0));
+  DenseShape shape(n, n);
+  DenseStorageScheme storage;
+  storage.setShape(shape);
+
+  long start = allocationCount;
+  for(auto _ : state)
+  {
+    long sum = 0;
+    for(int r = 0; r < n; ++r)
+    {
+      for(const auto & e : storage.row(r))
+        sum += e.idx;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  checkNoAllocation(state, start);
+}
+
+BENCHMARK(BM_BandShapeIteration)->ArgsProduct({{10, 100, 1000}, {0, 1, 4}});
+BENCHMARK_TEMPLATE(BM_BandStorageIteration, SymmetricStorage::None)->ArgsProduct({{10, 100, 1000}, {0, 1, 4}});
+BENCHMARK_TEMPLATE(BM_BandStorageIteration, SymmetricStorage::Upper)->ArgsProduct({{10, 100, 1000}, {0, 1, 4}});
+BENCHMARK_TEMPLATE(BM_BandStorageIteration, SymmetricStorage::Lower)->ArgsProduct({{10, 100, 1000}, {0, 1, 4}});
+BENCHMARK(BM_DenseStorageIteration)->Arg(10)->Arg(100);
+
+BENCHMARK_MAIN();
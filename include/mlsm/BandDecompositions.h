@@ -0,0 +1,102 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/SimpleMatrix.h>
+
+#include <vector>
+
+namespace mls
+{
+/** LU factorization with partial pivoting P A = L U of a square BandMatrix (as LAPACK's gbtrf).
+ *
+ * With l and u the lower and upper bandwidths of A, L is unit lower triangular with at most l non-zero
+ * elements below the diagonal in each column, and U is upper triangular with bandwidth l + u (row
+ * exchanges causing a fill-in of l superdiagonals). The factors are stored packed, in a
+ * (2l + u + 1) x n matrix, so that the factorization and the solves cost O(n l (l + u)) and O(n (l + u))
+ * respectively.
+ *
+ * Factorizing a matrix with the same size and bandwidths as the previous one does not allocate.
+ */
+class MLSM_DLLAPI BandLU
+{
+public:
+  BandLU() = default;
+  explicit BandLU(const BandMatrix & A) { compute(A); }
+
+  /** Compute the factorization of \p A.
+   *
+   * \throw std::runtime_error if A is not square, or is singular.
+   */
+  void compute(const BandMatrix & A);
+
+  /** Solve A X = B, where B is overwritten by X. B can have any number of columns.*/
+  void solveInPlace(MatrixRef B) const;
+
+  Eigen::MatrixXd solve(const MatrixConstRef & B) const
+  {
+    Eigen::MatrixXd X = B;
+    solveInPlace(X);
+    return X;
+  }
+
+  /** Size of the factorized matrix.*/
+  int size() const { return static_cast<int>(lu_.cols()); }
+
+private:
+  /** Element (i,j) of the working matrix, with L below the diagonal and U above it.*/
+  double & at(int i, int j) { return lu_(ku_ + i - j, j); }
+  double at(int i, int j) const { return lu_(ku_ + i - j, j); }
+
+  int l_ = 0;               // Lower bandwidth of A
+  int ku_ = 0;              // Upper bandwidth of U
+  Eigen::MatrixXd lu_;      // Packed factors
+  std::vector<int> pivots_; // Row j was exchanged with row pivots_[j] at step j
+};
+
+/** Cholesky factorization A = L L^T of a symmetric positive definite BandMatrix (as LAPACK's pbtrf).
+ *
+ * Only the lower part of A (and its lower bandwidth l) is used, so that A can be given with its lower
+ * part only (zero upper bandwidth). L is lower triangular with bandwidth l, stored packed in a
+ * (l + 1) x n matrix. The factorization and the solves cost O(n l^2) and O(n l) respectively.
+ *
+ * Factorizing a matrix with the same size and lower bandwidth as the previous one does not allocate.
+ */
+class MLSM_DLLAPI BandCholesky
+{
+public:
+  BandCholesky() = default;
+  explicit BandCholesky(const BandMatrix & A) { compute(A); }
+
+  /** Compute the factorization of \p A.
+   *
+   * \throw std::runtime_error if A is not square, or is not positive definite.
+   */
+  void compute(const BandMatrix & A);
+
+  /** Solve A X = B, where B is overwritten by X. B can have any number of columns.*/
+  void solveInPlace(MatrixRef B) const;
+
+  Eigen::MatrixXd solve(const MatrixConstRef & B) const
+  {
+    Eigen::MatrixXd X = B;
+    solveInPlace(X);
+    return X;
+  }
+
+  /** The factor L, as a band matrix.*/
+  BandMatrix matrixL() const;
+
+  /** Size of the factorized matrix.*/
+  int size() const { return static_cast<int>(L_.cols()); }
+
+private:
+  /** Element (i,j) of L, for j <= i <= j + l.*/
+  double & at(int i, int j) { return L_(i - j, j); }
+  double at(int i, int j) const { return L_(i - j, j); }
+
+  int l_ = 0;         // Bandwidth of L
+  Eigen::MatrixXd L_; // Packed factor
+};
+
+} // namespace mls
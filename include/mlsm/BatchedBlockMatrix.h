@@ -0,0 +1,175 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/BlockMatrix.h>
+
+#include <type_traits>
+#include <vector>
+
+namespace mls
+{
+/** View on a block (r,c) of a BatchedBlockMatrix: operator()(i,j) returns the N values of the
+ * coefficient (i,j) of the block, one per matrix of the batch, as a contiguous vector.
+ *
+ * \p T is double or const double.
+ */
+template<typename T>
+class BatchedBlockView
+{
+public:
+  using VectorMap = Eigen::Map<std::conditional_t<std::is_const_v<T>, const Eigen::VectorXd, Eigen::VectorXd>>;
+
+  BatchedBlockView(T * data, int batchSize, int rows, int cols, int rowStride, int colStride)
+  : data_(data), batchSize_(batchSize), rows_(rows), cols_(cols), rowStride_(rowStride), colStride_(colStride)
+  {}
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  /** Whether the block is not stored (and thus zero for all the matrices of the batch).*/
+  bool isZero() const { return data_ == nullptr; }
+
+  /** Coefficient (i,j) of the block, for all the matrices of the batch.*/
+  VectorMap operator()(int i, int j) const
+  {
+    assert(!isZero() && i >= 0 && i < rows_ && j >= 0 && j < cols_);
+    return VectorMap(data_ + static_cast<Eigen::Index>(i * rowStride_ + j * colStride_) * batchSize_, batchSize_);
+  }
+
+private:
+  T * data_;
+  int batchSize_;
+  int rows_;
+  int cols_;
+  int rowStride_; // Offset (in number of coefficients) between two consecutive rows of the block
+  int colStride_; // Offset (in number of coefficients) between two consecutive columns of the block
+};
+
+/** A batch of N block matrices sharing the same structure (shape, storage scheme and sizes of the
+ * blocks), such as the matrices of many independent problems of the same kind.
+ *
+ * The values are stored interleaved across the batch (structure of arrays): for each coefficient of each
+ * stored block, the N values of this coefficient are contiguous. An operation on the batch is thus a
+ * single traversal of the structure, whose innermost loop runs over the batch and is vectorized, instead
+ * of N traversals operating on tiny blocks.
+ *
+ * Every stored block is treated as a dense block: the types of the blocks of the reference matrix are
+ * not exploited, only its structure. Vectors of the batch are given as N x n matrices, whose k-th row is
+ * the vector for the k-th matrix, so that their entries are interleaved across the batch as well.
+ */
+class MLSM_DLLAPI BatchedBlockMatrix
+{
+public:
+  /** Batch of \p batchSize matrices with the structure of \p structure, all initially zero. The sizes of
+   * all the rows and columns of blocks of \p structure need to be specified.
+   */
+  BatchedBlockMatrix(const BlockMatrix & structure, int batchSize);
+
+  int batchSize() const { return batchSize_; }
+  int rows() const { return rowOffsets_.back(); }
+  int cols() const { return colOffsets_.back(); }
+  int blkRows() const { return shape_->rows(); }
+  int blkCols() const { return shape_->cols(); }
+  const internal::ShapeBase & shape() const { return *shape_; }
+  int rowsOfBlock(int r) const { return rowOffsets_[r + 1] - rowOffsets_[r]; }
+  int colsOfBlock(int c) const { return colOffsets_[c + 1] - colOffsets_[c]; }
+  int rowOffset(int r) const { return rowOffsets_[r]; }
+  int colOffset(int c) const { return colOffsets_[c]; }
+
+  /** Whether the block (r,c) is stored.*/
+  bool isStored(int r, int c) const;
+  /** Block (r,c) for all the matrices of the batch. Writing through a non-stored block is not allowed.*/
+  BatchedBlockView<double> block(int r, int c);
+  BatchedBlockView<const double> block(int r, int c) const;
+
+  /** Copy the values of \p M into the k-th matrix of the batch. \p M needs to have the structure of the
+   * batch, and its size up to date (see BlockMatrix::updateSize).
+   *
+   * \throw std::runtime_error if the sizes of the blocks of M are not the ones of the batch.
+   */
+  void set(int k, const BlockMatrix & M);
+  /** Dense version of the k-th matrix of the batch.*/
+  void toDense(int k, MatrixRef D) const;
+
+  /** Y = alpha * op(A_k) * X + beta * Y for every matrix A_k of the batch, where op(A_k) is A_k or A_k^T
+   * depending on \p transpose. The k-th rows of X and Y are the vectors for A_k.
+   */
+  void multiply(const MatrixConstRef & X, MatrixRef Y, double alpha, double beta, bool transpose) const;
+
+private:
+  /** A stored block of the row of blocks r.*/
+  struct Entry
+  {
+    int c;       // Column of blocks
+    int idx;     // Index of the stored block
+    bool tr;     // The stored block is op(A)_{rc}^T
+  };
+  /** Stored block, kept in column-major order.*/
+  struct Stored
+  {
+    int r = -1; // Position (r,c) where the stored block appears non-transposed
+    int c = -1;
+    int rows = 0;
+    int cols = 0;
+    int offset = 0; // Index of the first coefficient in data_
+  };
+
+  const Entry * find(int r, int c) const;
+  template<typename T>
+  BatchedBlockView<T> view(T * data, int r, int c) const;
+
+  int batchSize_;
+  internal::ShapePtr shape_;
+  std::vector<int> rowOffsets_;
+  std::vector<int> colOffsets_;
+  std::vector<Entry> entries_;  // Stored blocks, row of blocks by row of blocks
+  std::vector<int> rowStart_;   // Entries of the row r are entries_[rowStart_[r]] to entries_[rowStart_[r+1]-1]
+  std::vector<Stored> stored_;
+  Eigen::MatrixXd data_;        // batchSize x (number of stored coefficients)
+  Eigen::MatrixXd tmp_;         // Conversion buffer for set
+};
+
+/** Block Cholesky factorization of every matrix of a batch of symmetric positive definite block
+ * tridiagonal matrices (see BlockTriDiagonalCholesky for the algorithm).
+ *
+ * All the blocks are treated as dense blocks, and every scalar operation of the block Thomas algorithm
+ * is performed for the whole batch at once on interleaved data. Only the lower part of the matrices is
+ * read. The workspace is only reallocated when the block sizes or the batch size change.
+ */
+class MLSM_DLLAPI BatchedBlockTriDiagonalCholesky
+{
+public:
+  BatchedBlockTriDiagonalCholesky() = default;
+  explicit BatchedBlockTriDiagonalCholesky(const BatchedBlockMatrix & A) { compute(A); }
+
+  /** Compute the factorization of every matrix of \p A.
+   *
+   * \throw std::runtime_error if the matrices are not square block tridiagonal, or if one of them is not
+   * positive definite.
+   */
+  void compute(const BatchedBlockMatrix & A);
+
+  /** Solve A_k x_k = b_k for every matrix A_k of the batch, where the k-th row of B is b_k and is
+   * overwritten by x_k.
+   */
+  void solveInPlace(MatrixRef B) const;
+
+  int batchSize() const { return batchSize_; }
+  int size() const { return size_; }
+
+private:
+  struct Stage
+  {
+    int size;          // Size of the stage
+    int offset;        // Row of the stage in the whole matrix
+    int nextSize;      // Size of the next stage (0 for the last one, or if B_i is not stored)
+    Eigen::MatrixXd L; // Lower part of L_i, batchSize x (size * size), column-major
+    Eigen::MatrixXd C; // C_i, batchSize x (nextSize * size), column-major
+  };
+
+  std::vector<Stage> stages_;
+  int batchSize_ = 0;
+  int size_ = 0;
+};
+
+} // namespace mls
@@ -0,0 +1,151 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/BlockMatrix.h>
+#include <mlsm/internal/SimpleType.h>
+
+#include <vector>
+
+namespace mls
+{
+/** QR factorization A = Q [R; 0] of a block matrix with at least as many rows as columns, by a sequence
+ * of Givens rotations, meant for least-squares problems min ||A x - b|| with band matrices such as
+ * stacked banded Jacobians.
+ *
+ * Unlike a dense Householder QR, the factorization works on a row-wise profile of A: row i is stored
+ * only from its first to its last (possibly) non-zero column. The rows of A are merged one after the
+ * other into R (row-merge scheme): a row whose first non-zero is in column k is rotated with the row k
+ * of R to eliminate this element, and so on until the row is zero, unless the row k of R does not exist
+ * yet, in which case the row becomes the row k of R. The structure of the blocks is taken into account
+ * to determine the profile: zero blocks do not contribute to it, and the blocks that are multiple of the
+ * identity or diagonal only contribute their diagonal. For example, each row of a regularization term
+ * lambda I stacked below a diagonal matrix is eliminated by a single rotation without fill-in. For a
+ * band matrix whose rows are ordered by first non-zero column, R is a band matrix and the cost is linear
+ * in the number of blocks.
+ *
+ * As for BlockTriDiagonalCholesky, the factorization is split in a symbolic phase (analyzePattern),
+ * which determines the profile and the sequence of rotations and allocates the workspace, and a
+ * numeric phase (factorize), which computes the rotations and R without any allocation.
+ *
+ * Q is not formed: the rotations are stored (see rotations()) and can be applied to any right-hand side
+ * with applyQTransposeInPlace and applyQInPlace.
+ */
+class MLSM_DLLAPI BlockGivensQR
+{
+public:
+  /** Rotation of the rows p and q (p < q), applied to a matrix B as B.applyOnTheLeft(p, q, G.adjoint()).
+   * The row p is the one that ends up as the row k of R, where (q, k) is the element zeroed by the
+   * rotation.
+   */
+  struct Rotation
+  {
+    int p;
+    int q;
+    Givens G;
+  };
+
+  BlockGivensQR() = default;
+  explicit BlockGivensQR(const BlockMatrix & A) { compute(A); }
+
+  /** Compute the factorization of \p A. This is analyzePattern(A) followed by factorize(A).
+   *
+   * \throw std::runtime_error if A has more columns than rows, or does not have full column rank.
+   */
+  void compute(const BlockMatrix & A);
+
+  /** Symbolic phase: analyze the pattern of \p A (block sizes and block types) and allocate the
+   * workspace for its factorization. The values of the blocks of A are not read.
+   *
+   * \throw std::runtime_error if A has more columns than rows, or if its structure is rank deficient
+   * (a column with no possible non-zero after elimination).
+   */
+  void analyzePattern(const BlockMatrix & A);
+
+  /** Numeric phase: compute the factorization of \p A, whose pattern must be the one given to the
+   * last call to analyzePattern.
+   *
+   * \throw std::runtime_error if the size of A, the size of one of its rows or columns of blocks, or
+   * the type of one of its blocks differs from the analyzed one, or if a diagonal element of R is zero
+   * (A does not have full column rank).
+   */
+  void factorize(const BlockMatrix & A);
+
+  /** B <- Q^T B, with B having as many rows as A.*/
+  void applyQTransposeInPlace(MatrixRef B) const;
+  /** B <- Q B, with B having as many rows as A.*/
+  void applyQInPlace(MatrixRef B) const;
+
+  /** Least-squares solution: replace the first cols() rows of \p B by the solution X of min ||A X - B||.
+   * The remaining rows contain the residual Q^T (B - A X).
+   */
+  void solveInPlace(MatrixRef B) const;
+
+  /** Least-squares solution X of min ||A X - B||.*/
+  Eigen::MatrixXd solve(const MatrixConstRef & B) const
+  {
+    Eigen::MatrixXd X = B;
+    solveInPlace(X);
+    return X.topRows(cols_);
+  }
+
+  /** Upper triangular factor R, as a dense matrix.*/
+  Eigen::MatrixXd matrixR() const;
+
+  /** The sequence of rotations, in order of application. Q^T is the product of these rotations followed
+   * by the row permutation rowPermutation().
+   */
+  const std::vector<Rotation> & rotations() const { return rotations_; }
+  /** Permutation P bringing the rows of A that end up as rows of R on top: after applying the rotations
+   * to B, P * B has the rows corresponding to R first.
+   */
+  const Eigen::PermutationMatrix<Eigen::Dynamic> & rowPermutation() const { return perm_; }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+private:
+  /** Stored block of A, with the type under which it was analyzed.*/
+  struct BlockInfo
+  {
+    int r;
+    int c;
+    internal::SimpleType type;
+  };
+  /** Profile of a row of the working matrix: columns [lo, hi) stored at data_[offset].*/
+  struct RowProfile
+  {
+    int lo;
+    int hi;
+    int offset;
+  };
+
+  /** Pointer to the element (i,j) of the working matrix, which needs to be in the profile of row i.*/
+  double * at(int i, int j)
+  {
+    assert(j >= profile_[i].lo && j < profile_[i].hi);
+    return data_.data() + profile_[i].offset + j - profile_[i].lo;
+  }
+  const double * at(int i, int j) const
+  {
+    assert(j >= profile_[i].lo && j < profile_[i].hi);
+    return data_.data() + profile_[i].offset + j - profile_[i].lo;
+  }
+
+  int rows_ = 0;
+  int cols_ = 0;
+  std::vector<int> rowsOfBlock_;
+  std::vector<int> colsOfBlock_;
+  std::vector<BlockInfo> blocks_;
+  std::vector<RowProfile> profile_;
+  std::vector<Rotation> rotations_;
+  std::vector<int> rotationCol_; // rotationCol_[k]: column of the element zeroed by the k-th rotation
+  std::vector<int> rotationEnd_; // The k-th rotation acts on the columns [rotationCol_[k], rotationEnd_[k])
+  std::vector<int> origin_;      // Row of the working matrix holding the row j of R
+  std::vector<int> rEnd_;        // Row j of R has its non-zeros in the columns [j, rEnd_[j])
+  Eigen::PermutationMatrix<Eigen::Dynamic> perm_;
+  Eigen::VectorXd data_;         // Working matrix, with R in the rows origin_ after the factorization
+  Eigen::MatrixXd tmp_;          // Conversion buffer for blocks without dedicated kernel
+};
+
+} // namespace mls
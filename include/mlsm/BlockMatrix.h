@@ -4,16 +4,48 @@
 
 #include <mlsm/MatrixBase.h>
 
+#include <functional>
+
 namespace mls
 {
 /** Rules for the size of the blocks:
  *  - initially unspecified (-1)
  *  - first matrix to be set on a row/col imposes its size to the row/col
  *  - subsequent matrices needs to have compatible sizes if on the same row/col
+ *
+ * Frozen structure: once the structure of the matrix is final, freezeStructure() forbids any further
+ * change of the sizes of the rows and columns of blocks. In this mode, the following operations do
+ * not perform any heap allocation, which makes them suitable for real-time loops:
+ *  - changing the values of the blocks (e.g. through DenseMatrix::matrix()), or replacing a block by
+ *    an already allocated matrix of the same size with setBlock,
+ *  - updateSize, toDense and multiply,
+ *  - BlockTriDiagonalCholesky::factorize and BlockTriDiagonalCholesky::solveInPlace, as well as
+ *    BlockTriDiagonalCholesky::compute once the factorization object has been used on a matrix with
+ *    the same block sizes.
+ * Blocks that are themselves block matrices need to be frozen separately. Errors are still reported
+ * through exceptions, whose construction may allocate.
+ *
+ * Non-stored blocks: block(r,c) returns a zero matrix for a position that is not stored. After a call to
+ * updateSize, this is a zero matrix shared by all the non-stored blocks of the same size, so that
+ * traversing all the blocks does not allocate. The returned pointer shares the ownership of this matrix
+ * and remains valid after the block matrix is destroyed. Use blockView for a traversal that does not
+ * touch reference counts either. If the sizes of the blocks were changed since the last call to
+ * updateSize, or if there are too many different block sizes, a new zero matrix is created instead.
+ *
+ * Incremental size update: the sizes are only derived again by updateSize if the structure changed
+ * since the last call (through setBlock, setRowsOfBlock, setColsOfBlock, resetRowsOfBlock,
+ * resetColsOfBlock or the arena methods), so that updateSize has a constant cost on an unchanged
+ * matrix. A block matrix set as a block of other block matrices notifies them of its own changes, so
+ * that only the modified subtrees are visited again, and so do leaf blocks resized through autoResize.
+ * Other changes of size of leaf blocks made directly on them (e.g. by resizing the matrix of a
+ * DenseMatrix) are not tracked, and need to be signaled with invalidateSize (on the leaf or on the block
+ * matrix).
  */
 class MLSM_DLLAPI BlockMatrix : public MatrixBase
 {
 public:
+  ~BlockMatrix() override;
+
   int rows() const override { return rows_; }
   int cols() const override { return cols_; }
 
@@ -22,6 +54,42 @@ public:
   int blkRows() const override { return shape_->rows(); };
   int blkCols() const override { return shape_->cols(); };
 
+  const internal::StorageScheme & storageScheme() const { return *storageScheme_; }
+  /** Number of rows of the r-th row of blocks (-1 if not specified yet).*/
+  int rowsOfBlock(int r) const
+  {
+    assert(r >= 0 && r < blkRows());
+    return rowsOfBlock_[r];
+  }
+  /** Number of columns of the c-th column of blocks (-1 if not specified yet).*/
+  int colsOfBlock(int c) const
+  {
+    assert(c >= 0 && c < blkCols());
+    return colsOfBlock_[c];
+  }
+  /** Index of the first row of the r-th row of blocks. For r = blkRows(), return rows().
+   * Valid after a call to updateSize().
+   */
+  int rowOffset(int r) const
+  {
+    assert(r >= 0 && r <= blkRows());
+    return rowOffsets_[r];
+  }
+  /** Index of the first column of the c-th column of blocks. For c = blkCols(), return cols().
+   * Valid after a call to updateSize().
+   */
+  int colOffset(int c) const
+  {
+    assert(c >= 0 && c <= blkCols());
+    return colOffsets_[c];
+  }
+
+  /** Non-owning view on the block (r,c), to be preferred to block(r,c) in hot paths (see BlockView).
+   * Non-stored blocks, as well as stored blocks that were never set, are given as zero views. The
+   * sizes and offsets of the view are the ones from the last call to updateSize().
+   */
+  BlockView blockView(int r, int c) const;
+
   /** Set the block (r,c) to the given matrices. */
   void setBlock(int r, int c, MatrixPtr M, bool transpose = false);
   void setRowsOfBlock(int r, int rows);
@@ -30,7 +98,54 @@ public:
   void resetColsOfBlock(int c);
   // Update the size of each row and column pf blocks
   void updateSize() override;
+  void invalidateSize() override;
+  /** Whether the structure changed since the last successful call to updateSize.*/
+  bool isSizeDirty() const { return sizeDirty_; }
+  /** Freeze (or unfreeze if \p freeze is false) the structure of the matrix. Freezing calls updateSize
+   * first, so that all the sizes need to be specified. While frozen, the sizes of the rows and columns
+   * of blocks cannot be changed, and auto-resizable blocks are not resized anymore.
+   */
+  void freezeStructure(bool freeze = true);
+  /** Whether the structure is frozen (see freezeStructure).*/
+  bool isStructureFrozen() const { return frozen_; }
+  /** Only the stored blocks are written, the rest of \p D being zeroed in bulk.*/
   void toDense(MatrixRef D, bool transpose) const override;
+  /** Same as toDense, with the rows of blocks distributed over \p threads threads (if 0, the number
+   * of concurrent threads supported by the hardware). Each thread writes its own part of \p D, so
+   * that the blocks only need to support concurrent calls to their const methods. An exception thrown
+   * by one of the threads is rethrown once all of them are joined.
+   */
+  void toDenseParallel(MatrixRef D, bool transpose = false, int threads = 0) const;
+  /** Structure-aware product: only the stored blocks are visited, the product being delegated to
+   * each of them.*/
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const override;
+  /** Only the stored blocks are considered, each of them contributing the elements given by its own
+   * sparseColNNZ and sparseCol.*/
+  int sparseColNNZ(int c, bool transpose) const override;
+  int sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const override;
+
+  /** Arena mode: make every stored block a zero matrix whose data is a view on a single contiguous
+   * buffer owned by this matrix. Block (r,c) is a DiagonalMatrix if \p isDiagonal(r,c) returns true
+   * (the block then needs to be square), and a DenseMatrix otherwise. The data of the blocks are laid
+   * out in the order of the storage scheme (e.g. column by column of the band for band storage), each
+   * one starting on an aligned address.
+   *
+   * The sizes of all rows and columns of blocks need to have been specified. The blocks can then be
+   * filled through DenseMatrix::matrix() and DiagonalMatrix::diagonal().
+   *
+   * \warning The blocks refer to memory owned by this matrix, and must not be used once it is destroyed.
+   */
+  void allocateArena(const std::function<bool(int r, int c)> & isDiagonal = nullptr);
+  /** Arena mode: move the data of all the stored DenseMatrix and DiagonalMatrix blocks to a single
+   * contiguous buffer owned by this matrix, in the same layout as for allocateArena. Each of these
+   * blocks is replaced by a matrix of the same type and value referring to the buffer. Other blocks
+   * (including FixedDenseMatrix, whose data are already stored inline) are kept as they are.
+   *
+   * \warning The same as for allocateArena applies.
+   */
+  void compactToArena();
+  /** Whether the stored blocks are (partly) in an arena buffer.*/
+  bool hasArena() const { return arena_.size() > 0; }
 
 protected:
   BlockMatrix(internal::ShapePtr shape, std::unique_ptr<internal::StorageScheme>);
@@ -50,8 +165,42 @@ protected:
   std::vector<nonConstTransposableMatrix> storage_;
   std::vector<int> rowsOfBlock_;
   std::vector<int> colsOfBlock_;
+  std::vector<int> rowOffsets_; // rowOffsets_[r] is the sum of the sizes of the rows of blocks before r
+  std::vector<int> colOffsets_; // colOffsets_[c] is the sum of the sizes of the columns of blocks before c
   int rows_; // total number of rows
   int cols_; // total number of cols
+  Eigen::VectorXd arena_; // Contiguous buffer for the data of the blocks in arena mode
+  bool frozen_ = false; // Whether the structure is frozen
+  bool sizeDirty_ = true; // Whether updateSize needs to derive the sizes again
+
+private:
+  /** Description of a block to be placed in the arena.*/
+  struct ArenaBlock
+  {
+    int idx;               // Index in storage_
+    int rows;              // Size of the stored matrix
+    int cols;
+    bool diagonal;         // Diagonal or dense matrix
+    bool trans;            // Transposition flag of the stored matrix
+    MatrixConstPtr source; // Matrix whose values are to be copied into the arena (if any)
+  };
+  void buildArena(const std::vector<ArenaBlock> & blocks);
+  /** Set storage_[idx] to \p M, keeping track of the block matrices among the blocks.*/
+  void store(int idx, nonConstTransposableMatrix M);
+  /** toDense for the rows of blocks r0 to r1-1 only.*/
+  void toDenseRows(MatrixRef D, bool transpose, int r0, int r1) const;
+  /** Zero matrix for the non-stored block (r,c).*/
+  MatrixPtr zeroBlock(int r, int c) const;
+  /** Update the shared zero matrices for the current block sizes.*/
+  void updateZeroBlocks();
+
+  // Shared zero matrices for the non-stored blocks
+  std::vector<int> rowSizes_;         // Different sizes of the rows of blocks
+  std::vector<int> colSizes_;         // Different sizes of the columns of blocks
+  std::vector<int> rowSizeClass_;     // rowSizes_[rowSizeClass_[r]] is the size of the r-th row of blocks
+  std::vector<int> colSizeClass_;     // colSizes_[colSizeClass_[c]] is the size of the c-th column of blocks
+  std::vector<MatrixPtr> zeroBlocks_; // Zero matrix of size rowSizes_[i] x colSizes_[j] at i * colSizes_.size() + j
+  std::vector<MatrixPtr> zeroPool_;   // All the zero matrices created so far, for reuse when sizes change
 };
 
 class MLSM_DLLAPI DiagonalBlockMatrix : public BlockMatrix
@@ -73,6 +222,19 @@ public:
   {}
 };
 
+class MLSM_DLLAPI BandBlockMatrix : public BlockMatrix
+{
+public:
+  BandBlockMatrix(int blkRows,
+                  int blkCols,
+                  internal::Size lowerBandwidth,
+                  internal::Size upperBandwidth,
+                  internal::SymmetricStorage symmetric = internal::SymmetricStorage::None)
+  : BlockMatrix(std::make_unique<internal::BandShape>(blkRows, blkCols, lowerBandwidth, upperBandwidth),
+                std::make_unique<internal::BandStorageScheme>(symmetric))
+  {}
+};
+
 class MLSM_DLLAPI DenseBlockMatrix : public BlockMatrix
 {
 public:
@@ -81,4 +243,87 @@ public:
                 std::make_unique<internal::DenseStorageScheme>())
   {}
 };
-} // namespace mls
\ No newline at end of file
+
+class MLSM_DLLAPI SparseBlockMatrix : public BlockMatrix
+{
+public:
+  /** Block matrix whose non-zero blocks are at the positions (r,c) given in \p nonZeros. For symmetric
+   * storage, the pattern needs to be symmetric, and only the blocks on the lower or upper side of the
+   * diagonal are set.
+   */
+  SparseBlockMatrix(int blkRows,
+                    int blkCols,
+                    std::vector<std::pair<int, int>> nonZeros,
+                    internal::SymmetricStorage symmetric = internal::SymmetricStorage::None)
+  : BlockMatrix(std::make_unique<internal::SparseShape>(blkRows, blkCols, std::move(nonZeros)),
+                std::make_unique<internal::SparseStorageScheme>(symmetric))
+  {}
+  /** Block matrix with a copy of \p shape as block pattern.*/
+  SparseBlockMatrix(const internal::SparseShape & shape,
+                    internal::SymmetricStorage symmetric = internal::SymmetricStorage::None)
+  : BlockMatrix(shape.copy(), std::make_unique<internal::SparseStorageScheme>(symmetric))
+  {}
+};
+
+/** Compute op(lhs) * op(rhs), where op(M) is M or M^T depending on \p transposeLhs and
+ * \p transposeRhs.
+ *
+ * The result is a block matrix whose shape is given by internal::mult, with a band, dense or sparse storage
+ * accordingly. Only the products of blocks that are stored in both operands are computed, and each
+ * block of the result is represented by the simplest possible type (see internal::SimpleAccumulator).
+ * Non-simple blocks (e.g. nested block matrices) are handled through their matrix-vector product,
+ * yielding dense blocks.
+ *
+ * Both operands need to have their size up to date (see BlockMatrix::updateSize).
+ */
+MLSM_DLLAPI std::shared_ptr<BlockMatrix> mult(const BlockMatrix & lhs,
+                                              const BlockMatrix & rhs,
+                                              bool transposeLhs = false,
+                                              bool transposeRhs = false);
+
+/** Compute alpha * op(lhs) + beta * op(rhs), where op(M) is M or M^T depending on \p transposeLhs and
+ * \p transposeRhs.
+ *
+ * The result is a block matrix whose shape is given by internal::add, with a band, dense or sparse storage
+ * accordingly. As for mult, each block of the result is represented by the simplest possible type, so that
+ * e.g. the sum of a multiple of the identity and a diagonal matrix is a diagonal update.
+ *
+ * Both operands need to have the same block sizes, and their size up to date (see BlockMatrix::updateSize).
+ */
+MLSM_DLLAPI std::shared_ptr<BlockMatrix> add(const BlockMatrix & lhs,
+                                             const BlockMatrix & rhs,
+                                             double alpha = 1,
+                                             double beta = 1,
+                                             bool transposeLhs = false,
+                                             bool transposeRhs = false);
+
+/** Solve op(T) X = B by block forward or backward substitution, where op(T) is T or T^T depending on
+ * \p transpose, and B is overwritten by X. B can have any number of columns.
+ *
+ * T needs to be a square band block matrix with square diagonal blocks and either a zero upper
+ * bandwidth (block lower triangular) or a zero lower bandwidth (block upper triangular), a block
+ * diagonal matrix being considered lower triangular. Its diagonal blocks need to be triangular in the
+ * same way: for a dense diagonal block, only its lower (resp. upper) part is read.
+ *
+ * The substitution goes block column by block column of op(T): once the rows X_j of the solution are
+ * obtained from the diagonal block, they are eliminated from the right-hand side with all the stored
+ * blocks of the column. Each step thus works on all the columns of B at once, with triangular solves
+ * and matrix products on the blocks (scalings for blocks that are multiple of the identity or
+ * diagonal). Only diagonal blocks without dedicated kernel (e.g. nested block matrices) require a
+ * temporary allocation.
+ *
+ * T needs to have its size up to date (see BlockMatrix::updateSize).
+ *
+ * \throw std::runtime_error if T is not block triangular, if the sizes are not compatible, or if a
+ * diagonal element of T is zero.
+ */
+MLSM_DLLAPI void solveTriangularInPlace(const BlockMatrix & T, MatrixRef B, bool transpose = false);
+
+/** Solution X of op(T) X = B (see solveTriangularInPlace).*/
+inline Eigen::MatrixXd solveTriangular(const BlockMatrix & T, const MatrixConstRef & B, bool transpose = false)
+{
+  Eigen::MatrixXd X = B;
+  solveTriangularInPlace(T, X, transpose);
+  return X;
+}
+} // namespace mls
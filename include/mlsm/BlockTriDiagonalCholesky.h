@@ -0,0 +1,166 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/BlockMatrix.h>
+#include <mlsm/internal/SimpleType.h>
+
+#include <vector>
+
+namespace mls
+{
+/** Block Cholesky factorization A = L L^T of a symmetric positive definite block tridiagonal
+ * matrix (block Thomas algorithm).
+ *
+ * With D_i the diagonal blocks of A and B_i = A_{i+1,i} its subdiagonal blocks, the factor L is block
+ * lower bidiagonal with diagonal blocks L_i and subdiagonal blocks C_i such that
+ *   L_0 L_0^T = D_0,  C_i = B_i L_i^{-T},  L_{i+1} L_{i+1}^T = D_{i+1} - C_i C_i^T.
+ * The cost is thus linear in the number of blocks.
+ *
+ * Only the lower part of A is read (through BlockMatrix::block), so that A can have any band
+ * storage, in particular symmetric storage of its upper or lower part. The structure of the blocks
+ * is exploited: a Schur complement D_{i+1} - C_i C_i^T that stays a multiple of the identity (when all
+ * the blocks involved are) is factorized as a scalar, one that stays diagonal is factorized
+ * coefficient-wise, and zero subdiagonal blocks are skipped. Products with such factors reduce to
+ * scalings in the solves.
+ *
+ * The factorization is split in a symbolic phase (analyzePattern) and a numeric phase (factorize).
+ * The symbolic phase depends only on the shape of A, the sizes of its blocks and their types (zero,
+ * multiple of identity, diagonal, dense or other). It chooses the representation of each L_i and C_i
+ * and allocates the corresponding workspace. The numeric phase can then be repeated on any matrix with
+ * the same pattern, without any shape iteration, type detection or allocation.
+ *
+ * The factors are computed and stored with the scalar type \p Scalar (double or float), the blocks of A
+ * being converted on the fly. Working in single precision halves the memory traffic of the solves, and
+ * can be combined with iterative refinement in double precision (see MixedPrecisionBlockTriDiagonalSolver).
+ */
+template<typename Scalar>
+class BlockTriDiagonalCholeskyT
+{
+public:
+  using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+  using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+  using MatrixRefT = Eigen::Ref<Matrix>;
+  using MatrixConstRefT = Eigen::Ref<const Matrix>;
+
+  BlockTriDiagonalCholeskyT() = default;
+  explicit BlockTriDiagonalCholeskyT(const BlockMatrix & A) { compute(A); }
+
+  /** Compute the factorization of \p A. This is analyzePattern(A) followed by factorize(A).
+   *
+   * \throw std::runtime_error if A is not square block tridiagonal, or is not positive definite.
+   */
+  void compute(const BlockMatrix & A);
+
+  /** Symbolic phase: analyze the pattern of \p A and allocate the workspace for its factorization.
+   * The values of the blocks of A are not read.
+   *
+   * \throw std::runtime_error if A is not square block tridiagonal.
+   */
+  void analyzePattern(const BlockMatrix & A);
+
+  /** Numeric phase: compute the factorization of \p A, whose pattern (block sizes and block types)
+   * must be the one given to the last call to analyzePattern.
+   *
+   * \throw std::runtime_error if the block sizes or block types of A differ from the analyzed ones, or
+   * if A is not positive definite.
+   */
+  void factorize(const BlockMatrix & A);
+
+  /** Solve A X = B, where B is overwritten by X. B can have any number of columns.*/
+  void solveInPlace(MatrixRefT B) const;
+
+  Matrix solve(const MatrixConstRefT & B) const
+  {
+    Matrix X = B;
+    solveInPlace(X);
+    return X;
+  }
+
+  /** Size of the factorized matrix.*/
+  int size() const { return size_; }
+
+private:
+  struct Stage
+  {
+    int size;                  // Size of the stage
+    int offset;                // Row of the stage in the whole matrix
+    internal::SimpleType DType; // Type of the diagonal block D_i of A
+    internal::SimpleType BType; // Type of the subdiagonal block B_i of A (Zero if not stored)
+    internal::SimpleType LType; // MultipleOfIdentity, Diagonal or Dense
+    internal::SimpleType CType; // Zero, MultipleOfIdentity, Diagonal or Dense
+    Scalar l;                  // L_i = l * I if multiple of identity
+    Scalar c;                  // C_i = c * I if multiple of identity
+    Vector Ld;                 // L_i if diagonal
+    Matrix L;                  // L_i if dense (lower part)
+    Vector Cd;                 // C_i if diagonal
+    Matrix C;                  // C_i if dense (C_i is the block below L_i)
+  };
+
+  /** Compute the Schur complement D_i - C_{i-1} C_{i-1}^T and factorize it.*/
+  void factorizeDiagonal(const BlockView & D, const Stage * prev, Stage & s);
+  /** Compute C_i = B_i L_i^{-T}*/
+  void computeSubDiagonal(const BlockView & B, Stage & s);
+  /** D = M, for a matrix M without dedicated kernel.*/
+  void toDense(const BlockView & M, Matrix & D);
+
+  std::vector<Stage> stages_;
+  int size_ = 0;
+  Eigen::MatrixXd tmp_; // Conversion buffer for single precision, sized by analyzePattern
+};
+
+extern template class MLSM_DLLAPI BlockTriDiagonalCholeskyT<double>;
+extern template class MLSM_DLLAPI BlockTriDiagonalCholeskyT<float>;
+
+using BlockTriDiagonalCholesky = BlockTriDiagonalCholeskyT<double>;
+using BlockTriDiagonalCholeskyF = BlockTriDiagonalCholeskyT<float>;
+
+/** Solver for A X = B, with A symmetric positive definite block tridiagonal, using a single precision
+ * factorization of A and iterative refinement in double precision:
+ *   X_0 = A_f^{-1} B,  X_{k+1} = X_k + A_f^{-1} (B - A X_k),
+ * where A_f^{-1} denotes the solve with the single precision factors, and the residual B - A X_k is
+ * computed in double precision with the structure-aware product of A.
+ *
+ * For reasonably conditioned matrices, a few iterations give a solution as accurate as a double
+ * precision factorization, while the factorization and the solves work on half the memory.
+ */
+class MLSM_DLLAPI MixedPrecisionBlockTriDiagonalSolver
+{
+public:
+  MixedPrecisionBlockTriDiagonalSolver() = default;
+  explicit MixedPrecisionBlockTriDiagonalSolver(const BlockMatrix & A) { compute(A); }
+
+  /** See BlockTriDiagonalCholeskyT::compute.*/
+  void compute(const BlockMatrix & A) { llt_.compute(A); }
+  /** See BlockTriDiagonalCholeskyT::analyzePattern.*/
+  void analyzePattern(const BlockMatrix & A) { llt_.analyzePattern(A); }
+  /** See BlockTriDiagonalCholeskyT::factorize.*/
+  void factorize(const BlockMatrix & A) { llt_.factorize(A); }
+
+  /** Solve A X = B, where B is overwritten by X. \p A must be the factorized matrix.
+   *
+   * The refinement stops when the largest absolute value of the residual is below \p tolerance times
+   * the largest absolute value of B, or after \p maxIterations refinement steps.
+   *
+   * The refinement works in the workspace of the solver, which is only reallocated when the number of
+   * columns of B changes. This method is thus not reentrant: concurrent solves need one solver each.
+   *
+   * \return The number of refinement steps performed.
+   */
+  int solveInPlace(const BlockMatrix & A,
+                   MatrixRef B,
+                   int maxIterations = 10,
+                   double tolerance = Eigen::NumTraits<double>::dummy_precision());
+
+  /** Size of the factorized matrix.*/
+  int size() const { return llt_.size(); }
+
+private:
+  BlockTriDiagonalCholeskyF llt_;
+  // Workspace for the solves
+  Eigen::MatrixXd X_;
+  Eigen::MatrixXd R_;
+  Eigen::MatrixXf Rf_;
+};
+
+} // namespace mls
@@ -0,0 +1,134 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/SimpleMatrix.h>
+
+namespace mls
+{
+/** Base class of the dense matrices whose size is known at compile time (see FixedDenseMatrix).
+ *
+ * For the purpose of kernel selection, these matrices are dense matrices (internal::SimpleType::Dense),
+ * so that they can be mixed with any other block in a BlockMatrix. They additionally provide
+ * products with dense operands that are computed with fixed-size Eigen types.
+ */
+class MLSM_DLLAPI FixedDenseMatrixBase : public SimpleMatrix
+{
+public:
+  /** The elements of the matrix.*/
+  virtual MatrixConstRef matrix() const = 0;
+  /** Y += alpha * op(M) * B, where op(M) is M or M^T depending on \p transpose and M is this matrix.*/
+  virtual void addLeftProduct(const MatrixConstRef & B, MatrixRef Y, double alpha, bool transpose) const = 0;
+  /** Y += alpha * A * op(M), where op(M) is M or M^T depending on \p transpose and M is this matrix.*/
+  virtual void addRightProduct(const MatrixConstRef & A, MatrixRef Y, double alpha, bool transpose) const = 0;
+
+  bool isAutoResizable() const override { return false; }
+  int sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const override
+  {
+    if(transpose)
+      return writeDenseCol(matrix().row(c), rowOffset, inner, values);
+    else
+      return writeDenseCol(matrix().col(c), rowOffset, inner, values);
+  }
+
+protected:
+  void v_autoResize(int, int) override { assert(false); }
+};
+
+/** Dense matrix of size \p R x \p C, with its elements stored inline as a fixed-size Eigen matrix.
+ *
+ * Conversion to dense, matrix-vector products and products with dense matrices are done on fixed-size
+ * Eigen types, so that they can be unrolled and vectorized by the compiler. This is meant for the
+ * small blocks whose size is known at compile time (e.g. 3x3 or 6x6 blocks).
+ */
+template<int R, int C>
+class FixedDenseMatrix : public FixedDenseMatrixBase
+{
+  static_assert(R > 0 && C > 0, "FixedDenseMatrix needs a positive size.");
+
+public:
+  /** Eigen does not allow column-major matrices with a single row.*/
+  using MatrixType = Eigen::Matrix<double, R, C, (R == 1 && C != 1) ? Eigen::RowMajor : Eigen::ColMajor>;
+
+  FixedDenseMatrix() : shape_(R, C), M_(MatrixType::Zero()) {}
+  template<typename Derived>
+  explicit FixedDenseMatrix(const Eigen::MatrixBase<Derived> & M) : shape_(R, C), M_(M)
+  {}
+
+  const internal::ShapeBase & shape() const override { return shape_; }
+  MatrixConstRef matrix() const override { return Eigen::Map<const Eigen::MatrixXd>(M_.data(), R, C); }
+  /** The elements of the matrix, as a fixed-size Eigen matrix.*/
+  const MatrixType & fixed() const { return M_; }
+  /** Writable access to the elements, as a fixed-size Eigen matrix.*/
+  MatrixType & fixed() { return M_; }
+
+  void toDense(MatrixRef D, bool transpose) const override
+  {
+    if(transpose)
+    {
+      assert(D.rows() == C && D.cols() == R);
+      D.template topLeftCorner<C, R>() = M_.transpose();
+    }
+    else
+    {
+      assert(D.rows() == R && D.cols() == C);
+      D.template topLeftCorner<R, C>() = M_;
+    }
+  }
+
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const override
+  {
+    assert(x.size() == (transpose ? R : C) && y.size() == (transpose ? C : R));
+    scale(y, beta);
+    if(transpose)
+    {
+      Eigen::Map<Eigen::Matrix<double, C, 1>> yf(y.data());
+      yf.noalias() += alpha * M_.transpose() * Eigen::Map<const Eigen::Matrix<double, R, 1>>(x.data());
+    }
+    else
+    {
+      Eigen::Map<Eigen::Matrix<double, R, 1>> yf(y.data());
+      yf.noalias() += alpha * M_ * Eigen::Map<const Eigen::Matrix<double, C, 1>>(x.data());
+    }
+  }
+
+  void addLeftProduct(const MatrixConstRef & B, MatrixRef Y, double alpha, bool transpose) const override
+  {
+    if(transpose)
+    {
+      assert(B.rows() == R && Y.rows() == C && Y.cols() == B.cols());
+      Y.noalias() += alpha * M_.transpose() * B;
+    }
+    else
+    {
+      assert(B.rows() == C && Y.rows() == R && Y.cols() == B.cols());
+      Y.noalias() += alpha * M_ * B;
+    }
+  }
+
+  void addRightProduct(const MatrixConstRef & A, MatrixRef Y, double alpha, bool transpose) const override
+  {
+    if(transpose)
+    {
+      assert(A.cols() == C && Y.cols() == R && Y.rows() == A.rows());
+      Y.noalias() += alpha * A * M_.transpose();
+    }
+    else
+    {
+      assert(A.cols() == R && Y.cols() == C && Y.rows() == A.rows());
+      Y.noalias() += alpha * A * M_;
+    }
+  }
+
+protected:
+  double v_coeffRef(int r, int c) const override { return M_(r, c); }
+
+private:
+  internal::DenseShape shape_;
+  MatrixType M_;
+
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+} // namespace mls
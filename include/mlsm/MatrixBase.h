@@ -5,7 +5,6 @@
 #include <mlsm/api.h>
 #include <mlsm/defs.h>
 
-#include <mlsm/ShapeDescriptor.h>
 #include <mlsm/internal/Shape.h>
 #include <mlsm/internal/SimpleStorage.h>
 #include <mlsm/internal/StorageScheme.h>
@@ -62,10 +61,49 @@ struct TransposableMatrix
 using constTransposableMatrix = TransposableMatrix<true>;
 using nonConstTransposableMatrix = TransposableMatrix<false>;
 
+/** A non-owning, trivially copyable view on a block of a matrix: a raw pointer to the matrix of the
+ * block, a transposition flag, and the position and size of the block in its parent.
+ *
+ * Contrary to TransposableMatrix, copying a view does not modify any reference count, which makes it
+ * suitable for hot paths, in particular when several threads read the same matrix. A view is only valid
+ * as long as the viewed matrix is alive, and is still the one stored in the parent.
+ */
+struct BlockView
+{
+  BlockView() = default;
+  BlockView(const MatrixBase * M, bool tr, int rowOffset, int colOffset, int rows, int cols)
+  : matrix(M), trans(tr), rowOffset(rowOffset), colOffset(colOffset), rows_(rows), cols_(cols)
+  {}
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  /** Whether the block is zero without a matrix to represent it (e.g. a non-stored block).*/
+  bool isZero() const { return matrix == nullptr; }
+
+  BlockView transposed() const { return {matrix, !trans, colOffset, rowOffset, cols_, rows_}; }
+
+  inline double operator()(int r, int c) const;
+  inline void toDense(MatrixRef D, bool transpose) const;
+  inline void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const;
+
+  const MatrixBase * matrix = nullptr; // Matrix of the block, nullptr for a zero block
+  bool trans = false;                  // Whether the matrix needs to be transposed
+  int rowOffset = 0;                   // Row of the first element of the block in its parent
+  int colOffset = 0;                   // Column of the first element of the block in its parent
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+};
+
 /** Base class for representing multi-layered structure matrices. */
 class MLSM_DLLAPI MatrixBase : public std::enable_shared_from_this<MatrixBase>
 {
 public:
+  MatrixBase() = default;
+  /** The block matrices having the copied matrix as a block are not parents of the copy.*/
+  MatrixBase(const MatrixBase &) : std::enable_shared_from_this<MatrixBase>() {}
+  MatrixBase & operator=(const MatrixBase &) { return *this; }
   virtual ~MatrixBase() {}
 
   virtual int rows() const = 0;
@@ -89,14 +127,22 @@ public:
   nonConstTransposableMatrix block(int r, int c);
 
   virtual void updateSize() = 0;
+  /** Mark the sizes as out of date, so that the next call to updateSize derives them again. This is
+   * propagated to the block matrices having this matrix as a block.
+   */
+  virtual void invalidateSize() { invalidateParents(); }
   virtual bool isAutoResizable() const { return false; }
+  /** Resize the matrix to \p r x \p c. The block matrices having it as a block are notified.*/
   void autoResize(int r, int c)
   {
     if(!isAutoResizable())
     {
       throw std::runtime_error("[MatrixBase::autoResize] This matrix is not auto-resizable.");
     }
+    if(r == rows() && c == cols())
+      return;
     v_autoResize(r, c);
+    invalidateSize();
   }
 
   virtual void toDense(MatrixRef D, bool transpose) const = 0;
@@ -108,12 +154,111 @@ public:
     return D;
   }
 
+  /** Compute y = alpha * op(M) * x + beta * y, where op(M) is M or M^T depending on \p transpose
+   * and M is this matrix.
+   *
+   * If \p beta is 0, y is not read and can thus contain uninitialized values.
+   */
+  virtual void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const = 0;
+
+  Eigen::VectorXd multiply(VectorConstRef x, bool transpose = false) const
+  {
+    Eigen::VectorXd y(transpose ? cols() : rows());
+    multiply(x, y, 1, 0, transpose);
+    return y;
+  }
+
+  /** Write op(M) into the sparse matrix \p S, where op(M) is M or M^T depending on \p transpose and M is
+   * this matrix.
+   *
+   * Only the elements that can be non-zero given the structure of M are written: the elements of the
+   * stored blocks of a block matrix, and for its leaves, only the diagonal of the identity, multiple of
+   * identity and diagonal matrices and the band of band matrices. These elements are written even if
+   * their value is zero, so that the pattern of S depends only on the structure of M. The number of
+   * elements of each column is computed first, so that S is allocated at once, in compressed form, and
+   * then filled column by column without any search or sorting.
+   *
+   * If \p valuesOnly is true, S is expected to have been obtained by a previous call for a matrix with
+   * the same structure, and only its values are written. This does not allocate, unless some leaves
+   * rely on the default implementation of sparseCol.
+   *
+   * \throw std::runtime_error in the values-only mode, if the size of S or its number of elements per
+   * column do not match the structure of M. S is then left unchanged.
+   */
+  void toSparse(SparseMatrix & S, bool transpose = false, bool valuesOnly = false) const;
+
+  SparseMatrix toSparse(bool transpose = false) const
+  {
+    SparseMatrix S;
+    toSparse(S, transpose);
+    return S;
+  }
+
+  /** Number of elements of the column \p c of op(M) written by toSparse, where op(M) is M or M^T
+   * depending on \p transpose. The default implementation considers all the elements.
+   */
+  virtual int sparseColNNZ(int /*c*/, bool transpose) const { return transpose ? cols() : rows(); }
+  /** Write the elements of the column \p c of op(M) counted by sparseColNNZ, in increasing order of
+   * rows: their row index, shifted by \p rowOffset, to \p inner (if it is not nullptr), and their value
+   * to \p values. Return the number of elements written.
+   *
+   * The default implementation extracts the column with a product by a unit vector, which allocates.
+   */
+  virtual int sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const;
+
 protected:
+  /** Call invalidateSize on the block matrices having this matrix as a block.*/
+  void invalidateParents()
+  {
+    for(auto * P : parents_)
+      P->invalidateSize();
+  }
+
+  /** Perform y = beta * y, with the convention that y is set to 0 if \p beta is 0.*/
+  static void scale(VectorRef y, double beta)
+  {
+    if(beta == 0)
+      y.setZero();
+    else if(beta != 1)
+      y *= beta;
+  }
+
   virtual constTransposableMatrix v_block(int r, int c) const = 0;
   virtual nonConstTransposableMatrix v_block(int r, int c) = 0;
   virtual void v_autoResize(int r, int c) = 0;
   virtual double v_coeffRef(int r, int c) const = 0;
   // virtual double & v_coeffRef(int r, int c) = 0;
+
+private:
+  friend class BlockMatrix;
+  // Block matrices having this matrix as a block, once per block (for the propagation of invalidateSize)
+  std::vector<MatrixBase *> parents_;
 };
 
+double BlockView::operator()(int r, int c) const
+{
+  assert(r >= 0 && r < rows_ && c >= 0 && c < cols_);
+  if(!matrix)
+    return 0;
+  return trans ? (*matrix)(c, r) : (*matrix)(r, c);
+}
+
+void BlockView::toDense(MatrixRef D, bool transpose) const
+{
+  if(matrix)
+    matrix->toDense(D, trans != transpose);
+  else
+    D.setZero();
+}
+
+void BlockView::multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const
+{
+  if(matrix)
+    matrix->multiply(x, y, alpha, beta, trans != transpose);
+  else if(beta == 0)
+    y.setZero();
+  else if(beta != 1)
+    y *= beta;
+}
+
 } // namespace mls
@@ -0,0 +1,107 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/BlockMatrix.h>
+
+#include <Eigen/Cholesky>
+
+#include <vector>
+
+namespace mls
+{
+/** Solver for the KKT systems of optimal control problems
+ *        | H  G^T | | z |   | r_z |
+ *        |        | |   | = |     |
+ *        | G   0  | | l |   | r_l |
+ * by a Riccati recursion, with a cost linear in the number of stages.
+ *
+ * The variables are grouped by stage, z_k = (x_k, u_k) for k = 0..N, with x_k the state and u_k the
+ * control (u_N can be empty). H is the Hessian, whose diagonal blocks are the stage Hessians
+ *          | Q_k  S_k^T |
+ *    H_k = |            |
+ *          | S_k  R_k   |
+ * H is a square block diagonal or block tridiagonal matrix with N+1 blocks (e.g. DiagonalBlockMatrix or
+ * TriDiagonalBlockMatrix), whose off-diagonal blocks, if any, are zero. G is the Jacobian of the
+ * dynamics, a block lower bidiagonal matrix (BandBlockMatrix with lower bandwidth 1 and upper bandwidth
+ * 0) with the same blocks of columns as H: its row 0 is -x_0 = r_l,0 (initial state), and its row k+1
+ * is A_k x_k + B_k u_k - x_{k+1} = r_l,k+1. The size of x_k is given by the k-th row of blocks of G. Its
+ * diagonal blocks are thus [-I 0], and are not read, while its subdiagonal blocks are [A_k B_k].
+ *
+ * The factorization (backward recursion) computes, from k = N down to 0,
+ *   P_k = Q_k + A_k^T P_{k+1} A_k - M_k^T (R_k + B_k^T P_{k+1} B_k)^{-1} M_k,
+ * with M_k = S_k + B_k^T P_{k+1} A_k, and the feedback gains K_k = -(R_k + B_k^T P_{k+1} B_k)^{-1} M_k.
+ * R_k + B_k^T P_{k+1} B_k needs to be positive definite. A solve then consists of a backward pass for
+ * the affine terms and a forward pass through the dynamics, u_k = K_k x_k + k_k, l_k = P_k x_k + p_k.
+ *
+ * As for BlockTriDiagonalCholesky, the factorization is split in a symbolic phase (analyzePattern),
+ * which checks the structure and allocates the per-stage workspace once, and a numeric phase
+ * (factorize), which can be repeated on matrices with the same block sizes without reallocation.
+ */
+class MLSM_DLLAPI RiccatiRecursion
+{
+public:
+  RiccatiRecursion() = default;
+  RiccatiRecursion(const BlockMatrix & H, const BlockMatrix & G) { compute(H, G); }
+
+  /** Compute the factorization for \p H and \p G. This is analyzePattern followed by factorize.
+   *
+   * \throw std::runtime_error if the structure of H or G is not the expected one, or if
+   * R_k + B_k^T P_{k+1} B_k is not positive definite for some k.
+   */
+  void compute(const BlockMatrix & H, const BlockMatrix & G);
+
+  /** Symbolic phase: check the structure of \p H and \p G and allocate the workspace. The values of the
+   * blocks are not read.
+   *
+   * \throw std::runtime_error if the structure of H or G is not the expected one.
+   */
+  void analyzePattern(const BlockMatrix & H, const BlockMatrix & G);
+
+  /** Numeric phase: compute the factorization for \p H and \p G, whose block sizes must be the ones
+   * given to the last call to analyzePattern.
+   *
+   * \throw std::runtime_error if the sizes differ from the analyzed ones, or if R_k + B_k^T P_{k+1} B_k
+   * is not positive definite for some k.
+   */
+  void factorize(const BlockMatrix & H, const BlockMatrix & G);
+
+  /** Solve the KKT system, where B = [r_z; r_l] is overwritten by [z; l]. B can have any number of
+   * columns. The solve works in B only: it does not allocate, and several solves with the same
+   * factorization can run concurrently.
+   */
+  void solveInPlace(MatrixRef B) const;
+
+  Eigen::MatrixXd solve(const MatrixConstRef & B) const
+  {
+    Eigen::MatrixXd X = B;
+    solveInPlace(X);
+    return X;
+  }
+
+  /** Number of stages N+1.*/
+  int stages() const { return static_cast<int>(stages_.size()); }
+  /** Size of the KKT system.*/
+  int size() const { return nz_ + nl_; }
+
+private:
+  struct Stage
+  {
+    int nx;                   // Size of x_k
+    int nu;                   // Size of u_k
+    int zOffset;              // Row of z_k in the KKT system
+    int lOffset;              // Row of l_k in the KKT system
+    Eigen::MatrixXd Ht;       // H_k + [A_k B_k]^T P_{k+1} [A_k B_k]
+    Eigen::MatrixXd AB;       // [A_k B_k] (k < N)
+    Eigen::MatrixXd PAB;      // P_{k+1} [A_k B_k] (k < N)
+    Eigen::MatrixXd P;        // P_k
+    Eigen::MatrixXd K;        // K_k
+    Eigen::LLT<Eigen::MatrixXd> llt; // Factorization of R_k + B_k^T P_{k+1} B_k
+  };
+
+  std::vector<Stage> stages_;
+  int nz_ = 0; // Number of rows of H
+  int nl_ = 0; // Number of rows of G
+};
+
+} // namespace mls
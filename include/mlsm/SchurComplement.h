@@ -0,0 +1,105 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/BandDecompositions.h>
+#include <mlsm/BlockTriDiagonalCholesky.h>
+
+#include <Eigen/LU>
+
+namespace mls
+{
+/** Schur complement S = D - C A^{-1} B of the block A of a 2 x 2 block matrix
+ *        | A  B |
+ *    K = |      |
+ *        | C  D |
+ * with square diagonal blocks A and D, as arising e.g. from KKT systems, and solution of K X = R with
+ * it (range-space method):
+ *   S X_2 = R_2 - C A^{-1} R_1,  X_1 = A^{-1} R_1 - A^{-1} B X_2.
+ *
+ * A is never densified. It is factorized according to its structure: a multiple of the identity or a
+ * diagonal matrix is inverted coefficient-wise, a band matrix with BandLU, a band block matrix with
+ * BandLU on its scalar band (obtained through toSparse), or with BlockTriDiagonalCholesky if it is block
+ * tridiagonal (or block diagonal) and declared symmetric positive definite, and a dense matrix with a
+ * partial pivoting LU. Other matrices are converted to dense.
+ *
+ * S is given with the simplest representation among zero, multiple of the identity, diagonal and dense
+ * matrices (see internal::SimpleAccumulator): for example, if A, B and C are diagonal, so is S, and if B
+ * or C is zero, S is D. The same applies to A^{-1} B, which is kept for the solves. S is then factorized
+ * in the same way as A.
+ */
+class MLSM_DLLAPI SchurComplement
+{
+public:
+  SchurComplement() = default;
+  explicit SchurComplement(const BlockMatrix & K, bool positiveDefinite = false) { compute(K, positiveDefinite); }
+
+  /** Compute the Schur complement of the block (0,0) of \p K, and factorize it.
+   *
+   * \param positiveDefinite Declare that A is symmetric positive definite, so that a block tridiagonal
+   * A can be factorized with BlockTriDiagonalCholesky. This is not checked beyond the success of the
+   * factorization, and only the lower part of A is then read.
+   *
+   * \throw std::runtime_error if K is not a 2 x 2 block matrix with square diagonal blocks, if A or S
+   * is singular, or if A is declared positive definite but is not.
+   */
+  void compute(const BlockMatrix & K, bool positiveDefinite = false);
+
+  /** The Schur complement S.*/
+  MatrixConstPtr matrix() const { return S_; }
+
+  /** Solve K X = R, where R is overwritten by X. R can have any number of columns. \p K must be the
+   * matrix given to compute.
+   */
+  void solveInPlace(const BlockMatrix & K, MatrixRef R) const;
+
+  Eigen::MatrixXd solve(const BlockMatrix & K, const MatrixConstRef & R) const
+  {
+    Eigen::MatrixXd X = R;
+    solveInPlace(K, X);
+    return X;
+  }
+
+  /** Size of S.*/
+  int size() const { return S_ ? S_->rows() : 0; }
+
+private:
+  /** Factorization of a square matrix, chosen according to its structure.*/
+  class Inverse
+  {
+  public:
+    /** Factorize op(M), where op(M) is M or M^T depending on \p transpose. \p positiveDefinite
+     * declares that M is symmetric positive definite.
+     */
+    void compute(const MatrixBase & M, bool transpose, bool positiveDefinite);
+    /** Solve op(M) X = B, where B is overwritten by X.*/
+    void solveInPlace(MatrixRef B) const;
+    /** op(M)^{-1} as a matrix, if it is a multiple of the identity or diagonal, nullptr otherwise.*/
+    MatrixPtr toMatrix() const;
+
+  private:
+    enum class Kind
+    {
+      MultipleOfIdentity,
+      Diagonal,
+      Band,
+      BlockTriDiagonal,
+      Dense
+    };
+
+    Kind kind_ = Kind::Dense;
+    int size_ = 0;
+    double s_ = 0;                           // Inverse if multiple of identity
+    Eigen::VectorXd d_;                      // Inverse if diagonal
+    BandLU bandLU_;                          // Factorization if band
+    BlockTriDiagonalCholesky blockLLT_;      // Factorization if block tridiagonal and positive definite
+    Eigen::PartialPivLU<Eigen::MatrixXd> lu_; // Factorization otherwise
+  };
+
+  Inverse Ainv_;
+  Inverse Sinv_;
+  MatrixPtr S_;  // Schur complement D - C A^{-1} B
+  MatrixPtr W_;  // A^{-1} B
+};
+
+} // namespace mls
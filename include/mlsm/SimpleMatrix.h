@@ -18,6 +18,27 @@ protected:
   int blkRows() const override { return 1; }
   int blkCols() const override { return 1; }
 
+  /** Write all the elements of the column \p v for sparseCol.*/
+  template<typename Derived>
+  static int writeDenseCol(const Eigen::DenseBase<Derived> & v, int rowOffset, int * inner, double * values)
+  {
+    for(int i = 0; i < static_cast<int>(v.size()); ++i)
+    {
+      if(inner)
+        inner[i] = rowOffset + i;
+      values[i] = v[i];
+    }
+    return static_cast<int>(v.size());
+  }
+  /** Write the single element (c,c) of value \p v for sparseCol.*/
+  static int writeDiagonalElement(int c, double v, int rowOffset, int * inner, double * values)
+  {
+    if(inner)
+      inner[0] = rowOffset + c;
+    values[0] = v;
+    return 1;
+  }
+
   constTransposableMatrix v_block(int r, int c) const override
   {
     assert(r == 0 && c == 0);
@@ -37,6 +58,13 @@ public:
   ZeroMatrix(int r, int c) : shape_(r, c) {}
   const internal::ShapeBase & shape() const override { return shape_; }
   bool isAutoResizable() const override { return true; }
+  void multiply(VectorConstRef x, VectorRef y, double, double beta, bool transpose) const override
+  {
+    assert(x.size() == (transpose ? rows() : cols()) && y.size() == (transpose ? cols() : rows()));
+    scale(y, beta);
+  }
+  int sparseColNNZ(int, bool) const override { return 0; }
+  int sparseCol(int, bool, int, int *, double *) const override { return 0; }
 
 protected:
   double v_coeffRef(int r, int c) const override { return 0; }
@@ -53,6 +81,17 @@ public:
   IdentityMatrix(int r) : shape_(r, r, 0, 0) {}
   const internal::ShapeBase & shape() const override { return shape_; }
   bool isAutoResizable() const override { return true; }
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool) const override
+  {
+    assert(x.size() == rows() && y.size() == rows());
+    scale(y, beta);
+    y += alpha * x;
+  }
+  int sparseColNNZ(int, bool) const override { return 1; }
+  int sparseCol(int c, bool, int rowOffset, int * inner, double * values) const override
+  {
+    return writeDiagonalElement(c, 1, rowOffset, inner, values);
+  }
 
 protected:
   double v_coeffRef(int r, int c) const override { return (r == c) ? 1 : 0; }
@@ -76,7 +115,20 @@ class MLSM_DLLAPI MultipleOfIdentityMatrix : public SimpleMatrix
 public:
   MultipleOfIdentityMatrix(int r, double a) : shape_(r, r, 0, 0), a_(a) {}
   const internal::ShapeBase & shape() const override { return shape_; }
+  /** The multiplicative factor of the identity.*/
+  double value() const { return a_; }
   bool isAutoResizable() const override { return true; }
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool) const override
+  {
+    assert(x.size() == rows() && y.size() == rows());
+    scale(y, beta);
+    y += (alpha * a_) * x;
+  }
+  int sparseColNNZ(int, bool) const override { return 1; }
+  int sparseCol(int c, bool, int rowOffset, int * inner, double * values) const override
+  {
+    return writeDiagonalElement(c, a_, rowOffset, inner, values);
+  }
 
 protected:
   double v_coeffRef(int r, int c) const override { return (r == c) ? a_ : 0; }
@@ -104,12 +156,27 @@ public:
   DiagonalMatrix(const VectorRef & d, NonConstRef_t);
 
   const internal::ShapeBase & shape() const override { return shape_; }
+  /** The diagonal elements of the matrix.*/
+  VectorConstRef diagonal() const { return static_cast<const internal::SimpleStorageDense &>(*diag_).data().col(0); }
+  /** Writable access to the diagonal elements. Throws if the matrix was built on constant data.*/
+  VectorRef diagonal() { return diag_->data().col(0); }
   bool isAutoResizable() const override { return false; }
   void toDense(MatrixRef D, bool) const override
   {
     assert(D.rows() == D.cols());
     D.setZero();
-    D.diagonal() = diag_->data();
+    D.diagonal() = static_cast<const internal::SimpleStorageDense &>(*diag_).data();
+  }
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool) const override
+  {
+    assert(x.size() == rows() && y.size() == rows());
+    scale(y, beta);
+    y += alpha * static_cast<const internal::SimpleStorageDense &>(*diag_).data().col(0).cwiseProduct(x);
+  }
+  int sparseColNNZ(int, bool) const override { return 1; }
+  int sparseCol(int c, bool, int rowOffset, int * inner, double * values) const override
+  {
+    return writeDiagonalElement(c, diagonal()[c], rowOffset, inner, values);
   }
 
 protected:
@@ -131,13 +198,36 @@ public:
   DenseMatrix(const MatrixRef & M, NonConstRef_t);
 
   const internal::ShapeBase & shape() const override { return shape_; }
+  /** The elements of the matrix.*/
+  MatrixConstRef matrix() const { return static_cast<const internal::SimpleStorageDense &>(*mat_).data(); }
+  /** Writable access to the elements. Throws if the matrix was built on constant data.*/
+  MatrixRef matrix() { return mat_->data(); }
   bool isAutoResizable() const override { return false; }
   void toDense(MatrixRef D, bool transpose) const override
   {
+    const auto & M = static_cast<const internal::SimpleStorageDense &>(*mat_).data();
+    if(transpose)
+      D = M.transpose();
+    else
+      D = M;
+  }
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const override
+  {
+    assert(x.size() == (transpose ? rows() : cols()) && y.size() == (transpose ? cols() : rows()));
+    const auto & M = static_cast<const internal::SimpleStorageDense &>(*mat_).data();
+    scale(y, beta);
+    if(transpose)
+      y.noalias() += alpha * M.transpose() * x;
+    else
+      y.noalias() += alpha * M * x;
+  }
+  int sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const override
+  {
+    const auto & M = static_cast<const internal::SimpleStorageDense &>(*mat_).data();
     if(transpose)
-      D = mat_->data().transpose();
+      return writeDenseCol(M.row(c), rowOffset, inner, values);
     else
-      D = mat_->data();
+      return writeDenseCol(M.col(c), rowOffset, inner, values);
   }
 
 protected:
@@ -151,4 +241,138 @@ private:
   internal::DenseShape shape_;
   std::unique_ptr<internal::SimpleStorageDense> mat_;
 };
+
+/** Dense matrix whose elements are stored in single precision.
+ *
+ * Conversion to dense and products are done in double precision, the elements being converted on the
+ * fly, so that such a block can be mixed with any other one in a BlockMatrix. This halves the memory
+ * traffic of memory-bound operations such as matrix-vector products, at the price of the precision of
+ * the stored elements. For the purpose of kernel selection, this matrix is of type
+ * internal::SimpleType::Other.
+ */
+class MLSM_DLLAPI FloatDenseMatrix : public SimpleMatrix
+{
+public:
+  /** Build the matrix with \p M rounded to single precision.*/
+  explicit FloatDenseMatrix(const MatrixConstRef & M)
+  : shape_(static_cast<int>(M.rows()), static_cast<int>(M.cols())), mat_(M.cast<float>())
+  {}
+  explicit FloatDenseMatrix(const Eigen::Ref<const Eigen::MatrixXf> & M)
+  : shape_(static_cast<int>(M.rows()), static_cast<int>(M.cols())), mat_(M)
+  {}
+
+  const internal::ShapeBase & shape() const override { return shape_; }
+  /** The elements of the matrix.*/
+  const Eigen::MatrixXf & matrix() const { return mat_; }
+  /** Writable access to the elements. The matrix must not be resized.*/
+  Eigen::MatrixXf & matrix() { return mat_; }
+  bool isAutoResizable() const override { return false; }
+  void toDense(MatrixRef D, bool transpose) const override
+  {
+    if(transpose)
+      D = mat_.transpose().cast<double>();
+    else
+      D = mat_.cast<double>();
+  }
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const override
+  {
+    assert(x.size() == (transpose ? rows() : cols()) && y.size() == (transpose ? cols() : rows()));
+    scale(y, beta);
+    // Column-wise traversal, so that the elements are read contiguously and only once.
+    if(transpose)
+    {
+      for(Eigen::Index j = 0; j < mat_.cols(); ++j)
+        y[j] += alpha * mat_.col(j).cast<double>().dot(x);
+    }
+    else
+    {
+      for(Eigen::Index j = 0; j < mat_.cols(); ++j)
+        y += (alpha * x[j]) * mat_.col(j).cast<double>();
+    }
+  }
+  int sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const override
+  {
+    if(transpose)
+      return writeDenseCol(mat_.row(c).cast<double>(), rowOffset, inner, values);
+    else
+      return writeDenseCol(mat_.col(c).cast<double>(), rowOffset, inner, values);
+  }
+
+protected:
+  double v_coeffRef(int r, int c) const override { return mat_(r, c); }
+  void v_autoResize(int, int) override { assert(false); }
+
+private:
+  internal::DenseShape shape_;
+  Eigen::MatrixXf mat_;
+};
+
+/** General band matrix: the elements (i,j) with j < i - l or j > i + u are zero, where l and u are the
+ * lower and upper bandwidths (see internal::BandShape).
+ *
+ * The elements of the band are stored column by column in a packed (l + u + 1) x cols matrix, with the
+ * same layout as internal::BandStorageScheme (and as the general band storage of LAPACK): the element
+ * (i,j) is at row u + i - j of column j. The positions of the packed matrix that do not correspond to an
+ * element of the matrix (top left and bottom right corners) are not used. Storage, conversion and
+ * products thus cost O(n (l + u)) instead of O(n^2) with a DenseMatrix.
+ *
+ * For the purpose of kernel selection, this matrix is of type internal::SimpleType::Other. See also
+ * mult(const BandMatrix &, const BandMatrix &, bool, bool), BandLU and BandCholesky.
+ */
+class MLSM_DLLAPI BandMatrix : public SimpleMatrix
+{
+public:
+  /** Zero \p rows x \p cols matrix with the given bandwidths, which need to be non-negative.*/
+  BandMatrix(int rows, int cols, int lowerBandwidth, int upperBandwidth);
+  /** Band part of \p M, the elements of M outside of the band being ignored.*/
+  BandMatrix(const MatrixConstRef & M, int lowerBandwidth, int upperBandwidth);
+
+  const internal::ShapeBase & shape() const override { return shape_; }
+  int lowerBandwidth() const { return l_; }
+  int upperBandwidth() const { return u_; }
+  /** Whether the element (r,c) is in the band.*/
+  bool isInBand(int r, int c) const { return c >= r - l_ && c <= r + u_; }
+  /** The elements of column \p c in the band are on the rows colBegin(c) to colEnd(c) - 1.*/
+  int colBegin(int c) const { return std::max(0, c - u_); }
+  int colEnd(int c) const { return std::min(rows(), c + l_ + 1); }
+
+  /** The packed elements, the element (i,j) being at (upperBandwidth() + i - j, j).*/
+  const Eigen::MatrixXd & data() const { return data_; }
+  /** Writable access to the packed elements. The matrix must not be resized.*/
+  Eigen::MatrixXd & data() { return data_; }
+  /** Writable access to the element (r,c), which needs to be in the band.*/
+  double & coeffRef(int r, int c)
+  {
+    assert(r >= 0 && r < rows() && c >= 0 && c < cols() && isInBand(r, c));
+    return data_(u_ + r - c, c);
+  }
+
+  bool isAutoResizable() const override { return false; }
+  void toDense(MatrixRef D, bool transpose) const override;
+  void multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const override;
+  /** Only the elements of the band are written.*/
+  int sparseColNNZ(int c, bool transpose) const override;
+  int sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const override;
+
+protected:
+  double v_coeffRef(int r, int c) const override { return isInBand(r, c) ? data_(u_ + r - c, c) : 0; }
+  void v_autoResize(int r, int c) override { assert(false); }
+
+private:
+  internal::BandShape shape_;
+  int l_;
+  int u_;
+  Eigen::MatrixXd data_;
+};
+
+/** Compute op(lhs) * op(rhs), where op(M) is M or M^T depending on \p transposeLhs and \p transposeRhs.
+ *
+ * The result is a band matrix whose bandwidths are the sums of the ones of the operands (limited by the
+ * size of the result). Only the products of elements in the bands are computed, for a cost O(n b1 b2)
+ * where b1 and b2 are the bandwidths of the operands.
+ */
+MLSM_DLLAPI std::shared_ptr<BandMatrix> mult(const BandMatrix & lhs,
+                                             const BandMatrix & rhs,
+                                             bool transposeLhs = false,
+                                             bool transposeRhs = false);
 } // namespace mls
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include <Eigen/Core>
 #include <Eigen/Jacobi>
+#include <Eigen/SparseCore>
 
 #include <memory>
 
@@ -13,6 +14,7 @@ using MatrixConstRef = Eigen::Ref<const Eigen::MatrixXd>;
 using MatrixRef = Eigen::Ref<Eigen::MatrixXd>;
 using VectorConstRef = Eigen::Ref<const Eigen::VectorXd>;
 using VectorRef = Eigen::Ref<Eigen::VectorXd>;
+using SparseMatrix = Eigen::SparseMatrix<double>;
 inline const Eigen::MatrixXd EmptyMatrix = Eigen::MatrixXd(0, 0);
 inline const Eigen::VectorXd EmptyVector = Eigen::VectorXd(0);
 
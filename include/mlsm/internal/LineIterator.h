@@ -2,11 +2,11 @@
 
 #pragma once
 
-#include <memory>
+#include <assert.h>
 
 namespace mls::internal
 {
-/** To be specialized for each type a LineIterator can point to
+/** To be specialized for each type a line iterator can point to
  * need to define a static constexpr T End, that will be used as value to
  * signify the end iterator
  */
@@ -16,126 +16,76 @@ struct LineIteratorTraits
   static constexpr T End = {};
 };
 
-/** An iterator-like structure to serve as an underlying implementation of a forward iterator over
- * a "line" of a matrix (i.e a row or a column).
- *
- * \tparam T the type of the dereferenced iterator.
- */
-template<typename T>
-class LineIteratorBase
+template<>
+struct LineIteratorTraits<int>
 {
-public:
-  /** \param l index of the line on which to iterate.*/
-  LineIteratorBase(int l) : l_(l) {}
-  /** Value of the element the iterator currently points to.*/
-  virtual T val() const { return LineIteratorTraits<T>::End; }
-  /** Moving the iterator to the next element.*/
-  virtual void next(){};
-  /** Return the index of the line that is being iterated on.*/
-  int line() const { return l_; }
-
-protected:
-  int l_; // The index of the line in the matrix
+  static constexpr int End = -1;
 };
 
-/** Specific implementation of a LineIteratorBase for when (non-zero) elements in a line are
- * contiguous.
- * 
- * \tparam T the type of the dereferenced iterator.
- */
-template<typename T>
-class ContinuousLineIterator : public LineIteratorBase<T>
-{
-public:
-  /** \param l index of the line on which to iterate.
-   *  \param start initial value
-   *  \param end value after the last valid element
-   */
-  ContinuousLineIterator(int l, const T & start, const T & end) : LineIteratorBase(l), val_(start), end_(end) {}
-  T val() const override { return val_; }
-  void next() override
-  {
-    if(val_ != LineIteratorTraits<T>::End)
-    {
-      ++val_;
-      if(val_ >= end_)
-        val_ = LineIteratorTraits<T>::End;
-    }
-  }
-
-private:
-  T val_; // current value 
-  T end_; // end value (first value after the last valid element) 
-};
-
-/** A class to represent a row or a colum of a matrix-like class.
- * It provides an iterator on its non-zero elements that is based on an underlying
- * LineIteratorBase, as well as \c begin and \c end() methods that makes it compatible with
- * numerous iterator-based idioms of C++.
- * 
- * \tparam T The type of the dereferenced iterator
- * \tparam Provider The class that will provide the underlying row and column iterators, through
- * \c rowIterator and \c colIterator methods.
- * \tparam Row \c true for a row \c false for a column.
+/** A lightweight description of the indices of the (possibly) non-zero elements in a "line" of a
+ * matrix (i.e. a row or a column).
+ *
+ * The indices are either the contiguous range [begin, end), or given explicitly by an external
+ * array (e.g. for sparse patterns), in increasing order. This class does not own any memory, and
+ * iterating over it requires neither heap allocations nor virtual calls.
  */
-template<typename T, class Provider, bool Row>
-class Line
+class IndexLine
 {
 public:
-  using UnderlyingIt = LineIteratorBase<T>;
-  using UnderlyingItPtr = std::unique_ptr<UnderlyingIt>;
-  /** A forward iterator wrapping a LineIteratorBase, with basic operator defines
-   *
-   * \internal We have this wrapping to allow for different implementation of the iterator, made by
-   * deriving LineIteratorBase, but keep an iterator interface on top of the virtual calls.
+  /** A forward iterator on the indices of the line.
+   * Dereferencing the end iterator returns LineIteratorTraits<int>::End.
    */
   class Iterator
   {
   public:
     Iterator & operator++()
     {
-      it_->next();
+      ++k_;
       return *this;
     }
-    T operator*() const { return it_->val(); }
-
-    friend bool operator==(const Iterator & a, const Iterator & b)
+    int operator*() const
     {
-      return a.it_->line() == b.it_->line() && *a == *b;
-    };
+      if(k_ >= end_)
+        return LineIteratorTraits<int>::End;
+      return indices_ ? indices_[k_] : k_;
+    }
+
+    friend bool operator==(const Iterator & a, const Iterator & b) { return a.k_ == b.k_; };
     friend bool operator!=(const Iterator & a, const Iterator & b) { return !(a == b); };
 
   private:
-    Iterator(int l) : it_(new UnderlyingIt(l)) {}
-    Iterator(const Provider & p, int l)
-    {
-      if constexpr(Row)
-        it_ = p.rowIterator(l);
-      else
-        it_ = p.colIterator(l);
-    }
-    UnderlyingItPtr it_;
-    friend class Line<T, Provider, true>;
-    friend class Line<T, Provider, false>;
+    Iterator(int k, int end, const int * indices) : k_(k), end_(end), indices_(indices) {}
+    int k_;
+    int end_;
+    const int * indices_;
+    friend class IndexLine;
   };
 
-  Iterator begin() const { return {p_, l_}; }
-  Iterator end() const { return {l_}; }
+  /** Empty line.*/
+  IndexLine() = default;
+  /** Contiguous indices begin, begin+1, ..., end-1.*/
+  IndexLine(int begin, int end) : begin_(begin), end_(end > begin ? end : begin) {}
+  /** The \p size indices pointed to by \p indices.*/
+  IndexLine(const int * indices, int size) : begin_(0), end_(size), indices_(indices) {}
+
+  Iterator begin() const { return {begin_, end_, indices_}; }
+  Iterator end() const { return {end_, end_, indices_}; }
 
-  /** Return the number of non-zero on the line.*/
-  int size() const
+  /** Number of indices in the line.*/
+  int size() const { return end_ - begin_; }
+  /** The k-th index of the line.*/
+  int operator[](int k) const
   {
-    if constexpr(Row)
-      return p_.rowNNZ(l_);
-    else
-      return p_.colNNZ(l_);
+    assert(k >= 0 && k < size());
+    return indices_ ? indices_[k] : begin_ + k;
   }
+  /** Whether the indices are contiguous.*/
+  bool isContiguous() const { return !indices_; }
 
 private:
-  Line(const Provider & p, int l) : l_(l), p_(p) {}
-  int l_;
-  const Provider & p_;
-  friend Provider;
+  int begin_ = 0;
+  int end_ = 0;
+  const int * indices_ = nullptr;
 };
 
-}
\ No newline at end of file
+} // namespace mls::internal
@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <memory>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace mls::internal
 {
@@ -24,24 +26,17 @@ enum class ShapeType
 class ShapeBase;
 using ShapePtr = std::unique_ptr<ShapeBase>;
 
-template<>
-struct LineIteratorTraits<int>
-{
-  static constexpr int End = -1;
-};
-
 /** Describe the size of a matrix and its non-zero pattern, i.e. where the (possibly) non-zero
  * elements can be found.
  */
 class ShapeBase
 {
 public:
-  template<bool Row>
-  using Line = Line<int, ShapeBase, Row>;
-  using Row = Line<true>;
-  using Col = Line<false>;
+  using Row = IndexLine;
+  using Col = IndexLine;
 
   ShapeBase(int rows, int cols) : rows_(rows), cols_(cols) { assert(rows >= 0 && cols >= 0); }
+  virtual ~ShapeBase() = default;
 
   virtual ShapeType type() const = 0;
   virtual ShapePtr copy() const = 0;
@@ -69,33 +64,28 @@ public:
     return colNNZ_(c);
   }
 
+  /** Indices of the (possibly) non-zero elements on row \p r.
+   * Iterating over the returned line does not allocate.
+   */
   Row row(int r) const
   {
     assert(checkRowIndex(r));
-    return {*this, r};
+    return row_(r);
   }
+  /** Indices of the (possibly) non-zero elements on column \p c.
+   * Iterating over the returned line does not allocate.
+   */
   Col col(int c) const
   {
     assert(checkColIndex(c));
-    return {*this, c};
-  }
-
-  typename Row::UnderlyingItPtr rowIterator(int r) const
-  {
-    assert(checkRowIndex(r));
-    return rowIterator_(r);
-  }
-  typename Col::UnderlyingItPtr colIterator(int c) const
-  {
-    assert(checkColIndex(c));
-    return colIterator_(c);
+    return col_(c);
   }
 
 protected:
   virtual int rowNNZ_(int r) const = 0;
   virtual int colNNZ_(int c) const = 0;
-  virtual typename Row::UnderlyingItPtr rowIterator_(int r) const = 0;
-  virtual typename Col::UnderlyingItPtr colIterator_(int c) const = 0;
+  virtual Row row_(int r) const = 0;
+  virtual Col col_(int c) const = 0;
 
 private:
   int rows_;
@@ -116,8 +106,8 @@ public:
 protected:
   int rowNNZ_(int r) const override { return 0; }
   int colNNZ_(int c) const override { return 0; }
-  typename Row::UnderlyingItPtr rowIterator_(int r) const override { return std::make_unique<Row::UnderlyingIt>(r); };
-  typename Col::UnderlyingItPtr colIterator_(int c) const override { return std::make_unique<Col::UnderlyingIt>(c); };
+  Row row_(int r) const override { return {}; }
+  Col col_(int c) const override { return {}; }
 };
 
 /** Describe a matrix band structure, i.e. non-zero are the elements a_{i,j} such that
@@ -171,17 +161,11 @@ protected:
   int cBegin(int c) const { return std::clamp(c - upperBandwidth_.toInt(rows()), 0, rows()); }
   int rEnd(int r) const { return std::clamp(r + upperBandwidth_.toInt(cols()) + 1, 0, cols()); }
   int cEnd(int c) const { return std::clamp(c + lowerBandwidth_.toInt(rows()) + 1, 0, rows()); }
-  int rowNNZ_(int r) const override { return rEnd(r) - rBegin(r); }
-  int colNNZ_(int c) const override { return cEnd(c) - cBegin(c); }
+  int rowNNZ_(int r) const override { return std::max(0, rEnd(r) - rBegin(r)); }
+  int colNNZ_(int c) const override { return std::max(0, cEnd(c) - cBegin(c)); }
 
-  typename Row::UnderlyingItPtr rowIterator_(int r) const override
-  {
-    return Row::UnderlyingItPtr(new ContinuousLineIterator<int>(r, rBegin(r), rEnd(r)));
-  }
-  typename Col::UnderlyingItPtr colIterator_(int c) const override
-  {
-    return Row::UnderlyingItPtr(new ContinuousLineIterator<int>(c, cBegin(c), cEnd(c)));
-  };
+  Row row_(int r) const override { return {rBegin(r), rEnd(r)}; }
+  Col col_(int c) const override { return {cBegin(c), cEnd(c)}; }
 
 private:
   Size lowerBandwidth_;
@@ -201,26 +185,141 @@ public:
 protected:
   int rowNNZ_(int r) const override { return cols(); }
   int colNNZ_(int c) const override { return rows(); }
-  typename Row::UnderlyingItPtr rowIterator_(int r) const override
-  {
-    return Row::UnderlyingItPtr(new ContinuousLineIterator<int>(r, 0, cols()));
-  }
-  typename Col::UnderlyingItPtr colIterator_(int c) const override
-  {
-    return Col::UnderlyingItPtr(new ContinuousLineIterator<int>(c, 0, rows()));
-  }
+  Row row_(int r) const override { return {0, cols()}; }
+  Col col_(int c) const override { return {0, rows()}; }
 };
 
-/** Shape for general sparse matrices*/
+/** Shape for general sparse matrices.
+ *
+ * The pattern of non-zero elements is stored both in compressed sparse row (CSR) and compressed
+ * sparse column (CSC) formats, so that the elements of a row or a column are given by contiguous
+ * arrays of increasing indices.
+ */
 class SparseShape : public ShapeBase
 {
 public:
-  // SparseShape(int rows, int cols) : ShapeBase(rows, cols) {}
+  /** Shape of a \p rows x \p cols matrix whose non-zero elements are at the positions (r,c) given
+   * by \p nonZeros, in any order. Duplicated positions are ignored.
+   */
+  SparseShape(int rows, int cols, std::vector<std::pair<int, int>> nonZeros) : ShapeBase(rows, cols)
+  {
+    std::sort(nonZeros.begin(), nonZeros.end());
+    nonZeros.erase(std::unique(nonZeros.begin(), nonZeros.end()), nonZeros.end());
+    for(const auto & [r, c] : nonZeros)
+    {
+      if(!checkIndices(r, c))
+        throw std::runtime_error("[SparseShape::SparseShape] Non-zero element out of the matrix.");
+    }
+    const int nnz = static_cast<int>(nonZeros.size());
+
+    // CSR, directly from the sorted elements
+    rowStart_.assign(rows + 1, 0);
+    colIndices_.resize(nnz);
+    for(int k = 0; k < nnz; ++k)
+    {
+      ++rowStart_[nonZeros[k].first + 1];
+      colIndices_[k] = nonZeros[k].second;
+    }
+    for(int r = 0; r < rows; ++r)
+      rowStart_[r + 1] += rowStart_[r];
+
+    // CSC, by a counting sort on the columns. Going through the elements in CSR order ensures the
+    // row indices are increasing in each column.
+    colStart_.assign(cols + 1, 0);
+    for(int c : colIndices_)
+      ++colStart_[c + 1];
+    for(int c = 0; c < cols; ++c)
+      colStart_[c + 1] += colStart_[c];
+    std::vector<int> next(colStart_.begin(), colStart_.end() - 1);
+    rowIndices_.resize(nnz);
+    csrToCsc_.resize(nnz);
+    cscToCsr_.resize(nnz);
+    for(int k = 0; k < nnz; ++k)
+    {
+      int p = next[colIndices_[k]]++;
+      rowIndices_[p] = nonZeros[k].first;
+      csrToCsc_[k] = p;
+      cscToCsr_[p] = k;
+    }
+  }
+
   ShapeType type() const override { return ShapeType::Sparse; }
-  // ShapePtr copy() const override { return ShapePtr(new SparseShape(rows(),
-  // cols())); }
+  ShapePtr copy() const override { return ShapePtr(new SparseShape(*this)); }
+
+  ShapePtr transposed() const override
+  {
+    return ShapePtr(new SparseShape(cols(), rows(), colStart_, rowIndices_, rowStart_, colIndices_, cscToCsr_,
+                                    csrToCsc_));
+  }
 
-  // TODO
+  /** Total number of non-zero elements.*/
+  int nnz() const { return static_cast<int>(colIndices_.size()); }
+
+  bool isNonZero(int r, int c) const { return csrPosition(r, c) >= 0; }
+
+  /** Position of the element (r,c) in the CSR arrays, or -1 if the element is zero.*/
+  int csrPosition(int r, int c) const
+  {
+    assert(checkIndices(r, c));
+    return find(colIndices_, rowStart_[r], rowStart_[r + 1], c);
+  }
+  /** Position of the element (r,c) in the CSC arrays, or -1 if the element is zero.*/
+  int cscPosition(int r, int c) const
+  {
+    assert(checkIndices(r, c));
+    return find(rowIndices_, colStart_[c], colStart_[c + 1], r);
+  }
+
+  /** CSR format: the column indices of the non-zero elements of row r are
+   * colIndices()[rowStart()[r]], ..., colIndices()[rowStart()[r+1]-1].
+   */
+  const std::vector<int> & rowStart() const { return rowStart_; }
+  const std::vector<int> & colIndices() const { return colIndices_; }
+  /** CSC format: the row indices of the non-zero elements of column c are
+   * rowIndices()[colStart()[c]], ..., rowIndices()[colStart()[c+1]-1].
+   */
+  const std::vector<int> & colStart() const { return colStart_; }
+  const std::vector<int> & rowIndices() const { return rowIndices_; }
+  /** Position in the CSC arrays of the k-th element in the CSR arrays.*/
+  int csrToCsc(int k) const { return csrToCsc_[k]; }
+  /** Position in the CSR arrays of the k-th element in the CSC arrays.*/
+  int cscToCsr(int k) const { return cscToCsr_[k]; }
+
+protected:
+  int rowNNZ_(int r) const override { return rowStart_[r + 1] - rowStart_[r]; }
+  int colNNZ_(int c) const override { return colStart_[c + 1] - colStart_[c]; }
+  Row row_(int r) const override { return {colIndices_.data() + rowStart_[r], rowNNZ_(r)}; }
+  Col col_(int c) const override { return {rowIndices_.data() + colStart_[c], colNNZ_(c)}; }
+
+private:
+  SparseShape(int rows,
+              int cols,
+              std::vector<int> rowStart,
+              std::vector<int> colIndices,
+              std::vector<int> colStart,
+              std::vector<int> rowIndices,
+              std::vector<int> csrToCsc,
+              std::vector<int> cscToCsr)
+  : ShapeBase(rows, cols), rowStart_(std::move(rowStart)), colIndices_(std::move(colIndices)),
+    colStart_(std::move(colStart)), rowIndices_(std::move(rowIndices)), csrToCsc_(std::move(csrToCsc)),
+    cscToCsr_(std::move(cscToCsr))
+  {
+  }
+
+  /** Position of i in the sorted range indices[begin, end), -1 if not found.*/
+  static int find(const std::vector<int> & indices, int begin, int end, int i)
+  {
+    auto last = indices.begin() + end;
+    auto it = std::lower_bound(indices.begin() + begin, last, i);
+    return (it != last && *it == i) ? static_cast<int>(it - indices.begin()) : -1;
+  }
+
+  std::vector<int> rowStart_;   // CSR row pointers (size rows+1)
+  std::vector<int> colIndices_; // CSR column indices (size nnz)
+  std::vector<int> colStart_;   // CSC column pointers (size cols+1)
+  std::vector<int> rowIndices_; // CSC row indices (size nnz)
+  std::vector<int> csrToCsc_;
+  std::vector<int> cscToCsr_;
 };
 
 inline ShapeType mult(ShapeType lhs, ShapeType rhs)
@@ -235,9 +334,9 @@ inline ShapeType mult(ShapeType lhs, ShapeType rhs)
   // clang-format off
   ShapeType table[] = {/*     | E | B | D | S | U */
                        /* E*/   E,  E,  E,  E,  E,
-                       /* B*/   E,  B,  D,  U,  U,
+                       /* B*/   E,  B,  D,  S,  U,
                        /* D*/   E,  D,  D,  D,  D,
-                       /* S*/   E,  U,  D,  S,  U,
+                       /* S*/   E,  S,  D,  S,  U,
                        /* U*/   E,  U,  D,  U,  U};
   // clang-format on
 
@@ -255,9 +354,9 @@ inline ShapePtr mult(const ShapeBase & lhs, const ShapeBase & rhs)
   // Table of cases
   //    | E | B | D | S
   //  E | 1 | 1 | 1 | 1
-  //  B | 1 | 3 | 2 | X
+  //  B | 1 | 3 | 2 | 4
   //  D | 1 | 2 | 2 | 2
-  //  S | 1 | X | 2 | X
+  //  S | 1 | 4 | 2 | 4
 
   // Case 1
   if(lhs.type() == ShapeType::Empty || rhs.type() == ShapeType::Empty)
@@ -276,6 +375,30 @@ inline ShapePtr mult(const ShapeBase & lhs, const ShapeBase & rhs)
                                        l.upperBandwidth() + r.upperBandwidth());
   }
 
+  // Case 4: exact pattern, computed row by row (symbolic phase of Gustavson's algorithm). The
+  // non-zeros of row i of the product are the union of the non-zeros of the rows k of rhs, for k
+  // a non-zero of row i of lhs.
+  if(lhs.type() == ShapeType::Sparse || rhs.type() == ShapeType::Sparse)
+  {
+    std::vector<std::pair<int, int>> nonZeros;
+    std::vector<int> marker(cols, -1); // marker[j] == i if (i,j) has already been found
+    for(int i = 0; i < rows; ++i)
+    {
+      for(int k : lhs.row(i))
+      {
+        for(int j : rhs.row(k))
+        {
+          if(marker[j] != i)
+          {
+            marker[j] = i;
+            nonZeros.emplace_back(i, j);
+          }
+        }
+      }
+    }
+    return std::make_unique<SparseShape>(rows, cols, std::move(nonZeros));
+  }
+
   throw std::runtime_error("[mult(ShapeBase, ShapeBase)] Non implemented cases.");
 }
 
@@ -291,9 +414,9 @@ inline ShapeType add(ShapeType lhs, ShapeType rhs)
   // clang-format off
   ShapeType table[] = {/*     | E | B | D | S | U */
                        /* E*/   E,  B,  D,  S,  U,
-                       /* B*/   B,  B,  D,  U,  U,
+                       /* B*/   B,  B,  D,  S,  U,
                        /* D*/   D,  D,  D,  D,  D,
-                       /* S*/   S,  U,  D,  S,  U,
+                       /* S*/   S,  S,  D,  S,  U,
                        /* U*/   U,  U,  D,  U,  U};
   // clang-format on
 
@@ -309,9 +432,9 @@ inline ShapePtr add(const ShapeBase & lhs, const ShapeBase & rhs)
   // Table of cases
   //    | E | B | D | S
   //  E | 1 | 1 | 1 | 1
-  //  B | 1 | 3 | 2 | X
+  //  B | 1 | 3 | 2 | 4
   //  D | 1 | 2 | 2 | 2
-  //  S | 1 | X | 2 | X
+  //  S | 1 | 4 | 2 | 4
 
   // Case 1
   if(lhs.type() == ShapeType::Empty)
@@ -332,6 +455,20 @@ inline ShapePtr add(const ShapeBase & lhs, const ShapeBase & rhs)
                                        std::max(l.upperBandwidth(), r.upperBandwidth()));
   }
 
+  // Case 4: union of the patterns
+  if(lhs.type() == ShapeType::Sparse || rhs.type() == ShapeType::Sparse)
+  {
+    std::vector<std::pair<int, int>> nonZeros;
+    for(int i = 0; i < rows; ++i)
+    {
+      for(int j : lhs.row(i))
+        nonZeros.emplace_back(i, j);
+      for(int j : rhs.row(i))
+        nonZeros.emplace_back(i, j);
+    }
+    return std::make_unique<SparseShape>(rows, cols, std::move(nonZeros));
+  }
+
   throw std::runtime_error("[add(ShapeBase, ShapeBase)] Non implemented cases.");
 }
 
@@ -0,0 +1,45 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/internal/SimpleType.h>
+
+namespace mls::internal
+{
+/** Accumulate sums of (products of) matrices into a single matrix, while keeping the simplest
+ * representation possible among zero, multiple of identity, diagonal and dense matrices.
+ *
+ * The kernels used depend on the type of the operands, so that e.g. the product of a multiple of the
+ * identity with a dense matrix is simply a scaled addition, and the product of two diagonal matrices
+ * is done coefficient-wise.
+ */
+class MLSM_DLLAPI SimpleAccumulator
+{
+public:
+  SimpleAccumulator(int rows, int cols);
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  SimpleType type() const { return type_; }
+
+  /** this += alpha * A */
+  void add(const constTransposableMatrix & A, double alpha = 1);
+  /** this += alpha * A * B */
+  void addProduct(const constTransposableMatrix & A, const constTransposableMatrix & B, double alpha = 1);
+
+  /** Create a new matrix with the accumulated value.*/
+  MatrixPtr toMatrix() const;
+
+private:
+  /** Change the representation to type \p t, if \p t is more general than the current type.*/
+  void promote(SimpleType t);
+
+  int rows_;
+  int cols_;
+  SimpleType type_ = SimpleType::Zero;
+  double s_ = 0;      // Value for multiple of identity
+  Eigen::VectorXd d_; // Value for diagonal
+  Eigen::MatrixXd M_; // Value for dense
+};
+
+} // namespace mls::internal
@@ -0,0 +1,33 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/MatrixBase.h>
+
+namespace mls::internal
+{
+/** Types of matrices for which block kernels have a dedicated implementation.
+ * The order matters: a type can represent all the types before it.
+ */
+enum class SimpleType
+{
+  Zero = 0,
+  MultipleOfIdentity, // Include the identity
+  Diagonal,
+  Dense,
+  Other // Any other matrix, including block matrices
+};
+
+/** Return the type of \p M for the purpose of kernel selection.*/
+MLSM_DLLAPI SimpleType simpleType(const MatrixBase & M);
+
+/** Multiplicative factor of a matrix \p M of type SimpleType::MultipleOfIdentity.*/
+MLSM_DLLAPI double identityFactor(const MatrixBase & M);
+
+/** Diagonal of a matrix \p M of type SimpleType::Diagonal.*/
+MLSM_DLLAPI VectorConstRef diagonalData(const MatrixBase & M);
+
+/** Elements of a matrix \p M of type SimpleType::Dense.*/
+MLSM_DLLAPI MatrixConstRef denseData(const MatrixBase & M);
+
+} // namespace mls::internal
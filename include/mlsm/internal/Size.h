@@ -3,6 +3,8 @@
 #pragma once
 
 #include <assert.h>
+#include <cmath>
+#include <limits>
 #include <numeric>
 
 #define MLSM_BANDSIZE_OPERATION_DOES_NOT_OVERFLOW(op, a, b, lim) (std::abs(double(a) op double(b)) < lim)
@@ -5,6 +5,7 @@
 #include <mlsm/internal/Shape.h>
 
 #include <assert.h>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -33,58 +34,101 @@ public:
     }
   };
 
-  /** A default implementation of LineIteratorBase that uses the line iterator of the shape for
-   * getting the place of the element in the line and retrieves the index in the storage (and need
-   * to transpose) by simply calling the \c index function of the storage scheme.
-   * 
-   * This might not be efficient for some storage scheme, in which case a dedicated implementation
-   * should be used.
+  /** A lightweight description of a line (row or column) of a storage scheme.
+   *
+   * The elements of the line are at the places given by an IndexLine of the shape. The line is
+   * split into two segments [0, split) and [split, size) (the second one being possibly empty), so
+   * that within each segment, the need to transpose is constant and, unless explicit storage
+   * indices are given, the storage index is an affine function of the element rank: the k-th
+   * element of a segment starting with index idx0 has index idx0 + k * step. This is in particular
+   * the case for the band and dense storages, where a symmetric storage needs two segments, one on
+   * each side of the diagonal.
+   *
+   * Iterating over a line requires neither heap allocations nor virtual calls.
    */
-  template<bool Row>
-  class LineIterator : public Line<LineIterValue, StorageScheme, Row>::UnderlyingIt
+  class Line
   {
   public:
-    using Base = typename Line<LineIterValue, StorageScheme, Row>::UnderlyingIt;
-    LineIterator(int l, const StorageScheme & s)
-    : Base(l), shapeIt_(shapeLine(l, s).begin()), shapeItEnd_(shapeLine(l, s).end()), scheme_(s)
+    struct Segment
     {
-      assign();
-    }
-    LineIterValue val() const override { return v_; }
-    void next() override
+      int idx0 = 0;    // Storage index of the first element of the segment
+      int step = 0;    // Difference of storage index between two consecutive elements
+      bool tr = false; // Need to transpose the elements of the segment
+    };
+
+    /** A forward iterator on a line, dereferencing to LineIterValue. It is valid as long as the
+     * line it was obtained from is.
+     * Dereferencing the end iterator returns LineIterValue{}.
+     */
+    class Iterator
     {
-      if(++shapeIt_ != shapeItEnd_)
-        assign();
-      else
-        v_ = {};
+    public:
+      Iterator & operator++()
+      {
+        ++k_;
+        return *this;
+      }
+      LineIterValue operator*() const
+      {
+        if(k_ >= line_->size())
+          return {};
+        return line_->value(k_);
+      }
+
+      friend bool operator==(const Iterator & a, const Iterator & b) { return a.k_ == b.k_; };
+      friend bool operator!=(const Iterator & a, const Iterator & b) { return !(a == b); };
+
+    private:
+      Iterator(const Line * line, int k) : line_(line), k_(k) {}
+      const Line * line_;
+      int k_;
+      friend class Line;
     };
 
-  private:
-    const auto & shapeLine(int l, const StorageScheme & s)
+    Line() = default;
+    /** \param positions places of the elements in the line.
+     *  \param split rank of the first element of the second segment.
+     *  \param first description of the first segment.
+     *  \param second description of the second segment.
+     *  \param indices if not null, explicit storage indices of the elements (idx0 and step of the
+     *  segments are then ignored).
+     */
+    Line(const IndexLine & positions,
+         int split,
+         const Segment & first,
+         const Segment & second,
+         const int * indices = nullptr)
+    : positions_(positions), split_(split), first_(first), second_(second), indices_(indices)
     {
-      if constexpr(Row)
-        return s.shape().row(l);
-      else
-        return s.shape().col(l);
+      assert(split >= 0 && split <= positions.size());
     }
-    void assign()
+
+    Iterator begin() const { return {this, 0}; }
+    Iterator end() const { return {this, size()}; }
+
+    /** Number of elements in the line.*/
+    int size() const { return positions_.size(); }
+
+    /** Value for the k-th element of the line.*/
+    LineIterValue value(int k) const
     {
-      v_.i = *shapeIt_;
-      if constexpr(Row)
-        std::tie(v_.idx, v_.tr) = scheme_.index(line(), v_.i);
-      else
-        std::tie(v_.idx, v_.tr) = scheme_.index(v_.i, line());
+      assert(k >= 0 && k < size());
+      const bool f = k < split_;
+      const Segment & s = f ? first_ : second_;
+      int idx = indices_ ? indices_[k] : s.idx0 + (f ? k : k - split_) * s.step;
+      return {positions_[k], idx, s.tr};
     }
-    typename ShapeBase::Line<Row>::Iterator shapeIt_;
-    typename ShapeBase::Line<Row>::Iterator shapeItEnd_;
-    const StorageScheme & scheme_;
-    LineIterValue v_;
+
+  private:
+    IndexLine positions_;
+    int split_ = 0;
+    Segment first_;
+    Segment second_;
+    const int * indices_ = nullptr;
   };
 
-  using Row = Line<LineIterValue, StorageScheme, true>;
-  using Col = Line<LineIterValue, StorageScheme, false>;
-  using RowIterator = LineIterator<true>;
-  using ColIterator = LineIterator<false>;
+  using Row = Line;
+  using Col = Line;
 
   StorageScheme(SymmetricStorage symmetric) : shape_(nullptr), symmetric_(symmetric) {}
 
@@ -97,7 +141,7 @@ public:
   const ShapeBase & shape() const { return *shape_; }
 
   /** Return true if stored.*/
-  virtual bool isStored(int r, int c) const
+  bool isStored(int r, int c) const
   {
     assert(shape_->checkIndices(r, c));
     return isStored_(r, c);
@@ -106,7 +150,7 @@ public:
    * vector and transpose indicates if the stored matrix needs to be transposed.
    * Return index = -1 if the block is a non-stored empty matrix.
    */
-  virtual std::pair<int, bool> index(int r, int c) const
+  std::pair<int, bool> index(int r, int c) const
   {
     assert(shape_->checkIndices(r, c));
     return index_(r, c);
@@ -114,11 +158,22 @@ public:
 
   virtual int size() const = 0;
 
-  Row row(int r) const { return {*this, r}; }
-  Col col(int c) const { return {*this, c}; }
-
-  virtual typename Row::UnderlyingItPtr rowIterator(int r) const { return std::make_unique<RowIterator>(r, *this); }
-  virtual typename Col::UnderlyingItPtr colIterator(int c) const { return std::make_unique<ColIterator>(c, *this); }
+  /** Elements of row \p r, with their place in the storage.
+   * Iterating over the returned line does not allocate.
+   */
+  Row row(int r) const
+  {
+    assert(shape_->checkRowIndex(r));
+    return row_(r);
+  }
+  /** Elements of column \p c, with their place in the storage.
+   * Iterating over the returned line does not allocate.
+   */
+  Col col(int c) const
+  {
+    assert(shape_->checkColIndex(c));
+    return col_(c);
+  }
 
 protected:
   bool isSymmetric() const { return symmetric_ != SymmetricStorage::None; }
@@ -126,6 +181,52 @@ protected:
   virtual bool isStored_(int r, int c) const = 0;
   virtual std::pair<int, bool> index_(int r, int c) const = 0;
 
+  /** Default implementation for the lines, that is valid for storages where, on each side of the
+   * diagonal, the storage index is an affine function of the place of an element in the line. The
+   * segments are then deduced from calls to \c index_.
+   *
+   * Storage schemes that do not have this property need to override these methods.
+   */
+  virtual Row row_(int r) const { return affineLine<true>(r, shape_->row(r)); }
+  virtual Col col_(int c) const { return affineLine<false>(c, shape_->col(c)); }
+
+  template<bool IsRow>
+  Line affineLine(int l, const IndexLine & positions) const
+  {
+    auto index = [this, l](int i) { return IsRow ? index_(l, i) : index_(i, l); };
+    auto segment = [&](int k0, int k1) {
+      Line::Segment s;
+      if(k1 > k0)
+      {
+        std::tie(s.idx0, s.tr) = index(positions[k0]);
+        if(k1 > k0 + 1)
+          s.step = index(positions[k0 + 1]).first - s.idx0;
+      }
+      return s;
+    };
+
+    const int n = positions.size();
+    int split = n;
+    if(isSymmetric())
+    {
+      // For a symmetric storage, the elements before the diagonal are taken from the other side of
+      // the diagonal. The diagonal element is never transposed and goes with the segment whose
+      // elements are not transposed.
+      const int lim = (IsRow == (symmetric_ == SymmetricStorage::Lower)) ? l + 1 : l;
+      // Binary search of the first element whose place is not before lim
+      int k0 = 0;
+      while(k0 < split)
+      {
+        int k = (k0 + split) / 2;
+        if(positions[k] < lim)
+          k0 = k + 1;
+        else
+          split = k;
+      }
+    }
+    return {positions, split, segment(0, split), segment(split, n)};
+  }
+
   const ShapeBase * shape_;
   SymmetricStorage symmetric_;
 };
@@ -252,4 +353,99 @@ private:
   int ue_ = 0;
 };
 
+/** Storage for sparse matrices
+ *
+ * The non-zero elements are stored column by column, in the order of the CSC representation of the
+ * shape. For symmetric matrices, the pattern of the shape must be symmetric and only the elements
+ * of the lower or upper part are stored, still column by column.
+ */
+class SparseStorageScheme : public StorageScheme
+{
+public:
+  SparseStorageScheme(SymmetricStorage s = SymmetricStorage::None) : StorageScheme(s) {}
+  int size() const override { return size_; }
+
+protected:
+  void processShape_() override
+  {
+    assert(dynamic_cast<const SparseShape *>(shape_));
+    const auto & s = shape();
+    const int nnz = s.nnz();
+
+    // Storage index of each element of the shape, in CSC order, then in CSR order
+    cscIdx_.assign(nnz, -1);
+    size_ = 0;
+    for(int c = 0; c < s.cols(); ++c)
+    {
+      for(int k = s.colStart()[c]; k < s.colStart()[c + 1]; ++k)
+      {
+        if(!isTransposed(s.rowIndices()[k], c))
+          cscIdx_[k] = size_++;
+      }
+    }
+    for(int c = 0; c < s.cols(); ++c)
+    {
+      for(int k = s.colStart()[c]; k < s.colStart()[c + 1]; ++k)
+      {
+        const int r = s.rowIndices()[k];
+        if(isTransposed(r, c))
+        {
+          const int p = s.cscPosition(c, r);
+          if(p < 0)
+            throw std::runtime_error("[SparseStorageScheme::processShape_] Symmetric storage requires a symmetric "
+                                     "pattern.");
+          cscIdx_[k] = cscIdx_[p];
+        }
+      }
+    }
+    csrIdx_.resize(nnz);
+    for(int k = 0; k < nnz; ++k)
+      csrIdx_[k] = cscIdx_[s.csrToCsc(k)];
+  }
+
+  bool isStored_(int r, int c) const override { return shape().isNonZero(r, c) && !isTransposed(r, c); }
+
+  std::pair<int, bool> index_(int r, int c) const override
+  {
+    const int k = shape().cscPosition(r, c);
+    if(k < 0)
+      return {-1, false};
+    return {cscIdx_[k], isTransposed(r, c)};
+  }
+
+  Row row_(int r) const override { return line<true>(r, shape().row(r), csrIdx_.data() + shape().rowStart()[r]); }
+  Col col_(int c) const override { return line<false>(c, shape().col(c), cscIdx_.data() + shape().colStart()[c]); }
+
+private:
+  const SparseShape & shape() const { return static_cast<const SparseShape &>(*shape_); }
+
+  /** Whether the element (r,c) is obtained by transposing the stored element (c,r).*/
+  bool isTransposed(int r, int c) const
+  {
+    return (symmetric_ == SymmetricStorage::Lower && r < c) || (symmetric_ == SymmetricStorage::Upper && r > c);
+  }
+
+  template<bool IsRow>
+  Line line(int l, const IndexLine & positions, const int * indices) const
+  {
+    if(!isSymmetric())
+      return {positions, positions.size(), {}, {}, indices};
+
+    // Same split as in affineLine: the elements placed before lim are on one side of the diagonal.
+    const bool lowerRow = IsRow == (symmetric_ == SymmetricStorage::Lower);
+    const int lim = lowerRow ? l + 1 : l;
+    int split = 0;
+    while(split < positions.size() && positions[split] < lim)
+      ++split;
+    Line::Segment first, second;
+    first.tr = !lowerRow;
+    second.tr = lowerRow;
+    return {positions, split, first, second, indices};
+  }
+
+  std::vector<int> cscIdx_; // Storage index of the elements of the shape, in CSC order
+  std::vector<int> csrIdx_; // Storage index of the elements of the shape, in CSR order
+  int size_ = 0;
+};
+
 } // namespace mls::internal
\ No newline at end of file
@@ -0,0 +1,156 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BandDecompositions.h>
+
+#include <cmath>
+#include <sstream>
+
+namespace mls
+{
+void BandLU::compute(const BandMatrix & A)
+{
+  if(A.rows() != A.cols())
+    throw std::runtime_error("[BandLU::compute] Matrix must be square.");
+
+  const int n = A.rows();
+  const int u = A.upperBandwidth();
+  l_ = A.lowerBandwidth();
+  ku_ = l_ + u;
+  // A is copied below l rows reserved for the fill-in of U.
+  lu_.resize(2 * l_ + u + 1, n);
+  lu_.topRows(l_).setZero();
+  lu_.bottomRows(l_ + u + 1) = A.data();
+  pivots_.resize(n);
+
+  int ju = 0; // Last column of U reached so far by the row exchanges
+  for(int j = 0; j < n; ++j)
+  {
+    const int km = std::min(l_, n - 1 - j);
+    int p = 0;
+    for(int r = 1; r <= km; ++r)
+    {
+      if(std::abs(at(j + r, j)) > std::abs(at(j + p, j)))
+        p = r;
+    }
+    pivots_[j] = j + p;
+    if(at(j + p, j) == 0)
+    {
+      std::stringstream ss;
+      ss << "[BandLU::compute] Matrix is singular (column " << j << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+
+    ju = std::max(ju, std::min(j + u + p, n - 1));
+    if(p != 0)
+    {
+      for(int c = j; c <= ju; ++c)
+        std::swap(at(j, c), at(j + p, c));
+    }
+
+    if(km > 0)
+    {
+      // Column j of L, and rank-1 update of the rows j+1 to j+km, columns j+1 to ju
+      auto lj = lu_.col(j).segment(ku_ + 1, km);
+      lj /= at(j, j);
+      for(int c = j + 1; c <= ju; ++c)
+      {
+        const double f = at(j, c);
+        if(f != 0)
+          lu_.col(c).segment(ku_ + j + 1 - c, km) -= f * lj;
+      }
+    }
+  }
+}
+
+void BandLU::solveInPlace(MatrixRef B) const
+{
+  const int n = size();
+  assert(B.rows() == n);
+
+  // L Y = P B, applying the row exchanges on the fly
+  for(int j = 0; j < n; ++j)
+  {
+    if(pivots_[j] != j)
+      B.row(j).swap(B.row(pivots_[j]));
+    const int km = std::min(l_, n - 1 - j);
+    if(km > 0)
+      B.middleRows(j + 1, km).noalias() -= lu_.col(j).segment(ku_ + 1, km) * B.row(j);
+  }
+
+  // U X = Y, column by column of U
+  for(int j = n - 1; j >= 0; --j)
+  {
+    B.row(j) /= at(j, j);
+    const int i0 = std::max(0, j - ku_);
+    if(j > i0)
+      B.middleRows(i0, j - i0).noalias() -= lu_.col(j).segment(ku_ + i0 - j, j - i0) * B.row(j);
+  }
+}
+
+void BandCholesky::compute(const BandMatrix & A)
+{
+  if(A.rows() != A.cols())
+    throw std::runtime_error("[BandCholesky::compute] Matrix must be square.");
+
+  const int n = A.rows();
+  l_ = A.lowerBandwidth();
+  L_.resize(l_ + 1, n);
+  for(int j = 0; j < n; ++j)
+  {
+    const int m = std::min(l_ + 1, n - j);
+    L_.col(j).head(m) = A.data().col(j).segment(A.upperBandwidth(), m);
+    L_.col(j).tail(l_ + 1 - m).setZero();
+  }
+
+  for(int j = 0; j < n; ++j)
+  {
+    const double d = at(j, j);
+    if(!(d > 0))
+    {
+      std::stringstream ss;
+      ss << "[BandCholesky::compute] Matrix is not positive definite (column " << j << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+    at(j, j) = std::sqrt(d);
+
+    // Column j of L, and update of the columns j+1 to j+km of the lower part
+    const int km = std::min(l_, n - 1 - j);
+    auto lj = L_.col(j).segment(1, km);
+    lj /= at(j, j);
+    for(int c = j + 1; c <= j + km; ++c)
+      L_.col(c).head(j + km + 1 - c) -= at(c, j) * L_.col(j).segment(c - j, j + km + 1 - c);
+  }
+}
+
+void BandCholesky::solveInPlace(MatrixRef B) const
+{
+  const int n = size();
+  assert(B.rows() == n);
+
+  // L Y = B
+  for(int j = 0; j < n; ++j)
+  {
+    B.row(j) /= at(j, j);
+    const int km = std::min(l_, n - 1 - j);
+    if(km > 0)
+      B.middleRows(j + 1, km).noalias() -= L_.col(j).segment(1, km) * B.row(j);
+  }
+
+  // L^T X = Y
+  for(int j = n - 1; j >= 0; --j)
+  {
+    const int km = std::min(l_, n - 1 - j);
+    if(km > 0)
+      B.row(j).noalias() -= L_.col(j).segment(1, km).transpose() * B.middleRows(j + 1, km);
+    B.row(j) /= at(j, j);
+  }
+}
+
+BandMatrix BandCholesky::matrixL() const
+{
+  BandMatrix L(size(), size(), l_, 0);
+  L.data() = L_;
+  return L;
+}
+
+} // namespace mls
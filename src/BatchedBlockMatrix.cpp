@@ -0,0 +1,346 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BatchedBlockMatrix.h>
+#include <mlsm/internal/StorageScheme.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace mls
+{
+BatchedBlockMatrix::BatchedBlockMatrix(const BlockMatrix & structure, int batchSize)
+: batchSize_(batchSize), shape_(structure.shape().copy())
+{
+  if(batchSize <= 0)
+    throw std::runtime_error("[BatchedBlockMatrix::BatchedBlockMatrix] The batch size must be positive.");
+
+  const int br = structure.blkRows();
+  const int bc = structure.blkCols();
+  rowOffsets_.resize(br + 1, 0);
+  colOffsets_.resize(bc + 1, 0);
+  for(int r = 0; r < br; ++r)
+  {
+    if(structure.rowsOfBlock(r) < 0)
+      throw std::runtime_error("[BatchedBlockMatrix::BatchedBlockMatrix] The size of all rows of blocks must be specified.");
+    rowOffsets_[r + 1] = rowOffsets_[r] + structure.rowsOfBlock(r);
+  }
+  for(int c = 0; c < bc; ++c)
+  {
+    if(structure.colsOfBlock(c) < 0)
+      throw std::runtime_error("[BatchedBlockMatrix::BatchedBlockMatrix] The size of all columns of blocks must be specified.");
+    colOffsets_[c + 1] = colOffsets_[c] + structure.colsOfBlock(c);
+  }
+
+  // Stored blocks are taken in the order of the storage scheme, and each of them is kept in the
+  // orientation it has where it appears non-transposed.
+  const auto & scheme = structure.storageScheme();
+  stored_.resize(scheme.size());
+  rowStart_.reserve(br + 1);
+  for(int r = 0; r < br; ++r)
+  {
+    rowStart_.push_back(static_cast<int>(entries_.size()));
+    for(const auto & e : scheme.row(r))
+    {
+      entries_.push_back({e.i, e.idx, e.tr});
+      auto & s = stored_[e.idx];
+      if(!e.tr && s.r < 0)
+      {
+        s.r = r;
+        s.c = e.i;
+        s.rows = rowsOfBlock(r);
+        s.cols = colsOfBlock(e.i);
+      }
+    }
+  }
+  rowStart_.push_back(static_cast<int>(entries_.size()));
+
+  int n = 0;
+  int maxSize = 0;
+  for(auto & s : stored_)
+  {
+    s.offset = n;
+    n += s.rows * s.cols;
+    maxSize = std::max({maxSize, s.rows, s.cols});
+  }
+  data_.setZero(batchSize_, n);
+  tmp_.resize(maxSize, maxSize);
+}
+
+bool BatchedBlockMatrix::isStored(int r, int c) const { return find(r, c) != nullptr; }
+
+BatchedBlockView<double> BatchedBlockMatrix::block(int r, int c)
+{
+  assert(isStored(r, c) && "Only stored blocks can be written.");
+  return view(data_.data(), r, c);
+}
+
+BatchedBlockView<const double> BatchedBlockMatrix::block(int r, int c) const
+{
+  return view(data_.data(), r, c);
+}
+
+void BatchedBlockMatrix::set(int k, const BlockMatrix & M)
+{
+  assert(k >= 0 && k < batchSize_);
+  if(M.blkRows() != blkRows() || M.blkCols() != blkCols() || M.rows() != rows() || M.cols() != cols())
+    throw std::runtime_error("[BatchedBlockMatrix::set] The matrix does not have the structure of the batch.");
+  for(int r = 0; r < blkRows(); ++r)
+  {
+    if(M.rowsOfBlock(r) != rowsOfBlock(r))
+      throw std::runtime_error("[BatchedBlockMatrix::set] The matrix does not have the structure of the batch.");
+  }
+  for(int c = 0; c < blkCols(); ++c)
+  {
+    if(M.colsOfBlock(c) != colsOfBlock(c))
+      throw std::runtime_error("[BatchedBlockMatrix::set] The matrix does not have the structure of the batch.");
+  }
+
+  for(const auto & s : stored_)
+  {
+    if(s.r < 0)
+      continue;
+    const auto B = M.blockView(s.r, s.c);
+    auto D = tmp_.topLeftCorner(s.rows, s.cols);
+    if(B.matrix)
+      B.matrix->toDense(D, B.trans);
+    else
+      D.setZero();
+    for(int j = 0; j < s.cols; ++j)
+    {
+      for(int i = 0; i < s.rows; ++i)
+        data_(k, s.offset + i + j * s.rows) = D(i, j);
+    }
+  }
+}
+
+void BatchedBlockMatrix::toDense(int k, MatrixRef D) const
+{
+  assert(k >= 0 && k < batchSize_);
+  assert(D.rows() == rows() && D.cols() == cols());
+  D.setZero();
+  for(int r = 0; r < blkRows(); ++r)
+  {
+    for(int e = rowStart_[r]; e < rowStart_[r + 1]; ++e)
+    {
+      const int c = entries_[e].c;
+      auto B = block(r, c);
+      for(int j = 0; j < B.cols(); ++j)
+      {
+        for(int i = 0; i < B.rows(); ++i)
+          D(rowOffsets_[r] + i, colOffsets_[c] + j) = B(i, j)[k];
+      }
+    }
+  }
+}
+
+void BatchedBlockMatrix::multiply(const MatrixConstRef & X, MatrixRef Y, double alpha, double beta, bool transpose) const
+{
+  assert(X.rows() == batchSize_ && Y.rows() == batchSize_);
+  assert(X.cols() == (transpose ? rows() : cols()) && Y.cols() == (transpose ? cols() : rows()));
+  if(beta == 0)
+    Y.setZero();
+  else if(beta != 1)
+    Y *= beta;
+  if(alpha == 0)
+    return;
+
+  // Each coefficient of each stored block contributes to one column of Y, for the whole batch at once.
+  for(int r = 0; r < blkRows(); ++r)
+  {
+    const int ro = rowOffsets_[r];
+    for(int e = rowStart_[r]; e < rowStart_[r + 1]; ++e)
+    {
+      const int co = colOffsets_[entries_[e].c];
+      auto B = view(data_.data(), r, entries_[e].c);
+      for(int j = 0; j < B.cols(); ++j)
+      {
+        for(int i = 0; i < B.rows(); ++i)
+        {
+          if(transpose)
+            Y.col(co + j).array() += alpha * B(i, j).array() * X.col(ro + i).array();
+          else
+            Y.col(ro + i).array() += alpha * B(i, j).array() * X.col(co + j).array();
+        }
+      }
+    }
+  }
+}
+
+const BatchedBlockMatrix::Entry * BatchedBlockMatrix::find(int r, int c) const
+{
+  assert(r >= 0 && r < blkRows() && c >= 0 && c < blkCols());
+  for(int e = rowStart_[r]; e < rowStart_[r + 1]; ++e)
+  {
+    if(entries_[e].c == c)
+      return &entries_[e];
+  }
+  return nullptr;
+}
+
+template<typename T>
+BatchedBlockView<T> BatchedBlockMatrix::view(T * data, int r, int c) const
+{
+  const int rows = rowsOfBlock(r);
+  const int cols = colsOfBlock(c);
+  const Entry * e = find(r, c);
+  if(!e)
+    return {nullptr, batchSize_, rows, cols, 0, 0};
+  // The stored block S is kept in column-major order, and the block (r,c) is S or S^T.
+  const Stored & s = stored_[e->idx];
+  if(e->tr)
+    return {data + static_cast<Eigen::Index>(s.offset) * batchSize_, batchSize_, rows, cols, s.rows, 1};
+  else
+    return {data + static_cast<Eigen::Index>(s.offset) * batchSize_, batchSize_, rows, cols, 1, s.rows};
+}
+
+void BatchedBlockTriDiagonalCholesky::compute(const BatchedBlockMatrix & A)
+{
+  if(A.shape().type() != internal::ShapeType::Band || A.blkRows() != A.blkCols())
+    throw std::runtime_error("[BatchedBlockTriDiagonalCholesky::compute] Matrix must be square block tridiagonal.");
+  const auto & shape = static_cast<const internal::BandShape &>(A.shape());
+  if(shape.lowerBandwidth() > 1 || shape.upperBandwidth() > 1)
+    throw std::runtime_error("[BatchedBlockTriDiagonalCholesky::compute] Matrix must be square block tridiagonal.");
+
+  const int n = A.blkRows();
+  const int N = A.batchSize();
+  stages_.resize(n);
+  batchSize_ = N;
+  size_ = A.rows();
+  for(int i = 0; i < n; ++i)
+  {
+    if(A.rowsOfBlock(i) != A.colsOfBlock(i))
+      throw std::runtime_error("[BatchedBlockTriDiagonalCholesky::compute] Diagonal blocks must be square.");
+    auto & s = stages_[i];
+    s.size = A.rowsOfBlock(i);
+    s.offset = A.rowOffset(i);
+    s.nextSize = (i < n - 1 && A.isStored(i + 1, i)) ? A.rowsOfBlock(i + 1) : 0;
+    s.L.resize(N, s.size * s.size);
+    s.C.resize(N, s.nextSize * s.size);
+  }
+
+  for(int i = 0; i < n; ++i)
+  {
+    auto & s = stages_[i];
+    const int m = s.size;
+    auto L = [&s, m](int a, int j) { return s.L.col(a + j * m).array(); };
+
+    // Lower part of the Schur complement D_i - C_{i-1} C_{i-1}^T
+    const auto D = A.block(i, i);
+    for(int j = 0; j < m; ++j)
+    {
+      for(int a = j; a < m; ++a)
+      {
+        if(D.isZero())
+          L(a, j).setZero();
+        else
+          L(a, j) = D(a, j).array();
+      }
+    }
+    if(i > 0 && stages_[i - 1].nextSize > 0)
+    {
+      const auto & p = stages_[i - 1];
+      auto C = [&p](int a, int k) { return p.C.col(a + k * p.nextSize).array(); };
+      for(int j = 0; j < m; ++j)
+      {
+        for(int a = j; a < m; ++a)
+        {
+          for(int k = 0; k < p.size; ++k)
+            L(a, j) -= C(a, k) * C(j, k);
+        }
+      }
+    }
+
+    // Dense Cholesky factorization, column by column
+    for(int j = 0; j < m; ++j)
+    {
+      for(int k = 0; k < j; ++k)
+        L(j, j) -= L(j, k).square();
+      if((L(j, j) <= 0).any())
+      {
+        Eigen::Index b;
+        L(j, j).minCoeff(&b);
+        std::stringstream ss;
+        ss << "[BatchedBlockTriDiagonalCholesky::compute] Matrix " << b
+           << " of the batch is not positive definite (diagonal block starting at row " << s.offset << ").\n";
+        throw std::runtime_error(ss.str());
+      }
+      L(j, j) = L(j, j).sqrt();
+      for(int a = j + 1; a < m; ++a)
+      {
+        for(int k = 0; k < j; ++k)
+          L(a, j) -= L(a, k) * L(j, k);
+        L(a, j) /= L(j, j);
+      }
+    }
+
+    // C_i = B_i L_i^{-T}, row by row
+    if(s.nextSize > 0)
+    {
+      const auto B = A.block(i + 1, i);
+      auto C = [&s](int a, int j) { return s.C.col(a + j * s.nextSize).array(); };
+      for(int a = 0; a < s.nextSize; ++a)
+      {
+        for(int j = 0; j < m; ++j)
+        {
+          C(a, j) = B(a, j).array();
+          for(int k = 0; k < j; ++k)
+            C(a, j) -= C(a, k) * L(j, k);
+          C(a, j) /= L(j, j);
+        }
+      }
+    }
+  }
+}
+
+void BatchedBlockTriDiagonalCholesky::solveInPlace(MatrixRef B) const
+{
+  assert(B.rows() == batchSize_ && B.cols() == size_);
+  const int n = static_cast<int>(stages_.size());
+  auto x = [&B](int k) { return B.col(k).array(); };
+
+  // Forward substitution L Z = B
+  for(int i = 0; i < n; ++i)
+  {
+    const auto & s = stages_[i];
+    auto L = [&s](int a, int j) { return s.L.col(a + j * s.size).array(); };
+    if(i > 0 && stages_[i - 1].nextSize > 0)
+    {
+      const auto & p = stages_[i - 1];
+      for(int a = 0; a < s.size; ++a)
+      {
+        for(int k = 0; k < p.size; ++k)
+          x(s.offset + a) -= p.C.col(a + k * p.nextSize).array() * x(p.offset + k);
+      }
+    }
+    for(int j = 0; j < s.size; ++j)
+    {
+      x(s.offset + j) /= L(j, j);
+      for(int a = j + 1; a < s.size; ++a)
+        x(s.offset + a) -= L(a, j) * x(s.offset + j);
+    }
+  }
+
+  // Backward substitution L^T X = Z
+  for(int i = n - 1; i >= 0; --i)
+  {
+    const auto & s = stages_[i];
+    auto L = [&s](int a, int j) { return s.L.col(a + j * s.size).array(); };
+    if(s.nextSize > 0)
+    {
+      const int next = stages_[i + 1].offset;
+      for(int a = 0; a < s.size; ++a)
+      {
+        for(int k = 0; k < s.nextSize; ++k)
+          x(s.offset + a) -= s.C.col(k + a * s.nextSize).array() * x(next + k);
+      }
+    }
+    for(int j = s.size - 1; j >= 0; --j)
+    {
+      for(int a = j + 1; a < s.size; ++a)
+        x(s.offset + j) -= L(a, j) * x(s.offset + a);
+      x(s.offset + j) /= L(j, j);
+    }
+  }
+}
+
+} // namespace mls
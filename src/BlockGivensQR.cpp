@@ -0,0 +1,292 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BlockGivensQR.h>
+#include <mlsm/internal/StorageScheme.h>
+
+#include <algorithm>
+#include <sstream>
+
+namespace mls
+{
+using internal::SimpleType;
+
+void BlockGivensQR::compute(const BlockMatrix & A)
+{
+  analyzePattern(A);
+  factorize(A);
+}
+
+void BlockGivensQR::analyzePattern(const BlockMatrix & A)
+{
+  if(A.rows() < A.cols())
+    throw std::runtime_error("[BlockGivensQR::analyzePattern] Matrix must have at least as many rows as columns.");
+
+  rows_ = A.rows();
+  cols_ = A.cols();
+  rowsOfBlock_.resize(A.blkRows());
+  colsOfBlock_.resize(A.blkCols());
+  for(int r = 0; r < A.blkRows(); ++r)
+    rowsOfBlock_[r] = A.rowsOfBlock(r);
+  for(int c = 0; c < A.blkCols(); ++c)
+    colsOfBlock_[c] = A.colsOfBlock(c);
+
+  // Initial profile of each row: zero blocks are skipped, and the blocks that are multiple of the identity
+  // or diagonal only contribute their diagonal.
+  std::vector<int> lo(rows_, cols_);
+  std::vector<int> hi(rows_, 0);
+  blocks_.clear();
+  for(int r = 0; r < A.blkRows(); ++r)
+  {
+    for(const auto & e : A.storageScheme().row(r))
+    {
+      const auto B = A.blockView(r, e.i);
+      const SimpleType t = B.matrix ? internal::simpleType(*B.matrix) : SimpleType::Zero;
+      if(t == SimpleType::Zero)
+        continue;
+      blocks_.push_back({r, e.i, t});
+      const int ro = A.rowOffset(r);
+      const int co = A.colOffset(e.i);
+      for(int i = 0; i < rowsOfBlock_[r]; ++i)
+      {
+        if(t <= SimpleType::Diagonal)
+        {
+          if(i < colsOfBlock_[e.i])
+          {
+            lo[ro + i] = std::min(lo[ro + i], co + i);
+            hi[ro + i] = std::max(hi[ro + i], co + i + 1);
+          }
+        }
+        else
+        {
+          lo[ro + i] = std::min(lo[ro + i], co);
+          hi[ro + i] = std::max(hi[ro + i], co + colsOfBlock_[e.i]);
+        }
+      }
+    }
+  }
+
+  // Symbolic row merge: the row i is rotated with the row k of R, k being its first non-zero, until it
+  // becomes zero or reaches a column for which R has no row yet. Both rows share the union of their
+  // profiles from column k on.
+  origin_.assign(cols_, -1);
+  rEnd_.resize(cols_);
+  rotations_.clear();
+  rotationCol_.clear();
+  rotationEnd_.clear();
+  for(int i = 0; i < rows_; ++i)
+  {
+    for(int k = lo[i]; k < hi[i]; ++k)
+    {
+      if(origin_[k] < 0)
+      {
+        origin_[k] = i;
+        rEnd_[k] = hi[i];
+        break;
+      }
+      const int end = std::max(rEnd_[k], hi[i]);
+      rotations_.push_back({origin_[k], i, Givens(1, 0)});
+      rotationCol_.push_back(k);
+      rotationEnd_.push_back(end);
+      rEnd_[k] = end;
+      hi[origin_[k]] = std::max(hi[origin_[k]], end);
+      hi[i] = end;
+    }
+  }
+
+  perm_.resize(rows_);
+  int next = cols_;
+  for(int i = 0; i < rows_; ++i)
+    perm_.indices()[i] = -1;
+  for(int k = 0; k < cols_; ++k)
+  {
+    if(origin_[k] < 0)
+    {
+      std::stringstream ss;
+      ss << "[BlockGivensQR::analyzePattern] Matrix is structurally rank deficient (column " << k << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+    perm_.indices()[origin_[k]] = k;
+  }
+  for(int i = 0; i < rows_; ++i)
+  {
+    if(perm_.indices()[i] < 0)
+      perm_.indices()[i] = next++;
+  }
+
+  profile_.resize(rows_);
+  int offset = 0;
+  for(int i = 0; i < rows_; ++i)
+  {
+    profile_[i] = {lo[i], std::max(lo[i], hi[i]), offset};
+    offset += profile_[i].hi - profile_[i].lo;
+  }
+  data_.resize(offset);
+
+  int maxRows = 0;
+  int maxCols = 0;
+  for(const auto & b : blocks_)
+  {
+    if(b.type == SimpleType::Other)
+    {
+      maxRows = std::max(maxRows, rowsOfBlock_[b.r]);
+      maxCols = std::max(maxCols, colsOfBlock_[b.c]);
+    }
+  }
+  tmp_.resize(maxRows, maxCols);
+}
+
+void BlockGivensQR::factorize(const BlockMatrix & A)
+{
+  if(A.rows() != rows_ || A.cols() != cols_ || A.blkRows() != static_cast<int>(rowsOfBlock_.size())
+     || A.blkCols() != static_cast<int>(colsOfBlock_.size()))
+    throw std::runtime_error("[BlockGivensQR::factorize] Matrix does not have the analyzed pattern.");
+  // The copy below writes each block at the offsets of the analyzed profile.
+  for(int r = 0; r < A.blkRows(); ++r)
+  {
+    if(A.rowsOfBlock(r) != rowsOfBlock_[r])
+      throw std::runtime_error("[BlockGivensQR::factorize] Matrix does not have the analyzed pattern.");
+  }
+  for(int c = 0; c < A.blkCols(); ++c)
+  {
+    if(A.colsOfBlock(c) != colsOfBlock_[c])
+      throw std::runtime_error("[BlockGivensQR::factorize] Matrix does not have the analyzed pattern.");
+  }
+
+  // Copy of A in the profile
+  data_.setZero();
+  for(const auto & b : blocks_)
+  {
+    const auto B = A.blockView(b.r, b.c);
+    // The switch below casts the block according to its analyzed type.
+    if(!B.matrix || internal::simpleType(*B.matrix) != b.type)
+      throw std::runtime_error("[BlockGivensQR::factorize] Matrix does not have the analyzed pattern.");
+    const int ro = A.rowOffset(b.r);
+    const int co = A.colOffset(b.c);
+    const int m = rowsOfBlock_[b.r];
+    const int n = colsOfBlock_[b.c];
+    switch(b.type)
+    {
+      case SimpleType::MultipleOfIdentity:
+      {
+        const double f = internal::identityFactor(*B.matrix);
+        for(int i = 0; i < std::min(m, n); ++i)
+          *at(ro + i, co + i) = f;
+        break;
+      }
+      case SimpleType::Diagonal:
+      {
+        const auto d = internal::diagonalData(*B.matrix);
+        for(int i = 0; i < std::min(m, n); ++i)
+          *at(ro + i, co + i) = d[i];
+        break;
+      }
+      case SimpleType::Dense:
+      {
+        const auto D = internal::denseData(*B.matrix);
+        for(int i = 0; i < m; ++i)
+        {
+          for(int j = 0; j < n; ++j)
+            *at(ro + i, co + j) = B.trans ? D(j, i) : D(i, j);
+        }
+        break;
+      }
+      default:
+      {
+        auto D = tmp_.topLeftCorner(m, n);
+        B.matrix->toDense(D, B.trans);
+        for(int i = 0; i < m; ++i)
+        {
+          for(int j = 0; j < n; ++j)
+            *at(ro + i, co + j) = D(i, j);
+        }
+      }
+    }
+  }
+
+  // Numeric elimination, following the sequence of the symbolic phase
+  for(size_t k = 0; k < rotations_.size(); ++k)
+  {
+    auto & rot = rotations_[k];
+    const int col = rotationCol_[k];
+    double * x = at(rot.p, col);
+    double * y = at(rot.q, col);
+    if(*y == 0)
+    {
+      // Nothing to eliminate (e.g. structurally zero element of a diagonal block)
+      rot.G = Givens(1, 0);
+      continue;
+    }
+    rot.G.makeGivens(*x, *y);
+    const double c = rot.G.c();
+    const double s = rot.G.s();
+    for(int l = 0; l < rotationEnd_[k] - col; ++l)
+    {
+      const double xl = x[l];
+      x[l] = c * xl - s * y[l];
+      y[l] = s * xl + c * y[l];
+    }
+    *y = 0;
+  }
+
+  for(int j = 0; j < cols_; ++j)
+  {
+    if(*at(origin_[j], j) == 0)
+    {
+      std::stringstream ss;
+      ss << "[BlockGivensQR::factorize] Matrix does not have full column rank (column " << j << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+  }
+}
+
+void BlockGivensQR::applyQTransposeInPlace(MatrixRef B) const
+{
+  assert(B.rows() == rows_);
+  for(const auto & rot : rotations_)
+  {
+    if(rot.G.s() != 0)
+      B.applyOnTheLeft(rot.p, rot.q, rot.G.adjoint());
+  }
+  B = perm_ * B;
+}
+
+void BlockGivensQR::applyQInPlace(MatrixRef B) const
+{
+  assert(B.rows() == rows_);
+  B = perm_.transpose() * B;
+  for(auto it = rotations_.rbegin(); it != rotations_.rend(); ++it)
+  {
+    if(it->G.s() != 0)
+      B.applyOnTheLeft(it->p, it->q, it->G);
+  }
+}
+
+void BlockGivensQR::solveInPlace(MatrixRef B) const
+{
+  applyQTransposeInPlace(B);
+
+  // Back substitution R X = (Q^T B)_{0:n}, R being stored row by row
+  for(int j = cols_ - 1; j >= 0; --j)
+  {
+    const int n = rEnd_[j] - j - 1;
+    if(n > 0)
+    {
+      Eigen::Map<const Eigen::RowVectorXd> r(at(origin_[j], j + 1), n);
+      B.row(j).noalias() -= r * B.middleRows(j + 1, n);
+    }
+    B.row(j) /= *at(origin_[j], j);
+  }
+}
+
+Eigen::MatrixXd BlockGivensQR::matrixR() const
+{
+  Eigen::MatrixXd R = Eigen::MatrixXd::Zero(cols_, cols_);
+  for(int j = 0; j < cols_; ++j)
+  {
+    for(int k = j; k < rEnd_[j]; ++k)
+      R(j, k) = *at(origin_[j], k);
+  }
+  return R;
+}
+
+} // namespace mls
@@ -1,11 +1,17 @@
 /** Copyright 2021 CNRS-AIST JRL*/
 
 #include <mlsm/BlockMatrix.h>
+#include <mlsm/FixedMatrix.h>
 #include <mlsm/SimpleMatrix.h>
+#include <mlsm/internal/SimpleAccumulator.h>
+#include <mlsm/internal/SimpleType.h>
 #include <mlsm/internal/StorageScheme.h>
 
+#include <algorithm>
+#include <exception>
 #include <set>
 #include <sstream>
+#include <thread>
 
 namespace mls
 {
@@ -21,40 +27,55 @@ void BlockMatrix::setBlock(int r, int c, MatrixPtr M, bool transpose)
     setSize(r, c, M->rows(), M->cols());
   auto [i, tr] = storageScheme_->index(r, c);
   assert(!tr && "Stored matrices should not be transposed. There might be an error in the storage scheme.");
-  storage_[i] = {M, transpose};
+  store(i, {M, transpose});
 }
 
 void BlockMatrix::setRowsOfBlock(int r, int rows)
 {
+  if(frozen_)
+    throw std::runtime_error("[BlockMatrix::setRowsOfBlock] The structure of the matrix is frozen.");
   assert(r >= 0 && r < blkRows());
   assert(rows >= 0);
 
   rowsOfBlock_[r] = rows;
+  invalidateSize();
 }
 
 void BlockMatrix::setColsOfBlock(int c, int cols)
 {
+  if(frozen_)
+    throw std::runtime_error("[BlockMatrix::setColsOfBlock] The structure of the matrix is frozen.");
   assert(c >= 0 && c < blkCols());
   assert(cols >= 0);
 
   colsOfBlock_[c] = cols;
+  invalidateSize();
 }
 
 void BlockMatrix::resetRowsOfBlock(int r)
 {
+  if(frozen_)
+    throw std::runtime_error("[BlockMatrix::resetRowsOfBlock] The structure of the matrix is frozen.");
   assert(r >= 0 && r < blkRows());
   rowsOfBlock_[r] = undef;
+  invalidateSize();
 }
 
 void BlockMatrix::resetColsOfBlock(int c)
 {
+  if(frozen_)
+    throw std::runtime_error("[BlockMatrix::resetColsOfBlock] The structure of the matrix is frozen.");
   assert(c >= 0 && c < blkCols());
   colsOfBlock_[c] = undef;
+  invalidateSize();
 }
 
 void BlockMatrix::updateSize()
 {
-  // Ensure each block size has been updated
+  if(!sizeDirty_)
+    return;
+
+  // Ensure each block size has been updated. This is immediate for the blocks that did not change.
   for(auto & M : storage_)
   {
     if(M.matrix)
@@ -65,12 +86,14 @@ void BlockMatrix::updateSize()
     return std::minmax(lhs.first, lhs.second) < std::minmax(rhs.first, rhs.second);
   };
   std::set<std::pair<int, int>, decltype(comp)> toBeResized(comp);
-  for(int c = 0; c < blkRows(); ++c)
+  for(int c = 0; c < blkCols(); ++c)
   {
     for(const auto & e : storageScheme_->col(c))
     {
       const auto [r, idx, tr] = e;
       const auto & M = storage_[idx];
+      if(!M.matrix)
+        continue;
       int rm = tr ? M.cols() : M.rows();
       int cm = tr ? M.rows() : M.cols();
       if(rowsOfBlock_[r] == undef)
@@ -79,7 +102,7 @@ void BlockMatrix::updateSize()
       {
         if(rowsOfBlock_[r] != rm)
         {
-          if(M.matrix->isAutoResizable())
+          if(M.matrix->isAutoResizable() && !frozen_)
             toBeResized.insert({r, c});
           else
           {
@@ -91,12 +114,12 @@ void BlockMatrix::updateSize()
         }
       }
       if(colsOfBlock_[c] == undef)
-        rowsOfBlock_[c] = cm;
+        colsOfBlock_[c] = cm;
       else
       {
         if(colsOfBlock_[c] != cm)
         {
-          if(M.matrix->isAutoResizable())
+          if(M.matrix->isAutoResizable() && !frozen_)
             toBeResized.insert({r, c});
           else
           {
@@ -120,8 +143,10 @@ void BlockMatrix::updateSize()
       ss << "[BlockMatrix::updateSize] Size of row " << r << " was not specified.\n";
       throw std::runtime_error(ss.str());
     }
+    rowOffsets_[r] = rows_;
     rows_ += rows;
   }
+  rowOffsets_.back() = rows_;
 
   cols_ = 0;
   for(int c = 0; c < blkCols(); ++c)
@@ -133,8 +158,10 @@ void BlockMatrix::updateSize()
       ss << "[BlockMatrix::updateSize] Size of column " << c << " was not specified.\n";
       throw std::runtime_error(ss.str());
     }
+    colOffsets_[c] = cols_;
     cols_ += cols;
   }
+  colOffsets_.back() = cols_;
 
   // Resizing auto-resizable matrices
   for(const auto & p : toBeResized)
@@ -145,6 +172,25 @@ void BlockMatrix::updateSize()
     else
       storage_[idx].matrix->autoResize(rowsOfBlock_[p.first], colsOfBlock_[p.second]);
   }
+
+  updateZeroBlocks();
+  sizeDirty_ = false;
+}
+
+void BlockMatrix::invalidateSize()
+{
+  // A matrix whose sizes are out of date has all its parents in the same state.
+  if(sizeDirty_)
+    return;
+  sizeDirty_ = true;
+  invalidateParents();
+}
+
+void BlockMatrix::freezeStructure(bool freeze)
+{
+  if(freeze && !frozen_)
+    updateSize();
+  frozen_ = freeze;
 }
 
 BlockMatrix::BlockMatrix(internal::ShapePtr shape, std::unique_ptr<internal::StorageScheme> scheme)
@@ -154,6 +200,27 @@ BlockMatrix::BlockMatrix(internal::ShapePtr shape, std::unique_ptr<internal::Sto
   storage_.resize(storageScheme_->size());
   rowsOfBlock_.resize(shape_->rows(), -1);
   colsOfBlock_.resize(shape_->cols(), -1);
+  rowOffsets_.resize(shape_->rows() + 1, 0);
+  colOffsets_.resize(shape_->cols() + 1, 0);
+}
+
+BlockMatrix::~BlockMatrix()
+{
+  for(auto & M : storage_)
+  {
+    if(M.matrix)
+      M.matrix->parents_.erase(std::find(M.matrix->parents_.begin(), M.matrix->parents_.end(), this));
+  }
+}
+
+void BlockMatrix::store(int idx, nonConstTransposableMatrix M)
+{
+  if(auto & P = storage_[idx].matrix)
+    P->parents_.erase(std::find(P->parents_.begin(), P->parents_.end(), this));
+  if(M.matrix)
+    M.matrix->parents_.push_back(this);
+  storage_[idx] = std::move(M);
+  invalidateSize();
 }
 
 void BlockMatrix::setSize(int r, int c, int rows, int cols)
@@ -180,32 +247,42 @@ void BlockMatrix::setSize(int r, int c, int rows, int cols)
 double BlockMatrix::v_coeffRef(int r, int c) const
 {
   assert(r >= 0 && r < rows() && c >= 0 && c < cols());
-  auto findIndex = [](int i, const std::vector<int> & sizes) {
-    for(size_t k = 0; k < sizes.size(); ++k)
-    {
-      if(i < sizes[k])
-        return std::make_pair(static_cast<int>(k), i);
-      else
-        i -= sizes[k];
-    }
-    assert(false);
-    return std::make_pair(-1, -1);
+  // Index of the block containing i, found by binary search in the offsets. Empty blocks are
+  // skipped since we look for the last offset lower or equal to i.
+  auto findBlock = [](int i, const std::vector<int> & offsets) {
+    return static_cast<int>(std::upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin()) - 1;
   };
-  auto [rBlk, rInBlk] = findIndex(r, rowsOfBlock_);
-  auto [cBlk, cInBlk] = findIndex(c, colsOfBlock_);
+  const int rBlk = findBlock(r, rowOffsets_);
+  const int cBlk = findBlock(c, colOffsets_);
+  const int rInBlk = r - rowOffsets_[rBlk];
+  const int cInBlk = c - colOffsets_[cBlk];
 
   auto [idx, tr] = storageScheme_->index(rBlk, cBlk);
-  if(idx == -1)
+  if(idx == -1 || !storage_[idx].matrix)
     return 0.;
+  const auto & M = storage_[idx];
+  if(M.trans != tr)
+    return (*M.matrix)(cInBlk, rInBlk);
   else
-    return storage_[idx].transposed(tr)(rInBlk, cInBlk);
+    return (*M.matrix)(rInBlk, cInBlk);
+}
+
+BlockView BlockMatrix::blockView(int r, int c) const
+{
+  assert(shape_->checkIndices(r, c));
+  auto [i, tr] = storageScheme_->index(r, c);
+  const int rows = rowOffsets_[r + 1] - rowOffsets_[r];
+  const int cols = colOffsets_[c + 1] - colOffsets_[c];
+  if(i == -1 || !storage_[i].matrix)
+    return {nullptr, false, rowOffsets_[r], colOffsets_[c], rows, cols};
+  return {storage_[i].matrix.get(), storage_[i].trans != tr, rowOffsets_[r], colOffsets_[c], rows, cols};
 }
 
 constTransposableMatrix BlockMatrix::v_block(int r, int c) const
 {
   auto [i, tr] = storageScheme_->index(r, c);
   if(i == -1)
-    return {std::make_shared<ZeroMatrix>(rowsOfBlock_[r], colsOfBlock_[c]), false};
+    return {zeroBlock(r, c), false};
   if(tr)
     return static_cast<constTransposableMatrix>(storage_[i].transposed());
   else
@@ -216,26 +293,710 @@ nonConstTransposableMatrix BlockMatrix::v_block(int r, int c)
 {
   auto [i, tr] = storageScheme_->index(r, c);
   if(i == -1)
-    return {std::make_shared<ZeroMatrix>(rowsOfBlock_[r], colsOfBlock_[c]), false};
+    return {zeroBlock(r, c), false};
   if(tr)
     return storage_[i].transposed();
   else
     return storage_[i];
 }
 
-void BlockMatrix::toDense(MatrixRef D, bool transpose) const
+namespace
 {
-  int rows = 0;
-  for(int r = 0; r < blkRows(); ++r)
+/** Zero matrix shared by all the non-stored blocks of a given size. Resizing it would affect all these
+ * blocks, so it is not auto-resizable.*/
+class SharedZeroMatrix : public ZeroMatrix
+{
+public:
+  using ZeroMatrix::ZeroMatrix;
+  bool isAutoResizable() const override { return false; }
+};
+} // namespace
+
+MatrixPtr BlockMatrix::zeroBlock(int r, int c) const
+{
+  const int rc = rowSizeClass_.empty() ? -1 : rowSizeClass_[r];
+  const int cc = colSizeClass_.empty() ? -1 : colSizeClass_[c];
+  if(rc < 0 || cc < 0 || rowSizes_[rc] != rowsOfBlock_[r] || colSizes_[cc] != colsOfBlock_[c])
+    return std::make_shared<ZeroMatrix>(rowsOfBlock_[r], colsOfBlock_[c]);
+  return zeroBlocks_[rc * colSizes_.size() + cc];
+}
+
+void BlockMatrix::updateZeroBlocks()
+{
+  auto upToDate = [](const std::vector<int> & sizes, const std::vector<int> & classes, const std::vector<int> & blk) {
+    if(classes.size() != blk.size())
+      return false;
+    for(size_t i = 0; i < blk.size(); ++i)
+    {
+      if(classes[i] < 0 || sizes[classes[i]] != blk[i])
+        return false;
+    }
+    return true;
+  };
+  if(upToDate(rowSizes_, rowSizeClass_, rowsOfBlock_) && upToDate(colSizes_, colSizeClass_, colsOfBlock_))
+    return;
+
+  auto classify = [](const std::vector<int> & blk, std::vector<int> & sizes, std::vector<int> & classes) {
+    sizes.clear();
+    classes.resize(blk.size());
+    for(size_t i = 0; i < blk.size(); ++i)
+    {
+      auto it = std::find(sizes.begin(), sizes.end(), blk[i]);
+      classes[i] = static_cast<int>(it - sizes.begin());
+      if(it == sizes.end())
+        sizes.push_back(blk[i]);
+    }
+  };
+  classify(rowsOfBlock_, rowSizes_, rowSizeClass_);
+  classify(colsOfBlock_, colSizes_, colSizeClass_);
+
+  // With many different block sizes, a zero matrix for each pair of sizes would be too many: non-stored
+  // blocks are then created on the fly.
+  if(rowSizes_.size() * colSizes_.size() > static_cast<size_t>(blkRows() + blkCols()))
+  {
+    rowSizeClass_.clear();
+    colSizeClass_.clear();
+    return;
+  }
+
+  // Zero matrices of sizes that are no longer used are kept, so that going back to previous sizes does
+  // not allocate.
+  zeroBlocks_.clear();
+  for(int rs : rowSizes_)
+  {
+    for(int cs : colSizes_)
+    {
+      auto it = std::find_if(zeroPool_.begin(), zeroPool_.end(),
+                             [&](const MatrixPtr & Z) { return Z->rows() == rs && Z->cols() == cs; });
+      if(it == zeroPool_.end())
+      {
+        zeroPool_.push_back(std::make_shared<SharedZeroMatrix>(rs, cs));
+        it = zeroPool_.end() - 1;
+      }
+      zeroBlocks_.push_back(*it);
+    }
+  }
+}
+
+void BlockMatrix::toDense(MatrixRef D, bool transpose) const { toDenseRows(D, transpose, 0, blkRows()); }
+
+void BlockMatrix::toDenseParallel(MatrixRef D, bool transpose, int threads) const
+{
+  if(threads <= 0)
+    threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  threads = std::min(threads, blkRows());
+  if(threads <= 1)
+  {
+    toDense(D, transpose);
+    return;
+  }
+
+  // Rows of blocks are split in chunks with approximately the same number of rows.
+  std::vector<int> bounds(threads + 1, blkRows());
+  bounds[0] = 0;
+  for(int k = 1; k < threads; ++k)
+  {
+    const int target = static_cast<int>(static_cast<long>(rows_) * k / threads);
+    bounds[k] = static_cast<int>(std::lower_bound(rowOffsets_.begin(), rowOffsets_.end() - 1, target) - rowOffsets_.begin());
+  }
+
+  // Exceptions are caught in each thread and rethrown once all the threads are joined.
+  std::vector<std::exception_ptr> errors(threads);
+  auto work = [this, &D, transpose, &bounds, &errors](int k) {
+    try
+    {
+      toDenseRows(D, transpose, bounds[k], bounds[k + 1]);
+    }
+    catch(...)
+    {
+      errors[k] = std::current_exception();
+    }
+  };
+
+  {
+    // Joins the threads on every exit of the scope, including if a thread fails to start.
+    struct Pool
+    {
+      std::vector<std::thread> threads;
+      ~Pool()
+      {
+        for(auto & t : threads)
+        {
+          if(t.joinable())
+            t.join();
+        }
+      }
+    } pool;
+    pool.threads.reserve(threads - 1);
+    for(int k = 1; k < threads; ++k)
+      pool.threads.emplace_back(work, k);
+    work(0);
+  }
+
+  for(const auto & e : errors)
+  {
+    if(e)
+      std::rethrow_exception(e);
+  }
+}
+
+void BlockMatrix::toDenseRows(MatrixRef D, bool transpose, int r0, int r1) const
+{
+  assert(D.rows() == (transpose ? cols() : rows()) && D.cols() == (transpose ? rows() : cols()));
+  // D_rc is the part of D corresponding to the elements (i,j) with i in row of blocks r and j in
+  // the columns of blocks c0 to c1-1.
+  auto Drc = [&](int r, int c0, int c1) {
+    const int nr = rowsOfBlock_[r];
+    const int nc = colOffsets_[c1] - colOffsets_[c0];
+    if(transpose)
+      return D.block(colOffsets_[c0], rowOffsets_[r], nc, nr);
+    else
+      return D.block(rowOffsets_[r], colOffsets_[c0], nr, nc);
+  };
+
+  for(int r = r0; r < r1; ++r)
+  {
+    // Stored blocks are written, and the gaps between them are zeroed.
+    int c = 0;
+    for(const auto & e : storageScheme_->row(r))
+    {
+      const auto & M = storage_[e.idx];
+      if(!M.matrix)
+        continue;
+      Drc(r, c, e.i).setZero();
+      M.matrix->toDense(Drc(r, e.i, e.i + 1), M.trans != (e.tr != transpose));
+      c = e.i + 1;
+    }
+    Drc(r, c, blkCols()).setZero();
+  }
+}
+
+void BlockMatrix::multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const
+{
+  assert(x.size() == (transpose ? rows() : cols()) && y.size() == (transpose ? cols() : rows()));
+  scale(y, beta);
+  if(alpha == 0)
+    return;
+
+  // For y = A x, we go through the rows of blocks of A, and for each of them, through the stored
+  // blocks of this row. For y = A^T x, we do the same with the columns of blocks of A.
+  const auto & outSizes = transpose ? colsOfBlock_ : rowsOfBlock_;
+  const auto & outOffsets = transpose ? colOffsets_ : rowOffsets_;
+  const auto & inSizes = transpose ? rowsOfBlock_ : colsOfBlock_;
+  const auto & inOffsets = transpose ? rowOffsets_ : colOffsets_;
+
+  for(int i = 0; i < static_cast<int>(outSizes.size()); ++i)
   {
-    int cols = 0;
-    for(int c = 0; c < blkCols(); ++c)
+    auto yi = y.segment(outOffsets[i], outSizes[i]);
+    auto process = [&](const internal::StorageScheme::LineIterValue & e) {
+      const auto & M = storage_[e.idx];
+      if(!M.matrix)
+        return;
+      // op(A)_{ij} = op(M.trans ? B^T : B) where B is the stored matrix, with a transposition if the
+      // storage scheme requires it.
+      M.matrix->multiply(x.segment(inOffsets[e.i], inSizes[e.i]), yi, alpha, 1, M.trans != (e.tr != transpose));
+    };
+    if(transpose)
+    {
+      for(const auto & e : storageScheme_->col(i))
+        process(e);
+    }
+    else
+    {
+      for(const auto & e : storageScheme_->row(i))
+        process(e);
+    }
+  }
+}
+
+namespace
+{
+/** Call f(M, k, tr, rowOffset) for each stored block of the line of blocks of op(A) that contains the
+ * column c of op(A), in increasing order of rows. The column c of op(A) is made, on the rows of this
+ * block, of the column k of op(M), where op(M) is M or M^T depending on tr, and rowOffset is the first
+ * row of the block in op(A).
+ */
+template<typename F>
+void forEachBlockInColumn(const BlockMatrix & A, int c, bool transpose, F && f)
+{
+  // Column of blocks j of op(A) such that c is in [offset(j), offset(j+1))
+  auto offset = [&](int j) { return transpose ? A.rowOffset(j) : A.colOffset(j); };
+  int lo = 0;
+  int hi = transpose ? A.blkRows() : A.blkCols();
+  while(hi - lo > 1)
+  {
+    const int mid = (lo + hi) / 2;
+    if(offset(mid) <= c)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  const int j = lo;
+  const int k = c - offset(j);
+
+  if(transpose)
+  {
+    for(const auto & e : A.storageScheme().row(j))
+    {
+      if(const BlockView V = A.blockView(j, e.i); !V.isZero())
+        f(*V.matrix, k, !V.trans, A.colOffset(e.i));
+    }
+  }
+  else
+  {
+    for(const auto & e : A.storageScheme().col(j))
+    {
+      if(const BlockView V = A.blockView(e.i, j); !V.isZero())
+        f(*V.matrix, k, V.trans, A.rowOffset(e.i));
+    }
+  }
+}
+} // namespace
+
+int BlockMatrix::sparseColNNZ(int c, bool transpose) const
+{
+  assert(c >= 0 && c < (transpose ? rows() : cols()));
+  int nnz = 0;
+  forEachBlockInColumn(*this, c, transpose,
+                       [&](const MatrixBase & M, int k, bool tr, int) { nnz += M.sparseColNNZ(k, tr); });
+  return nnz;
+}
+
+int BlockMatrix::sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const
+{
+  assert(c >= 0 && c < (transpose ? rows() : cols()));
+  int nnz = 0;
+  forEachBlockInColumn(*this, c, transpose, [&](const MatrixBase & M, int k, bool tr, int offset) {
+    nnz += M.sparseCol(k, tr, rowOffset + offset, inner ? inner + nnz : nullptr, values + nnz);
+  });
+  return nnz;
+}
+
+void BlockMatrix::allocateArena(const std::function<bool(int r, int c)> & isDiagonal)
+{
+  std::vector<ArenaBlock> blocks;
+  blocks.reserve(storage_.size());
+  for(int c = 0; c < blkCols(); ++c)
+  {
+    for(const auto & e : storageScheme_->col(c))
+    {
+      if(e.tr)
+        continue;
+      const int rows = rowsOfBlock_[e.i];
+      const int cols = colsOfBlock_[c];
+      if(rows == undef || cols == undef)
+      {
+        std::stringstream ss;
+        ss << "[BlockMatrix::allocateArena] Size of block (" << e.i << ", " << c << ") was not specified.\n";
+        throw std::runtime_error(ss.str());
+      }
+      const bool diagonal = isDiagonal && isDiagonal(e.i, c);
+      if(diagonal && rows != cols)
+      {
+        std::stringstream ss;
+        ss << "[BlockMatrix::allocateArena] Block (" << e.i << ", " << c << ") cannot be diagonal as it is not square.\n";
+        throw std::runtime_error(ss.str());
+      }
+      blocks.push_back({e.idx, rows, cols, diagonal, false, nullptr});
+    }
+  }
+  buildArena(blocks);
+  updateSize();
+}
+
+void BlockMatrix::compactToArena()
+{
+  std::vector<ArenaBlock> blocks;
+  for(int idx = 0; idx < static_cast<int>(storage_.size()); ++idx)
+  {
+    const auto & M = storage_[idx];
+    if(!M.matrix)
+      continue;
+    if(dynamic_cast<const FixedDenseMatrixBase *>(M.matrix.get()))
+      continue;
+    const internal::SimpleType t = internal::simpleType(*M.matrix);
+    if(t == internal::SimpleType::Diagonal || t == internal::SimpleType::Dense)
+      blocks.push_back({idx, M.matrix->rows(), M.matrix->cols(), t == internal::SimpleType::Diagonal, M.trans, M.matrix});
+  }
+  buildArena(blocks);
+}
+
+void BlockMatrix::buildArena(const std::vector<ArenaBlock> & blocks)
+{
+  // Each block starts on an address aligned for vectorization.
+  constexpr int align = std::max(1, EIGEN_MAX_ALIGN_BYTES / static_cast<int>(sizeof(double)));
+  auto padded = [](int n) { return (n + align - 1) / align * align; };
+
+  // Blocks are placed in the order of the storage
+  std::vector<const ArenaBlock *> sorted(blocks.size());
+  std::transform(blocks.begin(), blocks.end(), sorted.begin(), [](const auto & b) { return &b; });
+  std::sort(sorted.begin(), sorted.end(), [](const auto * a, const auto * b) { return a->idx < b->idx; });
+
+  Eigen::Index n = 0;
+  for(const auto * b : sorted)
+    n += padded(b->diagonal ? b->rows : b->rows * b->cols);
+
+  // The previous arena, if any, is kept alive until the new one is filled, as blocks to be copied
+  // might refer to it.
+  Eigen::VectorXd arena = Eigen::VectorXd::Zero(n);
+  double * data = arena.data();
+  for(const auto * b : sorted)
+  {
+    if(b->diagonal)
+    {
+      Eigen::Map<Eigen::VectorXd> d(data, b->rows);
+      if(b->source)
+        d = internal::diagonalData(*b->source);
+      store(b->idx, {std::make_shared<DiagonalMatrix>(d, NonConstRef_t{}), b->trans});
+      data += padded(b->rows);
+    }
+    else
+    {
+      Eigen::Map<Eigen::MatrixXd> M(data, b->rows, b->cols);
+      if(b->source)
+        M = internal::denseData(*b->source);
+      store(b->idx, {std::make_shared<DenseMatrix>(M, NonConstRef_t{}), b->trans});
+      data += padded(b->rows * b->cols);
+    }
+  }
+  arena_.swap(arena);
+}
+
+namespace
+{
+/** Block matrix with the given shape and a band, dense or sparse storage accordingly. Return nullptr
+ * for unsupported shape types.
+ */
+std::shared_ptr<BlockMatrix> makeBlockMatrix(const internal::ShapeBase & shape)
+{
+  switch(shape.type())
+  {
+    case internal::ShapeType::Empty:
+      return std::make_shared<SparseBlockMatrix>(shape.rows(), shape.cols(), std::vector<std::pair<int, int>>{});
+    case internal::ShapeType::Band:
+    {
+      const auto & b = static_cast<const internal::BandShape &>(shape);
+      return std::make_shared<BandBlockMatrix>(b.rows(), b.cols(), b.lowerBandwidth(), b.upperBandwidth());
+    }
+    case internal::ShapeType::Dense:
+      return std::make_shared<DenseBlockMatrix>(shape.rows(), shape.cols());
+    case internal::ShapeType::Sparse:
+      return std::make_shared<SparseBlockMatrix>(static_cast<const internal::SparseShape &>(shape));
+    default:
+      return nullptr;
+  }
+}
+
+/** Iterate on the set blocks of the i-th line of op(M), calling f(j, op(M)_ij) for each of them.*/
+template<typename F>
+void forEachInLine(const BlockMatrix & M, int i, bool transpose, F && f)
+{
+  if(transpose)
+  {
+    for(const auto & e : M.storageScheme().col(i))
+    {
+      if(auto B = M.block(e.i, i); B.matrix)
+        f(e.i, B.transposed());
+    }
+  }
+  else
+  {
+    for(const auto & e : M.storageScheme().row(i))
+    {
+      if(auto B = M.block(i, e.i); B.matrix)
+        f(e.i, B);
+    }
+  }
+}
+} // namespace
+
+std::shared_ptr<BlockMatrix> mult(const BlockMatrix & lhs, const BlockMatrix & rhs, bool transposeLhs, bool transposeRhs)
+{
+  // Sizes of op(lhs) and op(rhs), in blocks and elements
+  const int blkRows = transposeLhs ? lhs.blkCols() : lhs.blkRows();
+  const int blkInner = transposeLhs ? lhs.blkRows() : lhs.blkCols();
+  const int blkCols = transposeRhs ? rhs.blkRows() : rhs.blkCols();
+  auto lhsRows = [&](int i) { return transposeLhs ? lhs.colsOfBlock(i) : lhs.rowsOfBlock(i); };
+  auto lhsCols = [&](int k) { return transposeLhs ? lhs.rowsOfBlock(k) : lhs.colsOfBlock(k); };
+  auto rhsRows = [&](int k) { return transposeRhs ? rhs.colsOfBlock(k) : rhs.rowsOfBlock(k); };
+  auto rhsCols = [&](int j) { return transposeRhs ? rhs.rowsOfBlock(j) : rhs.colsOfBlock(j); };
+
+  if(blkInner != (transposeRhs ? rhs.blkCols() : rhs.blkRows()))
+    throw std::runtime_error("[mult(BlockMatrix, BlockMatrix)] Incompatible number of blocks.");
+  for(int k = 0; k < blkInner; ++k)
+  {
+    if(lhsCols(k) != rhsRows(k))
+    {
+      std::stringstream ss;
+      ss << "[mult(BlockMatrix, BlockMatrix)] Incompatible block sizes for inner index " << k << " (" << lhsCols(k)
+         << " vs " << rhsRows(k) << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+  }
+
+  // Allocate the result with the product shape
+  internal::ShapePtr ls = transposeLhs ? lhs.shape().transposed() : lhs.shape().copy();
+  internal::ShapePtr rs = transposeRhs ? rhs.shape().transposed() : rhs.shape().copy();
+  std::shared_ptr<BlockMatrix> res = makeBlockMatrix(*internal::mult(*ls, *rs));
+  if(!res)
+    throw std::runtime_error("[mult(BlockMatrix, BlockMatrix)] Unsupported shape for the product.");
+  for(int i = 0; i < blkRows; ++i)
+    res->setRowsOfBlock(i, lhsRows(i));
+  for(int j = 0; j < blkCols; ++j)
+    res->setColsOfBlock(j, rhsCols(j));
+
+  std::vector<internal::SimpleAccumulator> acc;
+  std::vector<int> accIdx(blkCols, -1); // accIdx[j] is the index in acc of block (i,j) of the result
+  for(int i = 0; i < blkRows; ++i)
+  {
+    acc.clear();
+    for(const auto & e : res->storageScheme().row(i))
+    {
+      accIdx[e.i] = static_cast<int>(acc.size());
+      acc.emplace_back(lhsRows(i), rhsCols(e.i));
+    }
+
+    // res_ij = sum_k op(lhs)_ik op(rhs)_kj where both op(lhs)_ik and op(rhs)_kj are stored
+    forEachInLine(lhs, i, transposeLhs, [&](int k, const constTransposableMatrix & A) {
+      forEachInLine(rhs, k, transposeRhs, [&](int j, const constTransposableMatrix & B) {
+        assert(accIdx[j] >= 0 && "The product shape should include all non-zero blocks");
+        acc[accIdx[j]].addProduct(A, B);
+      });
+    });
+
+    for(const auto & e : res->storageScheme().row(i))
+    {
+      res->setBlock(i, e.i, acc[accIdx[e.i]].toMatrix());
+      accIdx[e.i] = -1;
+    }
+  }
+  res->updateSize();
+  return res;
+}
+
+std::shared_ptr<BlockMatrix> add(const BlockMatrix & lhs,
+                                 const BlockMatrix & rhs,
+                                 double alpha,
+                                 double beta,
+                                 bool transposeLhs,
+                                 bool transposeRhs)
+{
+  // Sizes of op(lhs) and op(rhs), in blocks and elements
+  const int blkRows = transposeLhs ? lhs.blkCols() : lhs.blkRows();
+  const int blkCols = transposeLhs ? lhs.blkRows() : lhs.blkCols();
+  auto lhsRows = [&](int i) { return transposeLhs ? lhs.colsOfBlock(i) : lhs.rowsOfBlock(i); };
+  auto lhsCols = [&](int j) { return transposeLhs ? lhs.rowsOfBlock(j) : lhs.colsOfBlock(j); };
+  auto rhsRows = [&](int i) { return transposeRhs ? rhs.colsOfBlock(i) : rhs.rowsOfBlock(i); };
+  auto rhsCols = [&](int j) { return transposeRhs ? rhs.rowsOfBlock(j) : rhs.colsOfBlock(j); };
+
+  if(blkRows != (transposeRhs ? rhs.blkCols() : rhs.blkRows())
+     || blkCols != (transposeRhs ? rhs.blkRows() : rhs.blkCols()))
+    throw std::runtime_error("[add(BlockMatrix, BlockMatrix)] Incompatible number of blocks.");
+  for(int i = 0; i < blkRows; ++i)
+  {
+    if(lhsRows(i) != rhsRows(i))
+    {
+      std::stringstream ss;
+      ss << "[add(BlockMatrix, BlockMatrix)] Incompatible sizes for row of blocks " << i << " (" << lhsRows(i)
+         << " vs " << rhsRows(i) << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+  }
+  for(int j = 0; j < blkCols; ++j)
+  {
+    if(lhsCols(j) != rhsCols(j))
+    {
+      std::stringstream ss;
+      ss << "[add(BlockMatrix, BlockMatrix)] Incompatible sizes for column of blocks " << j << " (" << lhsCols(j)
+         << " vs " << rhsCols(j) << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+  }
+
+  // Allocate the result with the sum shape
+  internal::ShapePtr ls = transposeLhs ? lhs.shape().transposed() : lhs.shape().copy();
+  internal::ShapePtr rs = transposeRhs ? rhs.shape().transposed() : rhs.shape().copy();
+  std::shared_ptr<BlockMatrix> res = makeBlockMatrix(*internal::add(*ls, *rs));
+  if(!res)
+    throw std::runtime_error("[add(BlockMatrix, BlockMatrix)] Unsupported shape for the sum.");
+  for(int i = 0; i < blkRows; ++i)
+    res->setRowsOfBlock(i, lhsRows(i));
+  for(int j = 0; j < blkCols; ++j)
+    res->setColsOfBlock(j, lhsCols(j));
+
+  std::vector<internal::SimpleAccumulator> acc;
+  std::vector<int> accIdx(blkCols, -1); // accIdx[j] is the index in acc of block (i,j) of the result
+  for(int i = 0; i < blkRows; ++i)
+  {
+    acc.clear();
+    for(const auto & e : res->storageScheme().row(i))
+    {
+      accIdx[e.i] = static_cast<int>(acc.size());
+      acc.emplace_back(lhsRows(i), lhsCols(e.i));
+    }
+
+    forEachInLine(lhs, i, transposeLhs, [&](int j, const constTransposableMatrix & A) { acc[accIdx[j]].add(A, alpha); });
+    forEachInLine(rhs, i, transposeRhs, [&](int j, const constTransposableMatrix & B) { acc[accIdx[j]].add(B, beta); });
+
+    for(const auto & e : res->storageScheme().row(i))
+    {
+      res->setBlock(i, e.i, acc[accIdx[e.i]].toMatrix());
+      accIdx[e.i] = -1;
+    }
+  }
+  res->updateSize();
+  return res;
+}
+
+namespace
+{
+[[noreturn]] void throwSingular(int j)
+{
+  std::stringstream ss;
+  ss << "[solveTriangularInPlace] Zero diagonal element in the diagonal block " << j << ".\n";
+  throw std::runtime_error(ss.str());
+}
+
+/** B <- op(D)^{-1} B, where op(D) is D or D^T depending on \p trans, and is lower or upper triangular
+ * depending on \p lower. Only the corresponding part of D is read.
+ */
+void solveDense(MatrixConstRef D, bool trans, bool lower, MatrixRef B, int j)
+{
+  if((D.diagonal().array() == 0).any())
+    throwSingular(j);
+  if(trans)
+  {
+    if(lower)
+      D.transpose().triangularView<Eigen::Lower>().solveInPlace(B);
+    else
+      D.transpose().triangularView<Eigen::Upper>().solveInPlace(B);
+  }
+  else
+  {
+    if(lower)
+      D.triangularView<Eigen::Lower>().solveInPlace(B);
+    else
+      D.triangularView<Eigen::Upper>().solveInPlace(B);
+  }
+}
+
+/** B <- V^{-1} B, for the j-th diagonal block V of a lower or upper triangular matrix.*/
+void solveDiagonalBlock(const BlockView & V, MatrixRef B, bool lower, int j)
+{
+  const auto type = V.isZero() ? internal::SimpleType::Zero : internal::simpleType(*V.matrix);
+  switch(type)
+  {
+    case internal::SimpleType::Zero:
+      throwSingular(j);
+    case internal::SimpleType::MultipleOfIdentity:
+    {
+      const double f = internal::identityFactor(*V.matrix);
+      if(f == 0)
+        throwSingular(j);
+      B /= f;
+      break;
+    }
+    case internal::SimpleType::Diagonal:
+    {
+      const auto d = internal::diagonalData(*V.matrix);
+      if((d.array() == 0).any())
+        throwSingular(j);
+      B.array().colwise() /= d.array();
+      break;
+    }
+    case internal::SimpleType::Dense:
+      solveDense(internal::denseData(*V.matrix), V.trans, lower, B, j);
+      break;
+    default:
+    {
+      Eigen::MatrixXd D(V.rows(), V.cols());
+      V.toDense(D, false);
+      solveDense(D, false, lower, B, j);
+    }
+  }
+}
+
+/** B <- B - V X*/
+void subtractProduct(const BlockView & V, MatrixConstRef X, MatrixRef B)
+{
+  if(V.isZero())
+    return;
+  switch(internal::simpleType(*V.matrix))
+  {
+    case internal::SimpleType::Zero:
+      break;
+    case internal::SimpleType::MultipleOfIdentity:
+      B -= internal::identityFactor(*V.matrix) * X;
+      break;
+    case internal::SimpleType::Diagonal:
+      B -= internal::diagonalData(*V.matrix).asDiagonal() * X;
+      break;
+    case internal::SimpleType::Dense:
+    {
+      const auto D = internal::denseData(*V.matrix);
+      if(V.trans)
+        B.noalias() -= D.transpose() * X;
+      else
+        B.noalias() -= D * X;
+      break;
+    }
+    default:
+      for(int k = 0; k < X.cols(); ++k)
+        V.multiply(X.col(k), B.col(k), -1, 1, false);
+  }
+}
+} // namespace
+
+void solveTriangularInPlace(const BlockMatrix & T, MatrixRef B, bool transpose)
+{
+  if(T.shape().type() != internal::ShapeType::Band)
+    throw std::runtime_error("[solveTriangularInPlace] Matrix must be a band block matrix.");
+  const auto & shape = static_cast<const internal::BandShape &>(T.shape());
+  const bool lowerT = shape.upperBandwidth() == 0;
+  if(T.blkRows() != T.blkCols() || (!lowerT && shape.lowerBandwidth() != 0))
+    throw std::runtime_error("[solveTriangularInPlace] Matrix must be square and block triangular.");
+  const int n = T.blkRows();
+  for(int j = 0; j < n; ++j)
+  {
+    if(T.rowsOfBlock(j) != T.colsOfBlock(j))
+    {
+      std::stringstream ss;
+      ss << "[solveTriangularInPlace] Diagonal block " << j << " is not square (" << T.rowsOfBlock(j) << "x"
+         << T.colsOfBlock(j) << ").\n";
+      throw std::runtime_error(ss.str());
+    }
+  }
+  if(B.rows() != T.rows())
+    throw std::runtime_error("[solveTriangularInPlace] Right-hand side does not have the correct number of rows.");
+
+  // op(T) is lower triangular for a lower triangular T, or the transpose of an upper triangular one. The
+  // columns of blocks of op(T) are then processed in increasing order (forward substitution), otherwise in
+  // decreasing order (backward substitution).
+  const bool lower = lowerT != transpose;
+  auto opBlock = [&](int i, int j) { return transpose ? T.blockView(j, i).transposed() : T.blockView(i, j); };
+  for(int k = 0; k < n; ++k)
+  {
+    const int j = lower ? k : n - 1 - k;
+    auto Xj = B.middleRows(T.rowOffset(j), T.rowsOfBlock(j));
+    solveDiagonalBlock(opBlock(j, j), Xj, lower, j);
+
+    // B_i <- B_i - op(T)_ij X_j for the stored blocks of the column j of op(T), i.e. of the column j of T,
+    // or of its row j if transposed.
+    auto eliminate = [&](int i) {
+      if(i != j)
+        subtractProduct(opBlock(i, j), Xj, B.middleRows(T.rowOffset(i), T.rowsOfBlock(i)));
+    };
+    if(transpose)
+    {
+      for(const auto & e : T.storageScheme().row(j))
+        eliminate(e.i);
+    }
+    else
     {
-      block(r,c).toDense(D.block(rows, cols, rowsOfBlock_[r], colsOfBlock_[c]), transpose);
-      cols += colsOfBlock_[c];
+      for(const auto & e : T.storageScheme().col(j))
+        eliminate(e.i);
     }
-    rows += rowsOfBlock_[r];
   }
 }
 
-} // namespace mls
\ No newline at end of file
+} // namespace mls
@@ -0,0 +1,351 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BlockTriDiagonalCholesky.h>
+
+#include <Eigen/Cholesky>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <type_traits>
+
+namespace mls
+{
+using internal::SimpleType;
+
+namespace
+{
+/** Type of the block (r,c) of A, unset blocks being zero.*/
+SimpleType blockType(const BlockMatrix & A, int r, int c)
+{
+  const auto B = A.blockView(r, c);
+  return B.matrix ? internal::simpleType(*B.matrix) : SimpleType::Zero;
+}
+} // namespace
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::compute(const BlockMatrix & A)
+{
+  analyzePattern(A);
+  factorize(A);
+}
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::analyzePattern(const BlockMatrix & A)
+{
+  if(A.shape().type() != internal::ShapeType::Band || A.blkRows() != A.blkCols())
+    throw std::runtime_error("[BlockTriDiagonalCholesky::analyzePattern] Matrix must be square block tridiagonal.");
+  const auto & shape = static_cast<const internal::BandShape &>(A.shape());
+  if(shape.lowerBandwidth() > 1 || shape.upperBandwidth() > 1)
+    throw std::runtime_error("[BlockTriDiagonalCholesky::analyzePattern] Matrix must be square block tridiagonal.");
+
+  const int n = A.blkRows();
+  stages_.resize(n);
+  size_ = A.rows();
+  // Largest blocks without dedicated kernel, converted through tmp_ in single precision
+  int maxRows = 0;
+  int maxCols = 0;
+  for(int i = 0; i < n; ++i)
+  {
+    if(A.rowsOfBlock(i) != A.colsOfBlock(i))
+      throw std::runtime_error("[BlockTriDiagonalCholesky::analyzePattern] Diagonal blocks must be square.");
+    auto & s = stages_[i];
+    s.size = A.rowsOfBlock(i);
+    s.offset = A.rowOffset(i);
+    s.DType = blockType(A, i, i);
+    s.BType = i < n - 1 ? blockType(A, i + 1, i) : SimpleType::Zero;
+
+    // The Schur complement D_i - C_{i-1} C_{i-1}^T stays a multiple of the identity (resp. diagonal)
+    // if D_i and C_{i-1} are, and so does C_i = B_i L_i^{-T} if B_i and L_i are.
+    const SimpleType tC = i > 0 ? stages_[i - 1].CType : SimpleType::Zero;
+    s.LType = std::max({s.DType, tC, SimpleType::MultipleOfIdentity});
+    if(s.LType > SimpleType::Diagonal)
+      s.LType = SimpleType::Dense;
+    if(s.BType == SimpleType::Zero)
+      s.CType = SimpleType::Zero;
+    else if(s.LType <= SimpleType::Diagonal)
+      s.CType = std::min(std::max(s.BType, s.LType), SimpleType::Dense);
+    else
+      s.CType = SimpleType::Dense;
+
+    if(s.DType == SimpleType::Other && s.LType == SimpleType::Dense)
+    {
+      maxRows = std::max(maxRows, s.size);
+      maxCols = std::max(maxCols, s.size);
+    }
+    if(s.BType == SimpleType::Other && s.CType == SimpleType::Dense)
+    {
+      maxRows = std::max(maxRows, A.rowsOfBlock(i + 1));
+      maxCols = std::max(maxCols, s.size);
+    }
+
+    if(s.LType == SimpleType::Diagonal)
+      s.Ld.resize(s.size);
+    else if(s.LType == SimpleType::Dense)
+      s.L.resize(s.size, s.size);
+    if(s.CType == SimpleType::Diagonal)
+      s.Cd.resize(s.size);
+    else if(s.CType == SimpleType::Dense)
+      s.C.resize(A.rowsOfBlock(i + 1), s.size);
+  }
+  if constexpr(!std::is_same_v<Scalar, double>)
+    tmp_.resize(maxRows, maxCols);
+}
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::factorize(const BlockMatrix & A)
+{
+  const int n = static_cast<int>(stages_.size());
+  if(A.blkRows() != n || A.blkCols() != n || A.rows() != size_)
+    throw std::runtime_error("[BlockTriDiagonalCholesky::factorize] Matrix does not have the analyzed pattern.");
+
+  // The kernels below cast the blocks according to the analyzed types: a block of another type must
+  // be rejected before reaching them.
+  for(int i = 0; i < n; ++i)
+  {
+    const auto & s = stages_[i];
+    if(A.rowsOfBlock(i) != s.size || blockType(A, i, i) != s.DType
+       || (i < n - 1 && blockType(A, i + 1, i) != s.BType))
+      throw std::runtime_error("[BlockTriDiagonalCholesky::factorize] Matrix does not have the analyzed pattern.");
+  }
+
+  for(int i = 0; i < n; ++i)
+  {
+    factorizeDiagonal(A.blockView(i, i), i > 0 ? &stages_[i - 1] : nullptr, stages_[i]);
+    if(stages_[i].CType != SimpleType::Zero)
+      computeSubDiagonal(A.blockView(i + 1, i), stages_[i]);
+  }
+}
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::solveInPlace(MatrixRefT B) const
+{
+  assert(B.rows() == size_);
+  const int n = static_cast<int>(stages_.size());
+
+  // Forward substitution L Z = B
+  for(int i = 0; i < n; ++i)
+  {
+    const auto & s = stages_[i];
+    auto Bi = B.middleRows(s.offset, s.size);
+    if(i > 0)
+    {
+      const auto & p = stages_[i - 1];
+      auto Zp = B.middleRows(p.offset, p.size);
+      if(p.CType == SimpleType::MultipleOfIdentity)
+        Bi -= p.c * Zp;
+      else if(p.CType == SimpleType::Diagonal)
+        Bi -= p.Cd.asDiagonal() * Zp;
+      else if(p.CType == SimpleType::Dense)
+        Bi.noalias() -= p.C * Zp;
+    }
+    if(s.LType == SimpleType::MultipleOfIdentity)
+      Bi /= s.l;
+    else if(s.LType == SimpleType::Diagonal)
+      Bi = s.Ld.cwiseInverse().asDiagonal() * Bi;
+    else
+      s.L.template triangularView<Eigen::Lower>().solveInPlace(Bi);
+  }
+
+  // Backward substitution L^T X = Z
+  for(int i = n - 1; i >= 0; --i)
+  {
+    const auto & s = stages_[i];
+    auto Bi = B.middleRows(s.offset, s.size);
+    if(i < n - 1)
+    {
+      const auto & nx = stages_[i + 1];
+      auto Xn = B.middleRows(nx.offset, nx.size);
+      if(s.CType == SimpleType::MultipleOfIdentity)
+        Bi -= s.c * Xn;
+      else if(s.CType == SimpleType::Diagonal)
+        Bi -= s.Cd.asDiagonal() * Xn;
+      else if(s.CType == SimpleType::Dense)
+        Bi.noalias() -= s.C.transpose() * Xn;
+    }
+    if(s.LType == SimpleType::MultipleOfIdentity)
+      Bi /= s.l;
+    else if(s.LType == SimpleType::Diagonal)
+      Bi = s.Ld.cwiseInverse().asDiagonal() * Bi;
+    else
+      s.L.template triangularView<Eigen::Lower>().transpose().solveInPlace(Bi);
+  }
+}
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::factorizeDiagonal(const BlockView & D,
+                                                         const Stage * prev,
+                                                         Stage & s)
+{
+  const SimpleType tD = s.DType;
+  const SimpleType tC = prev ? prev->CType : SimpleType::Zero;
+  auto notPositiveDefinite = [&s]() {
+    std::stringstream ss;
+    ss << "[BlockTriDiagonalCholesky::factorize] Matrix is not positive definite (diagonal block starting at row "
+       << s.offset << ").\n";
+    return std::runtime_error(ss.str());
+  };
+
+  // Scalar factorization
+  if(s.LType == SimpleType::MultipleOfIdentity)
+  {
+    s.l = tD == SimpleType::Zero ? Scalar(0) : static_cast<Scalar>(internal::identityFactor(*D.matrix));
+    if(tC == SimpleType::MultipleOfIdentity)
+      s.l -= prev->c * prev->c;
+    if(s.l <= 0)
+      throw notPositiveDefinite();
+    s.l = std::sqrt(s.l);
+    return;
+  }
+
+  // Coefficient-wise factorization
+  if(s.LType == SimpleType::Diagonal)
+  {
+    if(tD == SimpleType::Zero)
+      s.Ld.setZero(s.size);
+    else if(tD == SimpleType::MultipleOfIdentity)
+      s.Ld.setConstant(s.size, static_cast<Scalar>(internal::identityFactor(*D.matrix)));
+    else
+      s.Ld = internal::diagonalData(*D.matrix).template cast<Scalar>();
+    if(tC == SimpleType::MultipleOfIdentity)
+      s.Ld.array() -= prev->c * prev->c;
+    else if(tC == SimpleType::Diagonal)
+      s.Ld -= prev->Cd.cwiseAbs2();
+    if((s.Ld.array() <= 0).any())
+      throw notPositiveDefinite();
+    s.Ld = s.Ld.cwiseSqrt();
+    return;
+  }
+
+  switch(tD)
+  {
+    case SimpleType::Zero:
+      s.L.setZero();
+      break;
+    case SimpleType::MultipleOfIdentity:
+      s.L.setZero();
+      s.L.diagonal().setConstant(static_cast<Scalar>(internal::identityFactor(*D.matrix)));
+      break;
+    case SimpleType::Diagonal:
+      s.L.setZero();
+      s.L.diagonal() = internal::diagonalData(*D.matrix).template cast<Scalar>();
+      break;
+    case SimpleType::Dense:
+      // D is symmetric, so that we don't need to care about its transposition
+      s.L = internal::denseData(*D.matrix).template cast<Scalar>();
+      break;
+    default:
+      toDense(D, s.L);
+  }
+  if(tC == SimpleType::MultipleOfIdentity)
+    s.L.diagonal().array() -= prev->c * prev->c;
+  else if(tC == SimpleType::Diagonal)
+    s.L.diagonal() -= prev->Cd.cwiseAbs2();
+  else if(tC == SimpleType::Dense)
+    s.L.template selfadjointView<Eigen::Lower>().rankUpdate(prev->C, -1);
+
+  Eigen::LLT<Eigen::Ref<Matrix>> llt(s.L);
+  if(llt.info() != Eigen::Success)
+    throw notPositiveDefinite();
+}
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::computeSubDiagonal(const BlockView & B, Stage & s)
+{
+  const SimpleType tB = s.BType;
+  assert(B.cols() == s.size);
+
+  // C = B L^{-T}
+  if(s.CType == SimpleType::MultipleOfIdentity)
+  {
+    s.c = static_cast<Scalar>(internal::identityFactor(*B.matrix)) / s.l;
+    return;
+  }
+
+  if(s.CType == SimpleType::Diagonal)
+  {
+    // One of B and L is diagonal, the other being diagonal or a multiple of the identity
+    if(tB == SimpleType::MultipleOfIdentity)
+      s.Cd = static_cast<Scalar>(internal::identityFactor(*B.matrix)) * s.Ld.cwiseInverse();
+    else if(s.LType == SimpleType::MultipleOfIdentity)
+      s.Cd = internal::diagonalData(*B.matrix).template cast<Scalar>() / s.l;
+    else
+      s.Cd = internal::diagonalData(*B.matrix).template cast<Scalar>().cwiseQuotient(s.Ld);
+    return;
+  }
+
+  switch(tB)
+  {
+    case SimpleType::MultipleOfIdentity:
+      s.C.setZero();
+      s.C.diagonal().setConstant(static_cast<Scalar>(internal::identityFactor(*B.matrix)));
+      break;
+    case SimpleType::Diagonal:
+      s.C.setZero();
+      s.C.diagonal() = internal::diagonalData(*B.matrix).template cast<Scalar>();
+      break;
+    case SimpleType::Dense:
+      if(B.trans)
+        s.C = internal::denseData(*B.matrix).transpose().template cast<Scalar>();
+      else
+        s.C = internal::denseData(*B.matrix).template cast<Scalar>();
+      break;
+    default:
+      toDense(B, s.C);
+  }
+
+  if(s.LType == SimpleType::MultipleOfIdentity)
+    s.C /= s.l;
+  else if(s.LType == SimpleType::Diagonal)
+    s.C = s.C * s.Ld.cwiseInverse().asDiagonal();
+  else
+    s.L.template triangularView<Eigen::Lower>().transpose().template solveInPlace<Eigen::OnTheRight>(s.C);
+}
+
+template<typename Scalar>
+void BlockTriDiagonalCholeskyT<Scalar>::toDense(const BlockView & M, Matrix & D)
+{
+  if constexpr(std::is_same_v<Scalar, double>)
+    M.matrix->toDense(D, M.trans);
+  else
+  {
+    auto T = tmp_.topLeftCorner(D.rows(), D.cols());
+    M.matrix->toDense(T, M.trans);
+    D = T.template cast<Scalar>();
+  }
+}
+
+template class BlockTriDiagonalCholeskyT<double>;
+template class BlockTriDiagonalCholeskyT<float>;
+
+int MixedPrecisionBlockTriDiagonalSolver::solveInPlace(const BlockMatrix & A,
+                                                       MatrixRef B,
+                                                       int maxIterations,
+                                                       double tolerance)
+{
+  assert(A.rows() == size() && A.cols() == size() && B.rows() == size());
+  const double threshold = tolerance * B.cwiseAbs().maxCoeff();
+
+  Rf_ = B.cast<float>();
+  llt_.solveInPlace(Rf_);
+  X_ = Rf_.cast<double>();
+  R_.resize(B.rows(), B.cols());
+
+  int k = 0;
+  for(; k < maxIterations; ++k)
+  {
+    // R = B - A X
+    R_ = B;
+    for(int j = 0; j < B.cols(); ++j)
+      A.multiply(X_.col(j), R_.col(j), -1, 1, false);
+    if(R_.cwiseAbs().maxCoeff() <= threshold)
+      break;
+    Rf_ = R_.cast<float>();
+    llt_.solveInPlace(Rf_);
+    X_ += Rf_.cast<double>();
+  }
+  B = X_;
+  return k;
+}
+
+} // namespace mls
@@ -23,4 +23,55 @@ TransposableMatrix<false> MatrixBase::block(int r, int c)
   return v_block(r, c);
 }
 
+void MatrixBase::toSparse(SparseMatrix & S, bool transpose, bool valuesOnly) const
+{
+  const int m = transpose ? cols() : rows();
+  const int n = transpose ? rows() : cols();
+  if(valuesOnly)
+  {
+    if(S.rows() != m || S.cols() != n || !S.isCompressed())
+      throw std::runtime_error("[MatrixBase::toSparse] The sparse matrix does not match the structure of the matrix.");
+    const int * outer = S.outerIndexPtr();
+    // The counts are checked before anything is written, as a column with more elements than its slot
+    // would overflow into the next one.
+    for(int c = 0; c < n; ++c)
+    {
+      if(sparseColNNZ(c, transpose) != outer[c + 1] - outer[c])
+        throw std::runtime_error("[MatrixBase::toSparse] The sparse matrix does not match the structure of the matrix.");
+    }
+    for(int c = 0; c < n; ++c)
+    {
+      [[maybe_unused]] const int nnz = sparseCol(c, transpose, 0, nullptr, S.valuePtr() + outer[c]);
+      assert(nnz == outer[c + 1] - outer[c]);
+    }
+    return;
+  }
+
+  S.resize(m, n);
+  int * outer = S.outerIndexPtr();
+  outer[0] = 0;
+  for(int c = 0; c < n; ++c)
+    outer[c + 1] = outer[c] + sparseColNNZ(c, transpose);
+  S.resizeNonZeros(outer[n]);
+  for(int c = 0; c < n; ++c)
+  {
+    [[maybe_unused]] const int nnz = sparseCol(c, transpose, 0, S.innerIndexPtr() + outer[c], S.valuePtr() + outer[c]);
+    assert(nnz == outer[c + 1] - outer[c]);
+  }
+}
+
+int MatrixBase::sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const
+{
+  Eigen::VectorXd e = Eigen::VectorXd::Unit(transpose ? rows() : cols(), c);
+  Eigen::VectorXd v(transpose ? cols() : rows());
+  multiply(e, v, 1, 0, transpose);
+  for(int i = 0; i < v.size(); ++i)
+  {
+    if(inner)
+      inner[i] = rowOffset + i;
+    values[i] = v[i];
+  }
+  return static_cast<int>(v.size());
+}
+
 } // namespace mls
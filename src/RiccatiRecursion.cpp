@@ -0,0 +1,197 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/RiccatiRecursion.h>
+#include <mlsm/internal/SimpleType.h>
+
+#include <sstream>
+
+namespace mls
+{
+namespace
+{
+/** Whether the block (r,c) of M is zero.*/
+bool isZeroBlock(const BlockMatrix & M, int r, int c)
+{
+  const BlockView V = M.blockView(r, c);
+  return V.isZero() || internal::simpleType(*V.matrix) == internal::SimpleType::Zero;
+}
+} // namespace
+
+void RiccatiRecursion::compute(const BlockMatrix & H, const BlockMatrix & G)
+{
+  analyzePattern(H, G);
+  factorize(H, G);
+}
+
+void RiccatiRecursion::analyzePattern(const BlockMatrix & H, const BlockMatrix & G)
+{
+  if(H.shape().type() != internal::ShapeType::Band || H.blkRows() != H.blkCols())
+    throw std::runtime_error("[RiccatiRecursion::analyzePattern] Hessian must be square block tridiagonal.");
+  const auto & hShape = static_cast<const internal::BandShape &>(H.shape());
+  if(hShape.lowerBandwidth() > 1 || hShape.upperBandwidth() > 1)
+    throw std::runtime_error("[RiccatiRecursion::analyzePattern] Hessian must be square block tridiagonal.");
+  if(G.shape().type() != internal::ShapeType::Band || G.blkRows() != H.blkRows() || G.blkCols() != H.blkCols())
+    throw std::runtime_error("[RiccatiRecursion::analyzePattern] Dynamics must be block lower bidiagonal, with "
+                             "the same number of blocks as the Hessian.");
+  const auto & gShape = static_cast<const internal::BandShape &>(G.shape());
+  if(gShape.lowerBandwidth() > 1 || gShape.upperBandwidth() > 0)
+    throw std::runtime_error("[RiccatiRecursion::analyzePattern] Dynamics must be block lower bidiagonal, with "
+                             "the same number of blocks as the Hessian.");
+
+  const int n = H.blkRows();
+  stages_.resize(n);
+  nz_ = H.rows();
+  nl_ = G.rows();
+  for(int k = 0; k < n; ++k)
+  {
+    const int nk = H.rowsOfBlock(k);
+    if(H.colsOfBlock(k) != nk || G.colsOfBlock(k) != nk || G.rowsOfBlock(k) > nk)
+    {
+      std::stringstream ss;
+      ss << "[RiccatiRecursion::analyzePattern] Incompatible sizes for stage " << k << ".\n";
+      throw std::runtime_error(ss.str());
+    }
+    if(k < n - 1 && (!isZeroBlock(H, k + 1, k) || !isZeroBlock(H, k, k + 1)))
+    {
+      std::stringstream ss;
+      ss << "[RiccatiRecursion::analyzePattern] Hessian couples the stages " << k << " and " << k + 1 << ".\n";
+      throw std::runtime_error(ss.str());
+    }
+
+    auto & s = stages_[k];
+    s.nx = G.rowsOfBlock(k);
+    s.nu = nk - s.nx;
+    s.zOffset = H.rowOffset(k);
+    s.lOffset = nz_ + G.rowOffset(k);
+    s.Ht.resize(nk, nk);
+    const int nxNext = k < n - 1 ? G.rowsOfBlock(k + 1) : 0;
+    s.AB.resize(nxNext, nk);
+    s.PAB.resize(nxNext, nk);
+    s.P.resize(s.nx, s.nx);
+    s.K.resize(s.nu, s.nx);
+    s.llt = Eigen::LLT<Eigen::MatrixXd>(s.nu);
+  }
+}
+
+void RiccatiRecursion::factorize(const BlockMatrix & H, const BlockMatrix & G)
+{
+  const int n = stages();
+  if(H.blkRows() != n || H.rows() != nz_ || G.rows() != nl_)
+    throw std::runtime_error("[RiccatiRecursion::factorize] Matrices do not have the analyzed size.");
+  // Same total sizes do not imply the same stage sizes, which the workspaces rely on
+  for(int k = 0; k < n; ++k)
+  {
+    const auto & s = stages_[k];
+    if(H.rowsOfBlock(k) != s.nx + s.nu || H.colsOfBlock(k) != s.nx + s.nu || G.rowsOfBlock(k) != s.nx
+       || G.colsOfBlock(k) != s.nx + s.nu)
+    {
+      std::stringstream ss;
+      ss << "[RiccatiRecursion::factorize] Stage " << k << " does not have the analyzed size.\n";
+      throw std::runtime_error(ss.str());
+    }
+  }
+
+  for(int k = n - 1; k >= 0; --k)
+  {
+    auto & s = stages_[k];
+    H.blockView(k, k).toDense(s.Ht, false);
+    if(k < n - 1)
+    {
+      // Ht = H_k + [A_k B_k]^T P_{k+1} [A_k B_k]
+      G.blockView(k + 1, k).toDense(s.AB, false);
+      s.PAB.noalias() = stages_[k + 1].P * s.AB;
+      s.Ht.noalias() += s.AB.transpose() * s.PAB;
+    }
+
+    // P_k = Q_k - M_k^T Re^{-1} M_k = Q_k + M_k^T K_k, with Re = R_k + B_k^T P_{k+1} B_k
+    const auto M = s.Ht.bottomLeftCorner(s.nu, s.nx);
+    s.P = s.Ht.topLeftCorner(s.nx, s.nx);
+    if(s.nu > 0)
+    {
+      s.llt.compute(s.Ht.bottomRightCorner(s.nu, s.nu));
+      if(s.llt.info() != Eigen::Success)
+      {
+        std::stringstream ss;
+        ss << "[RiccatiRecursion::factorize] Reduced Hessian of the controls is not positive definite at stage "
+           << k << ".\n";
+        throw std::runtime_error(ss.str());
+      }
+      s.K = -M;
+      s.llt.solveInPlace(s.K);
+      s.P.noalias() += M.transpose() * s.K;
+    }
+  }
+}
+
+void RiccatiRecursion::solveInPlace(MatrixRef B) const
+{
+  assert(B.rows() == size());
+  const int n = stages();
+  auto X = [&](const Stage & s) { return B.middleRows(s.zOffset, s.nx); };
+  auto U = [&](const Stage & s) { return B.middleRows(s.zOffset + s.nx, s.nu); };
+  auto L = [&](const Stage & s) { return B.middleRows(s.lOffset, s.nx); };
+
+  // Backward pass. Once the stage k is processed, the rows of x_k contain p_k and the rows of u_k contain
+  // k_k, while for the stage k+1, the rows of x_{k+1} and l_{k+1} contain r_l,k+1 and
+  // t_{k+1} = p_{k+1} - P_{k+1} r_l,k+1.
+  for(int k = n - 1; k >= 0; --k)
+  {
+    const auto & s = stages_[k];
+    auto Xk = X(s);
+    auto Uk = U(s);
+    if(k < n - 1)
+    {
+      const auto & nx = stages_[k + 1];
+      auto Xn = X(nx);
+      auto Ln = L(nx);
+      Xn.swap(Ln);
+      Ln.noalias() -= nx.P * Xn;
+      // k_k = Re^{-1} (r_u,k - B_k^T t_{k+1}), p_k = M_k^T k_k + A_k^T t_{k+1} - r_x,k
+      Uk.noalias() -= s.AB.rightCols(s.nu).transpose() * Ln;
+      if(s.nu > 0)
+        s.llt.solveInPlace(Uk);
+      Xk = -Xk;
+      Xk.noalias() += s.AB.leftCols(s.nx).transpose() * Ln;
+    }
+    else
+    {
+      if(s.nu > 0)
+        s.llt.solveInPlace(Uk);
+      Xk = -Xk;
+    }
+    Xk.noalias() += s.Ht.bottomLeftCorner(s.nu, s.nx).transpose() * Uk;
+  }
+
+  // Forward pass
+  {
+    // x_0 = -r_l,0 and l_0 = P_0 x_0 + p_0
+    const auto & s = stages_[0];
+    auto X0 = X(s);
+    auto L0 = L(s);
+    X0.swap(L0);
+    X0 = -X0;
+    L0.noalias() += s.P * X0;
+  }
+  for(int k = 0; k < n; ++k)
+  {
+    const auto & s = stages_[k];
+    auto Xk = X(s);
+    auto Uk = U(s);
+    // u_k = K_k x_k + k_k
+    Uk.noalias() += s.K * Xk;
+    if(k < n - 1)
+    {
+      // x_{k+1} = A_k x_k + B_k u_k - r_l,k+1 and l_{k+1} = P_{k+1} x_{k+1} + p_{k+1}, with
+      // p_{k+1} = t_{k+1} + P_{k+1} r_l,k+1, so that no workspace is needed.
+      const auto & nx = stages_[k + 1];
+      auto Xn = X(nx);
+      auto Ln = L(nx);
+      Ln.noalias() += nx.P * Xn;
+      Xn = -Xn;
+      Xn.noalias() += s.AB * B.middleRows(s.zOffset, s.nx + s.nu);
+      Ln.noalias() += nx.P * Xn;
+    }
+  }
+}
+
+} // namespace mls
@@ -0,0 +1,238 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/SchurComplement.h>
+#include <mlsm/internal/SimpleAccumulator.h>
+
+#include <algorithm>
+
+namespace mls
+{
+using internal::SimpleType;
+
+namespace
+{
+/** Block (r,c) of K, unset blocks being given as zero matrices.*/
+constTransposableMatrix getBlock(const BlockMatrix & K, int r, int c)
+{
+  if(K.blockView(r, c).isZero())
+    return {std::make_shared<ZeroMatrix>(K.rowsOfBlock(r), K.colsOfBlock(c))};
+  return K.block(r, c);
+}
+
+/** Whether \p M is a square block tridiagonal (or block diagonal) matrix.*/
+bool isBlockTriDiagonal(const BlockMatrix & M)
+{
+  if(M.shape().type() != internal::ShapeType::Band || M.blkRows() != M.blkCols())
+    return false;
+  const auto & shape = static_cast<const internal::BandShape &>(M.shape());
+  return shape.lowerBandwidth() <= 1 && shape.upperBandwidth() <= 1;
+}
+
+/** op(M) as a scalar band matrix, where op(M) is M or M^T depending on \p transpose. The bandwidths
+ * are the ones of the elements written by toSparse.*/
+BandMatrix toBand(const BlockMatrix & M, bool transpose)
+{
+  const SparseMatrix S = M.toSparse(transpose);
+  int l = 0;
+  int u = 0;
+  for(int c = 0; c < S.outerSize(); ++c)
+  {
+    for(SparseMatrix::InnerIterator it(S, c); it; ++it)
+    {
+      l = std::max(l, static_cast<int>(it.row()) - c);
+      u = std::max(u, c - static_cast<int>(it.row()));
+    }
+  }
+  BandMatrix T(static_cast<int>(S.rows()), static_cast<int>(S.cols()), l, u);
+  for(int c = 0; c < S.outerSize(); ++c)
+  {
+    for(SparseMatrix::InnerIterator it(S, c); it; ++it)
+      T.coeffRef(static_cast<int>(it.row()), c) = it.value();
+  }
+  return T;
+}
+} // namespace
+
+void SchurComplement::compute(const BlockMatrix & K, bool positiveDefinite)
+{
+  if(K.blkRows() != 2 || K.blkCols() != 2)
+    throw std::runtime_error("[SchurComplement::compute] Matrix must be a 2 x 2 block matrix.");
+  if(K.rowsOfBlock(0) != K.colsOfBlock(0) || K.rowsOfBlock(1) != K.colsOfBlock(1))
+    throw std::runtime_error("[SchurComplement::compute] Diagonal blocks must be square.");
+
+  const int n1 = K.rowsOfBlock(0);
+  const int n2 = K.rowsOfBlock(1);
+  const auto A = getBlock(K, 0, 0);
+  const auto B = getBlock(K, 0, 1);
+  const auto C = getBlock(K, 1, 0);
+  const auto D = getBlock(K, 1, 1);
+
+  Ainv_.compute(*A.matrix, A.trans, positiveDefinite);
+
+  // W = A^{-1} B, kept structured if A^{-1} has a simple representation.
+  if(auto Ainv = Ainv_.toMatrix())
+  {
+    internal::SimpleAccumulator W(n1, n2);
+    W.addProduct(constTransposableMatrix(Ainv, false), B);
+    W_ = W.toMatrix();
+  }
+  else if(internal::simpleType(*B.matrix) == SimpleType::Zero)
+    W_ = std::make_shared<ZeroMatrix>(n1, n2);
+  else
+  {
+    Eigen::MatrixXd W(n1, n2);
+    B.matrix->toDense(W, B.trans);
+    Ainv_.solveInPlace(W);
+    W_ = std::make_shared<DenseMatrix>(W, true);
+  }
+
+  internal::SimpleAccumulator S(n2, n2);
+  S.add(D);
+  S.addProduct(C, constTransposableMatrix(W_, false), -1);
+  S_ = S.toMatrix();
+  Sinv_.compute(*S_, false, false);
+}
+
+void SchurComplement::solveInPlace(const BlockMatrix & K, MatrixRef R) const
+{
+  const int n1 = K.rowsOfBlock(0);
+  const int n2 = size();
+  assert(R.rows() == n1 + n2);
+  auto R1 = R.topRows(n1);
+  auto R2 = R.bottomRows(n2);
+
+  // S X_2 = R_2 - C A^{-1} R_1
+  Ainv_.solveInPlace(R1);
+  const BlockView C = K.blockView(1, 0);
+  for(int j = 0; j < R.cols(); ++j)
+    C.multiply(R1.col(j), R2.col(j), -1, 1, false);
+  Sinv_.solveInPlace(R2);
+
+  // X_1 = A^{-1} R_1 - W X_2
+  for(int j = 0; j < R.cols(); ++j)
+    W_->multiply(R2.col(j), R1.col(j), -1, 1, false);
+}
+
+void SchurComplement::Inverse::compute(const MatrixBase & M, bool transpose, bool positiveDefinite)
+{
+  if(M.rows() != M.cols())
+    throw std::runtime_error("[SchurComplement] Matrix to be inverted must be square.");
+  size_ = M.rows();
+  auto singular = []() { throw std::runtime_error("[SchurComplement] Matrix to be inverted is singular."); };
+
+  switch(internal::simpleType(M))
+  {
+    case SimpleType::Zero:
+      if(size_ > 0)
+        singular();
+      kind_ = Kind::Diagonal;
+      d_.resize(0);
+      break;
+    case SimpleType::MultipleOfIdentity:
+    {
+      const double a = internal::identityFactor(M);
+      if(a == 0)
+        singular();
+      kind_ = Kind::MultipleOfIdentity;
+      s_ = 1 / a;
+      break;
+    }
+    case SimpleType::Diagonal:
+    {
+      const auto d = internal::diagonalData(M);
+      if((d.array() == 0).any())
+        singular();
+      kind_ = Kind::Diagonal;
+      d_ = d.cwiseInverse();
+      break;
+    }
+    case SimpleType::Dense:
+      kind_ = Kind::Dense;
+      if(transpose)
+        lu_.compute(internal::denseData(M).transpose());
+      else
+        lu_.compute(internal::denseData(M));
+      break;
+    default:
+      if(auto band = dynamic_cast<const BandMatrix *>(&M))
+      {
+        kind_ = Kind::Band;
+        if(transpose)
+        {
+          const int l = band->lowerBandwidth();
+          const int u = band->upperBandwidth();
+          BandMatrix T(size_, size_, u, l);
+          for(int c = 0; c < size_; ++c)
+          {
+            for(int r = band->colBegin(c); r < band->colEnd(c); ++r)
+              T.coeffRef(c, r) = band->data()(u + r - c, c);
+          }
+          bandLU_.compute(T);
+        }
+        else
+          bandLU_.compute(*band);
+      }
+      else if(auto block = dynamic_cast<const BlockMatrix *>(&M);
+              block && positiveDefinite && isBlockTriDiagonal(*block))
+      {
+        // Declared symmetric, so that the transposition does not matter
+        kind_ = Kind::BlockTriDiagonal;
+        blockLLT_.compute(*block);
+      }
+      else if(block && block->shape().type() == internal::ShapeType::Band)
+      {
+        kind_ = Kind::Band;
+        bandLU_.compute(toBand(*block, transpose));
+      }
+      else
+      {
+        kind_ = Kind::Dense;
+        Eigen::MatrixXd D(size_, size_);
+        M.toDense(D, transpose);
+        lu_.compute(D);
+      }
+  }
+
+  if(kind_ == Kind::Dense && (lu_.matrixLU().diagonal().array() == 0).any())
+    singular();
+}
+
+void SchurComplement::Inverse::solveInPlace(MatrixRef B) const
+{
+  assert(B.rows() == size_);
+  switch(kind_)
+  {
+    case Kind::MultipleOfIdentity:
+      B *= s_;
+      break;
+    case Kind::Diagonal:
+      B = d_.asDiagonal() * B;
+      break;
+    case Kind::Band:
+      bandLU_.solveInPlace(B);
+      break;
+    case Kind::BlockTriDiagonal:
+      blockLLT_.solveInPlace(B);
+      break;
+    case Kind::Dense:
+      B = lu_.permutationP() * B;
+      lu_.matrixLU().triangularView<Eigen::UnitLower>().solveInPlace(B);
+      lu_.matrixLU().triangularView<Eigen::Upper>().solveInPlace(B);
+      break;
+  }
+}
+
+MatrixPtr SchurComplement::Inverse::toMatrix() const
+{
+  switch(kind_)
+  {
+    case Kind::MultipleOfIdentity:
+      return std::make_shared<MultipleOfIdentityMatrix>(size_, s_);
+    case Kind::Diagonal:
+      return std::make_shared<DiagonalMatrix>(d_, true);
+    default:
+      return nullptr;
+  }
+}
+
+} // namespace mls
@@ -0,0 +1,215 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/FixedMatrix.h>
+#include <mlsm/SimpleMatrix.h>
+#include <mlsm/internal/SimpleAccumulator.h>
+
+namespace mls::internal
+{
+namespace
+{
+/** Dense representation of op(A) if \p transpose is false, op(A)^T otherwise.*/
+Eigen::MatrixXd toDense(const constTransposableMatrix & A, bool transpose)
+{
+  Eigen::MatrixXd D(transpose ? A.cols() : A.rows(), transpose ? A.rows() : A.cols());
+  A.matrix->toDense(D, A.trans != transpose);
+  return D;
+}
+} // namespace
+
+SimpleAccumulator::SimpleAccumulator(int rows, int cols) : rows_(rows), cols_(cols) {}
+
+void SimpleAccumulator::add(const constTransposableMatrix & A, double alpha)
+{
+  assert(A.rows() == rows_ && A.cols() == cols_);
+  if(alpha == 0)
+    return;
+
+  switch(simpleType(*A.matrix))
+  {
+    case SimpleType::Zero:
+      break;
+    case SimpleType::MultipleOfIdentity:
+    {
+      double s = alpha * identityFactor(*A.matrix);
+      promote(SimpleType::MultipleOfIdentity);
+      if(type_ == SimpleType::MultipleOfIdentity)
+        s_ += s;
+      else if(type_ == SimpleType::Diagonal)
+        d_.array() += s;
+      else
+        M_.diagonal().array() += s;
+      break;
+    }
+    case SimpleType::Diagonal:
+      promote(SimpleType::Diagonal);
+      if(type_ == SimpleType::Diagonal)
+        d_ += alpha * diagonalData(*A.matrix);
+      else
+        M_.diagonal() += alpha * diagonalData(*A.matrix);
+      break;
+    case SimpleType::Dense:
+      promote(SimpleType::Dense);
+      if(A.trans)
+        M_ += alpha * denseData(*A.matrix).transpose();
+      else
+        M_ += alpha * denseData(*A.matrix);
+      break;
+    default:
+      promote(SimpleType::Dense);
+      M_ += alpha * toDense(A, false);
+  }
+}
+
+void SimpleAccumulator::addProduct(const constTransposableMatrix & A,
+                                   const constTransposableMatrix & B,
+                                   double alpha)
+{
+  assert(A.rows() == rows_ && B.cols() == cols_ && A.cols() == B.rows());
+  const SimpleType ta = simpleType(*A.matrix);
+  const SimpleType tb = simpleType(*B.matrix);
+
+  if(alpha == 0 || ta == SimpleType::Zero || tb == SimpleType::Zero)
+    return;
+
+  // Products with a multiple of the identity are (scaled) additions.
+  if(ta == SimpleType::MultipleOfIdentity)
+  {
+    add(B, alpha * identityFactor(*A.matrix));
+    return;
+  }
+  if(tb == SimpleType::MultipleOfIdentity)
+  {
+    add(A, alpha * identityFactor(*B.matrix));
+    return;
+  }
+
+  if(ta == SimpleType::Diagonal && tb == SimpleType::Diagonal)
+  {
+    promote(SimpleType::Diagonal);
+    if(type_ == SimpleType::Diagonal)
+      d_ += alpha * diagonalData(*A.matrix).cwiseProduct(diagonalData(*B.matrix));
+    else
+      M_.diagonal() += alpha * diagonalData(*A.matrix).cwiseProduct(diagonalData(*B.matrix));
+    return;
+  }
+
+  promote(SimpleType::Dense);
+
+  // For general matrices, we rely on their matrix-vector product. op(A) * op(B) is computed column
+  // by column, or row by row through (op(B)^T * op(A)^T)^T.
+  if(ta == SimpleType::Other)
+  {
+    Eigen::MatrixXd Bd = toDense(B, false);
+    for(int j = 0; j < cols_; ++j)
+      A.matrix->multiply(Bd.col(j), M_.col(j), alpha, 1, A.trans);
+    return;
+  }
+  if(tb == SimpleType::Other)
+  {
+    Eigen::MatrixXd AdT = toDense(A, true);
+    Eigen::VectorXd tmp(cols_);
+    for(int i = 0; i < rows_; ++i)
+    {
+      B.matrix->multiply(AdT.col(i), tmp, alpha, 0, !B.trans);
+      M_.row(i) += tmp.transpose();
+    }
+    return;
+  }
+
+  if(ta == SimpleType::Diagonal)
+  {
+    if(B.trans)
+      M_ += alpha * diagonalData(*A.matrix).asDiagonal() * denseData(*B.matrix).transpose();
+    else
+      M_ += alpha * diagonalData(*A.matrix).asDiagonal() * denseData(*B.matrix);
+    return;
+  }
+  if(tb == SimpleType::Diagonal)
+  {
+    if(A.trans)
+      M_ += alpha * denseData(*A.matrix).transpose() * diagonalData(*B.matrix).asDiagonal();
+    else
+      M_ += alpha * denseData(*A.matrix) * diagonalData(*B.matrix).asDiagonal();
+    return;
+  }
+
+  const auto & MA = denseData(*A.matrix);
+  const auto & MB = denseData(*B.matrix);
+
+  // Matrices of fixed size perform the product with fixed-size kernels.
+  if(auto FA = dynamic_cast<const FixedDenseMatrixBase *>(A.matrix.get()); FA && !B.trans)
+  {
+    FA->addLeftProduct(MB, M_, alpha, A.trans);
+    return;
+  }
+  if(auto FB = dynamic_cast<const FixedDenseMatrixBase *>(B.matrix.get()); FB && !A.trans)
+  {
+    FB->addRightProduct(MA, M_, alpha, B.trans);
+    return;
+  }
+
+  auto gemm = [&](const auto & a, const auto & b) { M_.noalias() += alpha * a * b; };
+  if(A.trans)
+  {
+    if(B.trans)
+      gemm(MA.transpose(), MB.transpose());
+    else
+      gemm(MA.transpose(), MB);
+  }
+  else
+  {
+    if(B.trans)
+      gemm(MA, MB.transpose());
+    else
+      gemm(MA, MB);
+  }
+}
+
+MatrixPtr SimpleAccumulator::toMatrix() const
+{
+  switch(type_)
+  {
+    case SimpleType::Zero:
+      return std::make_shared<ZeroMatrix>(rows_, cols_);
+    case SimpleType::MultipleOfIdentity:
+      if(s_ == 1)
+        return std::make_shared<IdentityMatrix>(rows_);
+      else
+        return std::make_shared<MultipleOfIdentityMatrix>(rows_, s_);
+    case SimpleType::Diagonal:
+      return std::make_shared<DiagonalMatrix>(d_, true);
+    default:
+      return std::make_shared<DenseMatrix>(M_, true);
+  }
+}
+
+void SimpleAccumulator::promote(SimpleType t)
+{
+  assert(t != SimpleType::Other);
+  if(t <= type_)
+    return;
+  assert((t != SimpleType::MultipleOfIdentity && t != SimpleType::Diagonal) || rows_ == cols_);
+
+  switch(t)
+  {
+    case SimpleType::MultipleOfIdentity:
+      s_ = 0;
+      break;
+    case SimpleType::Diagonal:
+      d_.setConstant(rows_, type_ == SimpleType::Zero ? 0 : s_);
+      break;
+    case SimpleType::Dense:
+      M_.setZero(rows_, cols_);
+      if(type_ == SimpleType::MultipleOfIdentity)
+        M_.diagonal().setConstant(s_);
+      else if(type_ == SimpleType::Diagonal)
+        M_.diagonal() = d_;
+      break;
+    default:
+      assert(false);
+  }
+  type_ = t;
+}
+
+} // namespace mls::internal
@@ -29,4 +29,117 @@ DenseMatrix::DenseMatrix(const MatrixConstRef & M, bool copy)
 DenseMatrix::DenseMatrix(const MatrixRef & M, NonConstRef_t)
 : shape_(M.rows(), M.cols()), mat_(new internal::SimpleStorageDenseNonConstRef(M))
 {}
+
+BandMatrix::BandMatrix(int rows, int cols, int lowerBandwidth, int upperBandwidth)
+: shape_(rows, cols, lowerBandwidth, upperBandwidth), l_(lowerBandwidth), u_(upperBandwidth)
+{
+  if(lowerBandwidth < 0 || upperBandwidth < 0)
+    throw std::runtime_error("[BandMatrix::BandMatrix] Bandwidths must be non-negative.");
+  data_.setZero(lowerBandwidth + upperBandwidth + 1, cols);
+}
+
+BandMatrix::BandMatrix(const MatrixConstRef & M, int lowerBandwidth, int upperBandwidth)
+: BandMatrix(static_cast<int>(M.rows()), static_cast<int>(M.cols()), lowerBandwidth, upperBandwidth)
+{
+  for(int c = 0; c < cols(); ++c)
+  {
+    const int r0 = colBegin(c);
+    const int n = colEnd(c) - r0;
+    if(n > 0)
+      data_.col(c).segment(u_ + r0 - c, n) = M.col(c).segment(r0, n);
+  }
+}
+
+void BandMatrix::toDense(MatrixRef D, bool transpose) const
+{
+  assert(D.rows() == (transpose ? cols() : rows()) && D.cols() == (transpose ? rows() : cols()));
+  D.setZero();
+  for(int c = 0; c < cols(); ++c)
+  {
+    const int r0 = colBegin(c);
+    const int n = colEnd(c) - r0;
+    if(n <= 0)
+      continue;
+    if(transpose)
+      D.row(c).segment(r0, n) = data_.col(c).segment(u_ + r0 - c, n).transpose();
+    else
+      D.col(c).segment(r0, n) = data_.col(c).segment(u_ + r0 - c, n);
+  }
+}
+
+void BandMatrix::multiply(VectorConstRef x, VectorRef y, double alpha, double beta, bool transpose) const
+{
+  assert(x.size() == (transpose ? rows() : cols()) && y.size() == (transpose ? cols() : rows()));
+  scale(y, beta);
+  // Column-wise traversal, so that the packed elements are read contiguously.
+  for(int c = 0; c < cols(); ++c)
+  {
+    const int r0 = colBegin(c);
+    const int n = colEnd(c) - r0;
+    if(n <= 0)
+      continue;
+    const auto a = data_.col(c).segment(u_ + r0 - c, n);
+    if(transpose)
+      y[c] += alpha * a.dot(x.segment(r0, n));
+    else
+      y.segment(r0, n) += (alpha * x[c]) * a;
+  }
+}
+
+int BandMatrix::sparseColNNZ(int c, bool transpose) const
+{
+  // Column c of M^T is the row c of M, whose elements in the band are on the columns c - l to c + u.
+  if(transpose)
+    return std::max(0, std::min(cols(), c + u_ + 1) - std::max(0, c - l_));
+  else
+    return std::max(0, colEnd(c) - colBegin(c));
+}
+
+int BandMatrix::sparseCol(int c, bool transpose, int rowOffset, int * inner, double * values) const
+{
+  const int i0 = transpose ? std::max(0, c - l_) : colBegin(c);
+  const int n = sparseColNNZ(c, transpose);
+  for(int k = 0; k < n; ++k)
+  {
+    const int i = i0 + k;
+    if(inner)
+      inner[k] = rowOffset + i;
+    values[k] = transpose ? data_(u_ + c - i, i) : data_(u_ + i - c, c);
+  }
+  return n;
+}
+
+std::shared_ptr<BandMatrix> mult(const BandMatrix & lhs, const BandMatrix & rhs, bool transposeLhs, bool transposeRhs)
+{
+  // Sizes and bandwidths of op(lhs) and op(rhs)
+  const int rows = transposeLhs ? lhs.cols() : lhs.rows();
+  const int inner = transposeLhs ? lhs.rows() : lhs.cols();
+  const int cols = transposeRhs ? rhs.rows() : rhs.cols();
+  const int ll = transposeLhs ? lhs.upperBandwidth() : lhs.lowerBandwidth();
+  const int lu = transposeLhs ? lhs.lowerBandwidth() : lhs.upperBandwidth();
+  const int rl = transposeRhs ? rhs.upperBandwidth() : rhs.lowerBandwidth();
+  const int ru = transposeRhs ? rhs.lowerBandwidth() : rhs.upperBandwidth();
+  if(inner != (transposeRhs ? rhs.cols() : rhs.rows()))
+    throw std::runtime_error("[mult(BandMatrix, BandMatrix)] Incompatible sizes.");
+
+  auto res = std::make_shared<BandMatrix>(rows, cols, std::min(ll + rl, std::max(0, rows - 1)),
+                                          std::min(lu + ru, std::max(0, cols - 1)));
+  // Packed element (i,j) of op(M), for (i,j) in the band of op(M)
+  auto elem = [](const BandMatrix & M, bool tr, int i, int j) {
+    return tr ? M.data()(M.upperBandwidth() + j - i, i) : M.data()(M.upperBandwidth() + i - j, j);
+  };
+  // res_{:,j} = sum_k op(lhs)_{:,k} op(rhs)_{k,j}, the sums being restricted to the bands.
+  for(int j = 0; j < cols; ++j)
+  {
+    for(int k = std::max(0, j - ru); k < std::min(inner, j + rl + 1); ++k)
+    {
+      const double b = elem(rhs, transposeRhs, k, j);
+      if(b == 0)
+        continue;
+      for(int i = std::max(0, k - lu); i < std::min(rows, k + ll + 1); ++i)
+        res->coeffRef(i, j) += elem(lhs, transposeLhs, i, k) * b;
+    }
+  }
+  return res;
+}
 } // namespace mls
\ No newline at end of file
@@ -0,0 +1,46 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/FixedMatrix.h>
+#include <mlsm/SimpleMatrix.h>
+#include <mlsm/internal/SimpleType.h>
+
+namespace mls::internal
+{
+SimpleType simpleType(const MatrixBase & M)
+{
+  if(!M.isSimple())
+    return SimpleType::Other;
+  if(dynamic_cast<const ZeroMatrix *>(&M))
+    return SimpleType::Zero;
+  if(dynamic_cast<const IdentityMatrix *>(&M) || dynamic_cast<const MultipleOfIdentityMatrix *>(&M))
+    return SimpleType::MultipleOfIdentity;
+  if(dynamic_cast<const DiagonalMatrix *>(&M))
+    return SimpleType::Diagonal;
+  if(dynamic_cast<const DenseMatrix *>(&M) || dynamic_cast<const FixedDenseMatrixBase *>(&M))
+    return SimpleType::Dense;
+  return SimpleType::Other;
+}
+
+double identityFactor(const MatrixBase & M)
+{
+  if(auto I = dynamic_cast<const MultipleOfIdentityMatrix *>(&M))
+    return I->value();
+  assert(dynamic_cast<const IdentityMatrix *>(&M));
+  return 1;
+}
+
+VectorConstRef diagonalData(const MatrixBase & M)
+{
+  assert(dynamic_cast<const DiagonalMatrix *>(&M));
+  return static_cast<const DiagonalMatrix &>(M).diagonal();
+}
+
+MatrixConstRef denseData(const MatrixBase & M)
+{
+  if(auto F = dynamic_cast<const FixedDenseMatrixBase *>(&M))
+    return F->matrix();
+  assert(dynamic_cast<const DenseMatrix *>(&M));
+  return static_cast<const DenseMatrix &>(M).matrix();
+}
+
+} // namespace mls::internal
@@ -0,0 +1,207 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+// Allocations through Eigen are detected by Eigen itself (in debug mode), other allocations by
+// replacing the global operator new.
+#define EIGEN_RUNTIME_NO_MALLOC
+
+#include <mlsm/BlockMatrix.h>
+#include <mlsm/BlockTriDiagonalCholesky.h>
+#include <mlsm/FixedMatrix.h>
+#include <mlsm/RiccatiRecursion.h>
+#include <mlsm/SimpleMatrix.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+#include "TestUtils.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+bool countAllocations = false;
+int allocationCount = 0;
+
+void * allocate(std::size_t n)
+{
+  if(countAllocations)
+    ++allocationCount;
+  if(void * p = std::malloc(n > 0 ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+} // namespace
+
+void * operator new(std::size_t n) { return allocate(n); }
+void * operator new[](std::size_t n) { return allocate(n); }
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void * p, std::size_t) noexcept { std::free(p); }
+
+using namespace mls;
+
+/** Number of heap allocations performed while running f.*/
+template<typename F>
+int allocations(F && f)
+{
+  allocationCount = 0;
+  countAllocations = true;
+  Eigen::internal::set_is_malloc_allowed(false);
+  f();
+  Eigen::internal::set_is_malloc_allowed(true);
+  countAllocations = false;
+  return allocationCount;
+}
+
+TEST_CASE("Frozen structure")
+{
+  TriDiagonalBlockMatrix M(3);
+  M.setBlock(0, 0, std::make_shared<IdentityMatrix>(2));
+  M.setBlock(1, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+  M.setBlock(2, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 1), true));
+  M.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 2), true));
+  FAST_CHECK_UNARY(!M.isStructureFrozen());
+  M.freezeStructure();
+  FAST_CHECK_UNARY(M.isStructureFrozen());
+  FAST_CHECK_EQ(M.rows(), 6);
+
+  CHECK_THROWS_AS(M.setRowsOfBlock(0, 3), std::runtime_error);
+  CHECK_THROWS_AS(M.setColsOfBlock(0, 3), std::runtime_error);
+  CHECK_THROWS_AS(M.resetRowsOfBlock(2), std::runtime_error);
+  CHECK_THROWS_AS(M.resetColsOfBlock(2), std::runtime_error);
+  CHECK_THROWS_AS(M.setBlock(2, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true)),
+                  std::runtime_error);
+  M.setBlock(2, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 3), true));
+  M.updateSize();
+  FAST_CHECK_EQ(M.rows(), 6);
+
+  M.freezeStructure(false);
+  FAST_CHECK_UNARY(!M.isStructureFrozen());
+  M.resetRowsOfBlock(2);
+}
+
+TEST_CASE("No allocation in frozen mode")
+{
+  const int n = 5;
+  TriDiagonalBlockMatrix M(n, true, false);
+  std::vector<std::shared_ptr<DenseMatrix>> diag;
+  std::vector<std::shared_ptr<FixedDenseMatrix<3, 3>>> sub;
+  for(int i = 0; i < n; ++i)
+  {
+    diag.push_back(std::make_shared<DenseMatrix>(Eigen::MatrixXd::Zero(3, 3), true));
+    M.setBlock(i, i, diag.back());
+    if(i + 1 < n)
+    {
+      sub.push_back(std::make_shared<FixedDenseMatrix<3, 3>>());
+      M.setBlock(i + 1, i, sub.back());
+    }
+  }
+  M.freezeStructure();
+
+  auto refresh = [&]() {
+    // Symmetric, diagonally dominant blocks
+    for(auto & D : diag)
+    {
+      auto A = D->matrix();
+      A.setRandom();
+      for(int j = 0; j < 3; ++j)
+      {
+        for(int i = j + 1; i < 3; ++i)
+          A(j, i) = A(i, j);
+      }
+      A.diagonal().array() += 10;
+    }
+    for(auto & C : sub)
+      C->fixed().setRandom();
+  };
+
+  Eigen::VectorXd x = Eigen::VectorXd::Random(3 * n);
+  Eigen::VectorXd y(3 * n);
+  Eigen::MatrixXd D(3 * n, 3 * n);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(3 * n, 2);
+  refresh();
+  BlockTriDiagonalCholesky llt;
+  llt.analyzePattern(M);
+  FAST_CHECK_EQ(allocations([&]() { llt.factorize(M); }), 0);
+
+  FAST_CHECK_EQ(allocations(refresh), 0);
+  FAST_CHECK_EQ(allocations([&]() { M.updateSize(); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { M.toDense(D, false); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { M.multiply(x, y, 1, 0, false); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { M.multiply(x, y, 2, 1, true); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { llt.compute(M); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { llt.solveInPlace(B); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { llt.solveInPlace(x); }), 0);
+  FAST_CHECK_EQ(allocations([&]() {
+                  for(int r = 0; r < n; ++r)
+                  {
+                    for(int c = 0; c < n; ++c)
+                      M.block(r, c);
+                  }
+                }),
+                0);
+
+  // Sanity checks: the allocations are detected, and the results are correct
+  FAST_CHECK_EQ(allocations([]() { auto Z = std::make_shared<ZeroMatrix>(2, 2); }), 1);
+  Eigen::VectorXd b = D * x;
+  llt.compute(M);
+  FAST_CHECK_UNARY(llt.solve(b).isApprox(x));
+}
+
+TEST_CASE("No allocation in single precision factorization")
+{
+  // Blocks without dedicated kernel and of different sizes, converted through the same buffer
+  const int sizes[] = {3, 2, 4, 1};
+  TriDiagonalBlockMatrix M(4, true, false);
+  for(int i = 0; i < 4; ++i)
+  {
+    Eigen::MatrixXd A = Eigen::MatrixXd::Random(sizes[i], sizes[i]);
+    A = A * A.transpose();
+    A.diagonal().array() += 10;
+    M.setBlock(i, i, std::make_shared<FloatDenseMatrix>(A));
+    if(i < 3)
+      M.setBlock(i + 1, i, std::make_shared<FloatDenseMatrix>(Eigen::MatrixXd::Random(sizes[i + 1], sizes[i])));
+  }
+  M.updateSize();
+
+  BlockTriDiagonalCholeskyF llt;
+  llt.analyzePattern(M);
+  FAST_CHECK_EQ(allocations([&]() { llt.factorize(M); }), 0);
+
+  Eigen::MatrixXf B = Eigen::MatrixXf::Random(10, 2);
+  Eigen::MatrixXd D = static_cast<const MatrixBase &>(M).toDense();
+  FAST_CHECK_UNARY((D.cast<float>() * llt.solve(B)).isApprox(B, 1e-4f));
+}
+
+TEST_CASE("No allocation in Riccati solves")
+{
+  // Stages with different state and control sizes
+  const int nx[] = {3, 2, 4, 2};
+  const int nu[] = {1, 2, 2, 0};
+  DiagonalBlockMatrix H(4);
+  BandBlockMatrix G(4, 4, 1, 0);
+  for(int k = 0; k < 4; ++k)
+  {
+    const int nk = nx[k] + nu[k];
+    H.setBlock(k, k, spd(nk));
+    Eigen::MatrixXd E = Eigen::MatrixXd::Zero(nx[k], nk);
+    E.leftCols(nx[k]) = -Eigen::MatrixXd::Identity(nx[k], nx[k]);
+    G.setBlock(k, k, std::make_shared<DenseMatrix>(E, true));
+    if(k < 3)
+      G.setBlock(k + 1, k, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(nx[k + 1], nk), true));
+  }
+  H.updateSize();
+  G.updateSize();
+
+  RiccatiRecursion riccati(H, G);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(riccati.size(), 3);
+  Eigen::MatrixXd X = B;
+  Eigen::VectorXd x = B.col(0);
+  FAST_CHECK_EQ(allocations([&]() { riccati.solveInPlace(X); }), 0);
+  FAST_CHECK_EQ(allocations([&]() { riccati.solveInPlace(x); }), 0);
+  FAST_CHECK_UNARY(X.col(0).isApprox(x));
+  FAST_CHECK_UNARY(riccati.solve(B).isApprox(X));
+}
@@ -0,0 +1,169 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BandDecompositions.h>
+#include <mlsm/BlockMatrix.h>
+#include <mlsm/SimpleMatrix.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+using namespace mls;
+
+namespace
+{
+/** M with the elements outside of the band of lower and upper bandwidths l and u set to zero.*/
+Eigen::MatrixXd bandPart(Eigen::MatrixXd M, int l, int u)
+{
+  for(int i = 0; i < M.rows(); ++i)
+  {
+    for(int j = 0; j < M.cols(); ++j)
+    {
+      if(j < i - l || j > i + u)
+        M(i, j) = 0;
+    }
+  }
+  return M;
+}
+
+/** Random m x n matrix with lower and upper bandwidths l and u.*/
+Eigen::MatrixXd randomBand(int m, int n, int l, int u) { return bandPart(Eigen::MatrixXd::Random(m, n), l, u); }
+
+Eigen::MatrixXd dense(const MatrixBase & M) { return M.toDense(); }
+} // namespace
+
+TEST_CASE("Band matrix")
+{
+  for(auto [m, n] : {std::pair{7, 5}, std::pair{5, 7}, std::pair{6, 6}})
+  {
+    Eigen::MatrixXd M = Eigen::MatrixXd::Random(m, n);
+    Eigen::MatrixXd Md = bandPart(M, 2, 1);
+    BandMatrix B(M, 2, 1);
+    FAST_CHECK_EQ(B.rows(), m);
+    FAST_CHECK_EQ(B.cols(), n);
+    FAST_CHECK_EQ(B.data().rows(), 4);
+    FAST_CHECK_EQ(B.data().cols(), n);
+    FAST_CHECK_EQ(B.shape().type(), internal::ShapeType::Band);
+    FAST_CHECK_EQ(B.data()(1 + 3 - 2, 2), M(3, 2));
+    FAST_CHECK_EQ(B(3, 2), M(3, 2));
+    FAST_CHECK_EQ(B(0, 3), 0);
+
+    Eigen::MatrixXd D(m, n);
+    B.toDense(D, false);
+    FAST_CHECK_UNARY(D == Md);
+    Eigen::MatrixXd Dt(n, m);
+    B.toDense(Dt, true);
+    FAST_CHECK_UNARY(Dt == Md.transpose());
+
+    Eigen::VectorXd x = Eigen::VectorXd::Random(n);
+    Eigen::VectorXd y = Eigen::VectorXd::Random(m);
+    Eigen::VectorXd y0 = y;
+    B.multiply(x, y, 2, 3, false);
+    FAST_CHECK_UNARY(y.isApprox(2 * Md * x + 3 * y0));
+    Eigen::VectorXd z = Eigen::VectorXd::Random(n);
+    B.multiply(y, z, -1, 0, true);
+    FAST_CHECK_UNARY(z.isApprox(-Md.transpose() * y));
+
+    B.coeffRef(1, 1) = 42;
+    FAST_CHECK_EQ(B(1, 1), 42);
+  }
+
+  // As a block of a block matrix
+  auto B = std::make_shared<BandMatrix>(randomBand(6, 6, 1, 1), 1, 1);
+  DenseBlockMatrix M(2, 2);
+  M.setBlock(0, 0, B);
+  M.setBlock(1, 1, std::make_shared<IdentityMatrix>(2));
+  M.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(6, 2), true));
+  M.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 6), true));
+  M.updateSize();
+  Eigen::MatrixXd Md = dense(M);
+  FAST_CHECK_UNARY(Md.topLeftCorner(6, 6) == dense(*B));
+  Eigen::VectorXd x = Eigen::VectorXd::Random(8);
+  FAST_CHECK_UNARY(static_cast<const MatrixBase &>(M).multiply(x).isApprox(Md * x));
+
+  CHECK_THROWS_AS(BandMatrix(3, 3, -1, 1), std::runtime_error);
+}
+
+TEST_CASE("Band product")
+{
+  for(bool tl : {false, true})
+  {
+    for(bool tr : {false, true})
+    {
+      Eigen::MatrixXd A = tl ? randomBand(8, 9, 1, 2) : randomBand(9, 8, 2, 1);
+      Eigen::MatrixXd B = tr ? randomBand(7, 8, 0, 3) : randomBand(8, 7, 3, 0);
+      BandMatrix Ab(A, tl ? 1 : 2, tl ? 2 : 1);
+      BandMatrix Bb(B, tr ? 0 : 3, tr ? 3 : 0);
+      auto C = mult(Ab, Bb, tl, tr);
+      // op(A) has bandwidths (2, 1), op(B) has (3, 0)
+      FAST_CHECK_EQ(C->lowerBandwidth(), 5);
+      FAST_CHECK_EQ(C->upperBandwidth(), 1);
+      Eigen::MatrixXd Cd = (tl ? A.transpose() : A) * (tr ? B.transpose() : B);
+      FAST_CHECK_UNARY(dense(*C).isApprox(Cd));
+    }
+  }
+
+  // Bandwidths limited by the size of the result
+  BandMatrix A(randomBand(4, 4, 3, 3), 3, 3);
+  auto C = mult(A, A);
+  FAST_CHECK_EQ(C->lowerBandwidth(), 3);
+  FAST_CHECK_EQ(C->upperBandwidth(), 3);
+  FAST_CHECK_UNARY(dense(*C).isApprox(dense(A) * dense(A)));
+
+  CHECK_THROWS_AS(mult(A, BandMatrix(3, 3, 1, 1)), std::runtime_error);
+}
+
+TEST_CASE("Band LU")
+{
+  const int n = 20;
+  Eigen::MatrixXd A = randomBand(n, n, 2, 3);
+  BandMatrix Ab(A, 2, 3);
+  BandLU lu(Ab);
+  FAST_CHECK_EQ(lu.size(), n);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(n, 4);
+  FAST_CHECK_UNARY((A * lu.solve(B)).isApprox(B));
+
+  // Zero diagonal elements, which require pivoting
+  for(int i = 0; i < n; i += 3)
+    Ab.coeffRef(i, i) = 0;
+  A = dense(Ab);
+  lu.compute(Ab);
+  FAST_CHECK_UNARY((A * lu.solve(B)).isApprox(B));
+
+  // Lower bandwidth 0: no pivoting possible
+  Eigen::MatrixXd Ud = randomBand(n, n, 0, 2);
+  Ud.diagonal().array() += 3;
+  BandMatrix U(Ud, 0, 2);
+  lu.compute(U);
+  FAST_CHECK_UNARY((dense(U) * lu.solve(B)).isApprox(B));
+
+  U.coeffRef(5, 5) = 0;
+  CHECK_THROWS_AS(lu.compute(U), std::runtime_error);
+  CHECK_THROWS_AS(BandLU{BandMatrix(3, 4, 1, 1)}, std::runtime_error);
+}
+
+TEST_CASE("Band Cholesky")
+{
+  const int n = 20;
+  const int l = 2;
+  Eigen::MatrixXd S = randomBand(n, n, l, l);
+  S += S.transpose().eval();
+  S.diagonal().array() += 2 * (2 * l + 1);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(n, 3);
+
+  // Full band, or lower part only
+  for(int u : {l, 0})
+  {
+    BandMatrix A(S, l, u);
+    BandCholesky llt(A);
+    FAST_CHECK_EQ(llt.size(), n);
+    Eigen::MatrixXd L = dense(llt.matrixL());
+    FAST_CHECK_UNARY(L.isLowerTriangular());
+    FAST_CHECK_UNARY((L * L.transpose()).isApprox(S));
+    FAST_CHECK_UNARY((S * llt.solve(B)).isApprox(B));
+  }
+
+  BandMatrix A(S, l, l);
+  A.coeffRef(4, 4) = -1;
+  CHECK_THROWS_AS(BandCholesky{A}, std::runtime_error);
+}
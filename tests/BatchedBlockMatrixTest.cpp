@@ -0,0 +1,138 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BatchedBlockMatrix.h>
+#include <mlsm/BlockTriDiagonalCholesky.h>
+#include <mlsm/SimpleMatrix.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+#include "TestUtils.h"
+
+using namespace mls;
+
+namespace
+{
+const int sizes[] = {3, 2, 4, 1};
+
+/** Random symmetric positive definite tridiagonal matrix, with a mix of block types.*/
+std::shared_ptr<BlockMatrix> randomTriDiagonal(internal::SymmetricStorage sym)
+{
+  auto A = std::make_shared<BandBlockMatrix>(4, 4, 1, 1, sym);
+  for(int i = 0; i < 4; ++i)
+  {
+    if(i == 1)
+      A->setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(2).array() + 3, true));
+    else
+      A->setBlock(i, i, spd(sizes[i]));
+    if(i < 3)
+    {
+      MatrixPtr B;
+      if(i == 2)
+        B = std::make_shared<ZeroMatrix>(sizes[i + 1], sizes[i]);
+      else
+        B = std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i + 1], sizes[i]), true);
+      if(sym != internal::SymmetricStorage::Upper)
+        A->setBlock(i + 1, i, B);
+      if(sym != internal::SymmetricStorage::Lower)
+        A->setBlock(i, i + 1, B, true);
+    }
+  }
+  A->updateSize();
+  return A;
+}
+} // namespace
+
+TEST_CASE("Batched block matrix")
+{
+  const int N = 7;
+  for(auto sym : {internal::SymmetricStorage::None, internal::SymmetricStorage::Lower,
+                  internal::SymmetricStorage::Upper})
+  {
+    std::vector<std::shared_ptr<BlockMatrix>> A;
+    std::vector<Eigen::MatrixXd> Ad;
+    for(int k = 0; k < N; ++k)
+    {
+      A.push_back(randomTriDiagonal(sym));
+      Ad.push_back(static_cast<const MatrixBase &>(*A.back()).toDense());
+    }
+
+    BatchedBlockMatrix batch(*A[0], N);
+    FAST_CHECK_EQ(batch.batchSize(), N);
+    FAST_CHECK_EQ(batch.rows(), 10);
+    FAST_CHECK_EQ(batch.cols(), 10);
+    FAST_CHECK_EQ(batch.rowsOfBlock(2), 4);
+    FAST_CHECK_EQ(batch.colOffset(3), 9);
+    FAST_CHECK_UNARY(batch.isStored(1, 0));
+    FAST_CHECK_UNARY(batch.isStored(0, 1));
+    FAST_CHECK_UNARY(!batch.isStored(2, 0));
+    for(int k = 0; k < N; ++k)
+      batch.set(k, *A[k]);
+
+    Eigen::MatrixXd D(10, 10);
+    for(int k = 0; k < N; ++k)
+    {
+      batch.toDense(k, D);
+      FAST_CHECK_UNARY(D == Ad[k]);
+    }
+    const BatchedBlockMatrix & cbatch = batch;
+    FAST_CHECK_UNARY(cbatch.block(2, 0).isZero());
+    FAST_CHECK_EQ(cbatch.block(0, 1)(2, 1)[4], Ad[4](2, 4));
+
+    // Products, for the whole batch at once
+    Eigen::MatrixXd X = Eigen::MatrixXd::Random(N, 10);
+    Eigen::MatrixXd Y = Eigen::MatrixXd::Random(N, 10);
+    Eigen::MatrixXd Y0 = Y;
+    batch.multiply(X, Y, 2, 3, false);
+    for(int k = 0; k < N; ++k)
+      FAST_CHECK_UNARY(Y.row(k).transpose().isApprox(2 * Ad[k] * X.row(k).transpose() + 3 * Y0.row(k).transpose()));
+    batch.multiply(X, Y, 1, 0, true);
+    for(int k = 0; k < N; ++k)
+      FAST_CHECK_UNARY(Y.row(k).transpose().isApprox(Ad[k].transpose() * X.row(k).transpose()));
+
+    // Factorization and solve
+    BatchedBlockTriDiagonalCholesky llt(batch);
+    FAST_CHECK_EQ(llt.size(), 10);
+    FAST_CHECK_EQ(llt.batchSize(), N);
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(N, 10);
+    Eigen::MatrixXd S = B;
+    llt.solveInPlace(S);
+    for(int k = 0; k < N; ++k)
+      FAST_CHECK_UNARY((Ad[k] * S.row(k).transpose()).isApprox(B.row(k).transpose()));
+
+    // Values written directly through the blocks
+    batch.block(1, 1)(0, 0)[3] = -1;
+    CHECK_THROWS_AS(llt.compute(batch), std::runtime_error);
+  }
+}
+
+TEST_CASE("Batched block matrix errors")
+{
+  TriDiagonalBlockMatrix T(3);
+  T.setRowsOfBlock(0, 2);
+  T.setColsOfBlock(0, 2);
+  CHECK_THROWS_AS(BatchedBlockMatrix(T, 3), std::runtime_error);
+  for(int i = 1; i < 3; ++i)
+  {
+    T.setRowsOfBlock(i, 2);
+    T.setColsOfBlock(i, 2);
+  }
+  T.updateSize();
+  CHECK_THROWS_AS(BatchedBlockMatrix(T, 0), std::runtime_error);
+  BatchedBlockMatrix batch(T, 3);
+
+  TriDiagonalBlockMatrix T2(3);
+  for(int i = 0; i < 3; ++i)
+    T2.setBlock(i, i, std::make_shared<IdentityMatrix>(i == 2 ? 3 : 2));
+  T2.updateSize();
+  CHECK_THROWS_AS(batch.set(0, T2), std::runtime_error);
+
+  DenseBlockMatrix M(2, 2);
+  M.setBlock(0, 0, std::make_shared<IdentityMatrix>(2));
+  M.setBlock(1, 1, std::make_shared<IdentityMatrix>(2));
+  M.updateSize();
+  BatchedBlockMatrix dense(M, 2);
+  dense.set(1, M);
+  CHECK_THROWS_AS(BatchedBlockTriDiagonalCholesky{dense}, std::runtime_error);
+}
@@ -0,0 +1,184 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BlockGivensQR.h>
+#include <mlsm/SimpleMatrix.h>
+
+#include <Eigen/QR>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+using namespace mls;
+
+// Check the factorization and the least-squares solution against a dense QR
+void checkQR(const BlockMatrix & A)
+{
+  Eigen::MatrixXd Ad = static_cast<const MatrixBase &>(A).toDense();
+  BlockGivensQR qr(A);
+  FAST_CHECK_EQ(qr.rows(), A.rows());
+  FAST_CHECK_EQ(qr.cols(), A.cols());
+
+  // Q^T A = [R; 0]
+  Eigen::MatrixXd R = qr.matrixR();
+  FAST_CHECK_UNARY(R.isUpperTriangular());
+  Eigen::MatrixXd QtA = Ad;
+  qr.applyQTransposeInPlace(QtA);
+  FAST_CHECK_UNARY(QtA.topRows(A.cols()).isApprox(R));
+  FAST_CHECK_UNARY(QtA.bottomRows(A.rows() - A.cols()).isZero(1e-12));
+  qr.applyQInPlace(QtA);
+  FAST_CHECK_UNARY(QtA.isApprox(Ad));
+
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(A.rows(), 2);
+  Eigen::MatrixXd X = qr.solve(B);
+  FAST_CHECK_UNARY(X.isApprox(Ad.householderQr().solve(B)));
+}
+
+MatrixPtr dense(int m, int n) { return std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(m, n), true); }
+
+TEST_CASE("Band least squares")
+{
+  SUBCASE("Stacked banded Jacobian")
+  {
+    // Each column of blocks appears in three consecutive rows of blocks.
+    const int n = 5;
+    BandBlockMatrix A(n + 2, n, 2, 0);
+    for(int c = 0; c < n; ++c)
+    {
+      for(int r = c; r < c + 3; ++r)
+        A.setBlock(r, c, dense(3, 2));
+    }
+    A.updateSize();
+    checkQR(A);
+  }
+
+  SUBCASE("Tridiagonal")
+  {
+    const int sizes[] = {3, 2, 4, 1};
+    TriDiagonalBlockMatrix A(4);
+    for(int i = 0; i < 4; ++i)
+    {
+      for(int j = std::max(0, i - 1); j < std::min(4, i + 2); ++j)
+        A.setBlock(i, j, dense(sizes[i], sizes[j]));
+    }
+    A.setBlock(2, 2, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(4), true));
+    A.setBlock(1, 2, std::make_shared<ZeroMatrix>(2, 4));
+    A.updateSize();
+    checkQR(A);
+  }
+
+  SUBCASE("Symmetric storage")
+  {
+    TriDiagonalBlockMatrix A(3, true, false);
+    for(int i = 0; i < 3; ++i)
+    {
+      A.setBlock(i, i, dense(2, 2));
+      if(i < 2)
+        A.setBlock(i + 1, i, dense(2, 2));
+    }
+    A.updateSize();
+    checkQR(A);
+  }
+}
+
+TEST_CASE("Structured blocks")
+{
+  // Regularized problem [D; lambda I], with D block diagonal with diagonal blocks: a single rotation per
+  // column, and no fill-in.
+  const int n = 4;
+  SparseBlockMatrix A(2 * n, n, {{0, 0}, {1, 1}, {2, 2}, {3, 3}, {4, 0}, {5, 1}, {6, 2}, {7, 3}});
+  for(int i = 0; i < n; ++i)
+  {
+    A.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+    A.setBlock(n + i, i, std::make_shared<MultipleOfIdentityMatrix>(3, 0.1));
+  }
+  A.updateSize();
+  checkQR(A);
+  BlockGivensQR qr(A);
+  FAST_CHECK_EQ(qr.rotations().size(), 3 * n);
+  Eigen::MatrixXd R = qr.matrixR();
+  FAST_CHECK_UNARY(R.isDiagonal());
+
+  // Regularization of a tridiagonal matrix with a band of dense blocks
+  SparseBlockMatrix T(2 * n, n, {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {1, 2}, {2, 1}, {2, 2}, {2, 3}, {3, 2}, {3, 3},
+                                 {4, 0}, {5, 1}, {6, 2}, {7, 3}});
+  for(int i = 0; i < n; ++i)
+  {
+    for(int j = std::max(0, i - 1); j < std::min(n, i + 2); ++j)
+      T.setBlock(i, j, dense(3, 3));
+    T.setBlock(n + i, i, std::make_shared<IdentityMatrix>(3));
+  }
+  T.updateSize();
+  checkQR(T);
+}
+
+TEST_CASE("Symbolic and numeric phases")
+{
+  BandBlockMatrix A(6, 3, 3, 0);
+  std::vector<std::shared_ptr<DenseMatrix>> blocks;
+  for(int c = 0; c < 3; ++c)
+  {
+    for(int r = c; r < std::min(6, c + 4); ++r)
+    {
+      blocks.push_back(std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 2), true));
+      A.setBlock(r, c, blocks.back());
+    }
+  }
+  A.updateSize();
+  BlockGivensQR qr;
+  qr.analyzePattern(A);
+  const size_t nRot = qr.rotations().size();
+  for(int k = 0; k < 3; ++k)
+  {
+    for(auto & b : blocks)
+      b->matrix().setRandom();
+    qr.factorize(A);
+    FAST_CHECK_EQ(qr.rotations().size(), nRot);
+    Eigen::MatrixXd Ad = static_cast<const MatrixBase &>(A).toDense();
+    Eigen::VectorXd b = Eigen::VectorXd::Random(12);
+    FAST_CHECK_UNARY(qr.solve(b).isApprox(Ad.householderQr().solve(b)));
+  }
+
+  // Same sizes, but a block whose type differs from the analyzed one
+  A.setBlock(1, 0, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(2), true));
+  CHECK_THROWS_AS(qr.factorize(A), std::runtime_error);
+  // Same total sizes, but with the sizes of the rows of blocks swapped
+  BandBlockMatrix C(3, 2, 1, 0);
+  const int rows[] = {1, 3, 2};
+  for(int c = 0; c < 2; ++c)
+  {
+    for(int r = c; r < c + 2; ++r)
+      C.setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(rows[r], 2), true));
+  }
+  C.updateSize();
+  BlockGivensQR qr2(C);
+  BandBlockMatrix C2(3, 2, 1, 0);
+  const int rows2[] = {3, 1, 2};
+  for(int c = 0; c < 2; ++c)
+  {
+    for(int r = c; r < c + 2; ++r)
+      C2.setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(rows2[r], 2), true));
+  }
+  C2.updateSize();
+  FAST_CHECK_EQ(C2.rows(), C.rows());
+  CHECK_THROWS_AS(qr2.factorize(C2), std::runtime_error);
+}
+
+TEST_CASE("Errors")
+{
+  BandBlockMatrix W(2, 3, 1, 1);
+  for(int i = 0; i < 2; ++i)
+    W.setBlock(i, i, dense(2, 2));
+  W.setBlock(1, 2, dense(2, 2));
+  W.updateSize();
+  CHECK_THROWS_AS(BlockGivensQR{W}, std::runtime_error);
+
+  // Structurally rank deficient: the second column of blocks is zero.
+  BandBlockMatrix A(3, 2, 1, 0);
+  A.setBlock(0, 0, dense(2, 2));
+  A.setBlock(1, 0, dense(2, 2));
+  A.setBlock(1, 1, std::make_shared<ZeroMatrix>(2, 2));
+  A.setBlock(2, 1, std::make_shared<ZeroMatrix>(2, 2));
+  A.updateSize();
+  CHECK_THROWS_AS(BlockGivensQR{A}, std::runtime_error);
+}
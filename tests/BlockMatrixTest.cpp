@@ -1,7 +1,10 @@
 /** Copyright 2021 CNRS-AIST JRL*/
 
 #include <mlsm/BlockMatrix.h>
+#include <mlsm/FixedMatrix.h>
 #include <mlsm/SimpleMatrix.h>
+#include <mlsm/internal/SimpleAccumulator.h>
+#include <mlsm/internal/SimpleType.h>
 
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
@@ -43,6 +46,14 @@ TEST_CASE("Build")
 
   FAST_CHECK_EQ(M.rows(), 20);
   FAST_CHECK_EQ(M.cols(), 25);
+  FAST_CHECK_EQ(M.rowOffset(0), 0);
+  FAST_CHECK_EQ(M.rowOffset(1), 5);
+  FAST_CHECK_EQ(M.rowOffset(2), 15);
+  FAST_CHECK_EQ(M.rowOffset(3), 20);
+  FAST_CHECK_EQ(M.colOffset(0), 0);
+  FAST_CHECK_EQ(M.colOffset(1), 5);
+  FAST_CHECK_EQ(M.colOffset(2), 20);
+  FAST_CHECK_EQ(M.colOffset(3), 25);
   FAST_CHECK_EQ(M(0, 0), 1);
   FAST_CHECK_EQ(M(3, 3), 1);
   FAST_CHECK_EQ(M(1, 3), 0);
@@ -110,4 +121,808 @@ TEST_CASE("Symmetric storage")
   }
   FAST_CHECK_EQ(C, D);
   FAST_CHECK_UNARY((C - C.transpose()).isZero());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Matrix-vector product")
+{
+  auto check = [](const MatrixBase & M) {
+    Eigen::MatrixXd D = M.toDense();
+    Eigen::VectorXd x = Eigen::VectorXd::Random(M.cols());
+    Eigen::VectorXd xt = Eigen::VectorXd::Random(M.rows());
+    Eigen::VectorXd y0 = Eigen::VectorXd::Random(M.rows());
+    Eigen::VectorXd yt0 = Eigen::VectorXd::Random(M.cols());
+
+    Eigen::VectorXd y = y0;
+    M.multiply(x, y, 1, 0, false);
+    FAST_CHECK_UNARY(y.isApprox(D * x));
+    y = y0;
+    M.multiply(x, y, -2, 0.5, false);
+    FAST_CHECK_UNARY(y.isApprox(-2 * D * x + 0.5 * y0));
+    Eigen::VectorXd yt = yt0;
+    M.multiply(xt, yt, 3, 1, true);
+    FAST_CHECK_UNARY(yt.isApprox(3 * D.transpose() * xt + yt0));
+  };
+
+  SUBCASE("Dense block matrix")
+  {
+    DenseBlockMatrix M(2, 3);
+    M.setBlock(0, 0, std::make_shared<IdentityMatrix>(3));
+    M.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 4), true));
+    M.setBlock(0, 2, std::make_shared<ZeroMatrix>(3, 2));
+    M.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 4), true), true);
+    M.setBlock(1, 1, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(4), true));
+    M.setBlock(1, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 2), true));
+    M.updateSize();
+    check(M);
+  }
+
+  SUBCASE("Symmetric band block matrix")
+  {
+    for(bool upper : {true, false})
+    {
+      TriDiagonalBlockMatrix M(4, true, upper);
+      for(int i = 0; i < 4; ++i)
+      {
+        Eigen::MatrixXd A = Eigen::MatrixXd::Random(3, 3);
+        M.setBlock(i, i, std::make_shared<DenseMatrix>(A + A.transpose(), true));
+        if(i < 3)
+        {
+          if(upper)
+            M.setBlock(i, i + 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+          else
+            M.setBlock(i + 1, i, std::make_shared<MultipleOfIdentityMatrix>(3, -2.));
+        }
+      }
+      M.updateSize();
+      check(M);
+    }
+  }
+
+  SUBCASE("Sparse block matrix")
+  {
+    SparseBlockMatrix M(3, 4, {{0, 1}, {0, 3}, {2, 0}, {2, 2}, {1, 1}});
+    M.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+    M.setBlock(0, 3, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 2), true), true);
+    M.setBlock(1, 1, std::make_shared<IdentityMatrix>(3));
+    M.setBlock(2, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 2), true));
+    M.setBlock(2, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 5), true));
+    M.updateSize();
+    FAST_CHECK_EQ(M.rows(), 9);
+    FAST_CHECK_EQ(M.cols(), 11);
+    FAST_CHECK_UNARY(M.block(1, 0).matrix->shape().type() == internal::ShapeType::Empty);
+    check(M);
+
+    SparseBlockMatrix S(3, 3, {{0, 0}, {1, 1}, {2, 2}, {2, 0}, {0, 2}}, internal::SymmetricStorage::Lower);
+    Eigen::MatrixXd A = Eigen::MatrixXd::Random(2, 2);
+    S.setBlock(0, 0, std::make_shared<DenseMatrix>(A + A.transpose(), true));
+    S.setBlock(1, 1, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+    S.setBlock(2, 2, std::make_shared<IdentityMatrix>(1));
+    S.setBlock(2, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 2), true));
+    CHECK_THROWS(S.setBlock(0, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 1), true)));
+    S.updateSize();
+    Eigen::MatrixXd D = static_cast<const MatrixBase &>(S).toDense();
+    FAST_CHECK_UNARY(D.isApprox(D.transpose()));
+    FAST_CHECK_EQ(D(0, 4), D(4, 0));
+    check(S);
+  }
+
+  SUBCASE("Nested block matrix")
+  {
+    auto T = std::make_shared<DiagonalBlockMatrix>(2);
+    T->setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+    T->setBlock(1, 1, std::make_shared<MultipleOfIdentityMatrix>(2, 4.));
+    DenseBlockMatrix M(2, 2);
+    M.setBlock(0, 0, T, true);
+    M.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(5, 3), true));
+    M.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 4), true));
+    M.setBlock(1, 1, std::make_shared<IdentityMatrix>(3), true);
+    M.updateSize();
+    check(M);
+  }
+}
+
+TEST_CASE("Matrix-matrix product")
+{
+  auto check = [](const BlockMatrix & A, const BlockMatrix & B, bool trA, bool trB) {
+    auto C = mult(A, B, trA, trB);
+    Eigen::MatrixXd Ad = static_cast<const MatrixBase &>(A).toDense();
+    Eigen::MatrixXd Bd = static_cast<const MatrixBase &>(B).toDense();
+    if(trA)
+      Ad.transposeInPlace();
+    if(trB)
+      Bd.transposeInPlace();
+    FAST_CHECK_UNARY(static_cast<const MatrixBase &>(*C).toDense().isApprox(Ad * Bd));
+    return C;
+  };
+
+  // Block lower bidiagonal "Jacobian", with various types of blocks
+  BandBlockMatrix J(5, 4, 1, 0);
+  for(int i = 0; i < 4; ++i)
+  {
+    if(i % 2)
+      J.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+    else
+      J.setBlock(i, i, std::make_shared<IdentityMatrix>(3));
+    if(i < 3)
+      J.setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+    else
+      J.setBlock(i + 1, i, std::make_shared<MultipleOfIdentityMatrix>(3, -2.));
+  }
+  J.updateSize();
+
+  SUBCASE("J^T J")
+  {
+    auto H = check(J, J, true, false);
+    FAST_CHECK_EQ(H->shape().type(), internal::ShapeType::Band);
+    FAST_CHECK_EQ(H->blkRows(), 4);
+    FAST_CHECK_EQ(H->blkCols(), 4);
+    const auto & s = static_cast<const internal::BandShape &>(H->shape());
+    FAST_CHECK_EQ(s.lowerBandwidth(), 1);
+    FAST_CHECK_EQ(s.upperBandwidth(), 1);
+    // Last diagonal block is D^2 + 4 I
+    FAST_CHECK_EQ(internal::simpleType(*H->block(3, 3).matrix), internal::SimpleType::Diagonal);
+  }
+
+  SUBCASE("J J^T") { check(J, J, false, true); }
+
+  SUBCASE("Band times dense")
+  {
+    DenseBlockMatrix D(4, 2);
+    for(int i = 0; i < 4; ++i)
+    {
+      D.setBlock(i, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 2), true));
+      D.setBlock(i, 1, std::make_shared<ZeroMatrix>(3, 1));
+    }
+    D.updateSize();
+    auto C = check(J, D, false, false);
+    FAST_CHECK_EQ(C->shape().type(), internal::ShapeType::Dense);
+  }
+
+  SUBCASE("Symmetric and nested blocks")
+  {
+    auto T = std::make_shared<DiagonalBlockMatrix>(2);
+    T->setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 1), true));
+    T->setBlock(1, 1, std::make_shared<IdentityMatrix>(2));
+    TriDiagonalBlockMatrix S(4, true);
+    for(int i = 0; i < 4; ++i)
+    {
+      if(i == 2)
+        S.setBlock(i, i, T);
+      else
+        S.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+      if(i < 3)
+        S.setBlock(i, i + 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+    }
+    S.updateSize();
+    check(S, S, false, false);
+    check(J, S, false, false);
+  }
+
+  SUBCASE("Sparse and band")
+  {
+    // Coupling of the 4 columns of blocks of J with 2 "contacts"
+    SparseBlockMatrix C(2, 4, {{0, 0}, {0, 3}, {1, 1}});
+    C.setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+    C.setBlock(0, 3, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+    C.setBlock(1, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 3), true));
+    C.setColsOfBlock(2, 3);
+    C.updateSize();
+
+    // The (block) pattern of J C^T is exact: row i of J has blocks on columns i-1 and i.
+    auto P = check(J, C, false, true);
+    FAST_CHECK_EQ(P->shape().type(), internal::ShapeType::Sparse);
+    const auto & s = static_cast<const internal::SparseShape &>(P->shape());
+    FAST_CHECK_EQ(s.nnz(), 6);
+    FAST_CHECK_UNARY(s.isNonZero(0, 0));
+    FAST_CHECK_UNARY(s.isNonZero(1, 0));
+    FAST_CHECK_UNARY(s.isNonZero(1, 1));
+    FAST_CHECK_UNARY(s.isNonZero(2, 1));
+    FAST_CHECK_UNARY(s.isNonZero(3, 0));
+    FAST_CHECK_UNARY(s.isNonZero(4, 0));
+
+    auto CCt = check(C, C, false, true);
+    FAST_CHECK_EQ(static_cast<const internal::SparseShape &>(CCt->shape()).nnz(), 2);
+    check(C, J, false, true);
+    check(*P, C, false, false);
+  }
+
+  CHECK_THROWS(mult(J, J));
+}
+
+TEST_CASE("Matrix sum")
+{
+  auto check = [](const BlockMatrix & A, const BlockMatrix & B, double alpha, double beta, bool trA, bool trB) {
+    auto C = add(A, B, alpha, beta, trA, trB);
+    Eigen::MatrixXd Ad = static_cast<const MatrixBase &>(A).toDense();
+    Eigen::MatrixXd Bd = static_cast<const MatrixBase &>(B).toDense();
+    if(trA)
+      Ad.transposeInPlace();
+    if(trB)
+      Bd.transposeInPlace();
+    FAST_CHECK_UNARY(static_cast<const MatrixBase &>(*C).toDense().isApprox(alpha * Ad + beta * Bd));
+    return C;
+  };
+
+  // Block diagonal with scaled identities, and block lower bidiagonal with various types of blocks
+  DiagonalBlockMatrix R(4);
+  BandBlockMatrix J(4, 4, 1, 0);
+  for(int i = 0; i < 4; ++i)
+  {
+    R.setBlock(i, i, std::make_shared<MultipleOfIdentityMatrix>(3, i + 1.));
+    if(i % 2)
+      J.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+    else
+      J.setBlock(i, i, std::make_shared<IdentityMatrix>(3));
+    if(i < 3)
+      J.setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+  }
+  R.updateSize();
+  J.updateSize();
+
+  auto C = check(R, J, 2, -1, false, false);
+  FAST_CHECK_EQ(C->shape().type(), internal::ShapeType::Band);
+  // aI + I is a multiple of the identity, aI + D a diagonal matrix
+  FAST_CHECK_EQ(internal::simpleType(*C->block(0, 0).matrix), internal::SimpleType::MultipleOfIdentity);
+  FAST_CHECK_EQ(internal::simpleType(*C->block(1, 1).matrix), internal::SimpleType::Diagonal);
+  FAST_CHECK_EQ(internal::simpleType(*C->block(1, 0).matrix), internal::SimpleType::Dense);
+
+  auto S = check(J, J, 1, 1, false, true);
+  FAST_CHECK_EQ(static_cast<const internal::BandShape &>(S->shape()).upperBandwidth(), 1);
+  check(R, R, 1, 0.5, false, true);
+
+  SparseBlockMatrix P(4, 4, {{0, 3}, {2, 1}});
+  P.setBlock(0, 3, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+  P.setBlock(2, 1, std::make_shared<IdentityMatrix>(3));
+  for(int i = 0; i < 4; ++i)
+  {
+    P.setRowsOfBlock(i, 3);
+    P.setColsOfBlock(i, 3);
+  }
+  P.updateSize();
+  FAST_CHECK_EQ(check(P, J, 1, 1, true, false)->shape().type(), internal::ShapeType::Sparse);
+
+  DiagonalBlockMatrix W(3);
+  CHECK_THROWS_AS(add(R, W), std::runtime_error);
+}
+
+namespace
+{
+/** Random block triangular matrix with a band of 2 blocks, and a mix of block types. The dense diagonal
+ * blocks are full, only their lower or upper part being meant to be used.
+ */
+std::shared_ptr<BlockMatrix> randomTriangular(bool lower)
+{
+  const int sizes[] = {3, 2, 4, 2, 3};
+  auto T = std::make_shared<BandBlockMatrix>(5, 5, lower ? 2 : 0, lower ? 0 : 2);
+  for(int i = 0; i < 5; ++i)
+  {
+    switch(i)
+    {
+      case 1:
+        T->setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(2).array() + 2, true));
+        break;
+      case 2:
+        T->setBlock(i, i, std::make_shared<MultipleOfIdentityMatrix>(4, -2.));
+        break;
+      case 3:
+      {
+        auto N = std::make_shared<DiagonalBlockMatrix>(2);
+        N->setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Constant(1, 1, 3), true));
+        N->setBlock(1, 1, std::make_shared<IdentityMatrix>(1));
+        N->updateSize();
+        T->setBlock(i, i, N);
+        break;
+      }
+      default:
+      {
+        Eigen::MatrixXd D = Eigen::MatrixXd::Random(sizes[i], sizes[i]) + 3 * Eigen::MatrixXd::Identity(sizes[i], sizes[i]);
+        // The last block is stored transposed
+        T->setBlock(i, i, std::make_shared<DenseMatrix>(D, true), i == 4);
+      }
+    }
+    for(int k = 1; k <= 2 && i + k < 5; ++k)
+    {
+      const int r = lower ? i + k : i;
+      const int c = lower ? i : i + k;
+      if((r == 3 && c == 1) || (r == 1 && c == 3))
+        T->setBlock(r, c, std::make_shared<ZeroMatrix>(sizes[r], sizes[c]));
+      else if((r == 4 && c == 2) || (r == 2 && c == 4))
+        T->setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[c], sizes[r]), true), true);
+      else if((r == 3 && c == 2) || (r == 2 && c == 3))
+      {
+        auto N = std::make_shared<DenseBlockMatrix>(1, 1);
+        N->setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[r], sizes[c]), true));
+        N->updateSize();
+        T->setBlock(r, c, N);
+      }
+      else
+        T->setBlock(r, c, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[r], sizes[c]), true));
+    }
+  }
+  T->updateSize();
+  return T;
+}
+} // namespace
+
+TEST_CASE("Triangular solves")
+{
+  for(bool lower : {true, false})
+  {
+    auto T = randomTriangular(lower);
+    Eigen::MatrixXd Td = static_cast<const MatrixBase &>(*T).toDense();
+    if(lower)
+      Td = Td.triangularView<Eigen::Lower>();
+    else
+      Td = Td.triangularView<Eigen::Upper>();
+
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(T->rows(), 7);
+    Eigen::MatrixXd X = solveTriangular(*T, B);
+    FAST_CHECK_UNARY((Td * X).isApprox(B));
+    X = solveTriangular(*T, B, true);
+    FAST_CHECK_UNARY((Td.transpose() * X).isApprox(B));
+
+    // Single right-hand side
+    Eigen::VectorXd b = B.col(0);
+    solveTriangularInPlace(*T, b);
+    FAST_CHECK_UNARY((Td * b).isApprox(B.col(0)));
+  }
+
+  TriDiagonalBlockMatrix M(2);
+  for(int i = 0; i < 2; ++i)
+  {
+    for(int j = 0; j < 2; ++j)
+      M.setBlock(i, j, std::make_shared<IdentityMatrix>(2));
+  }
+  M.updateSize();
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(4, 2);
+  CHECK_THROWS_AS(solveTriangularInPlace(M, B), std::runtime_error);
+
+  auto T = randomTriangular(true);
+  Eigen::MatrixXd C = Eigen::MatrixXd::Random(T->rows() + 1, 2);
+  CHECK_THROWS_AS(solveTriangularInPlace(*T, C), std::runtime_error);
+  T->setBlock(2, 2, std::make_shared<MultipleOfIdentityMatrix>(4, 0.));
+  C = Eigen::MatrixXd::Random(T->rows(), 2);
+  CHECK_THROWS_AS(solveTriangularInPlace(*T, C), std::runtime_error);
+}
+
+TEST_CASE("Sparse conversion")
+{
+  // All kinds of leaves, and a nested block matrix with symmetric storage
+  auto N = std::make_shared<TriDiagonalBlockMatrix>(2, true, false);
+  N->setBlock(0, 0, std::make_shared<IdentityMatrix>(2));
+  N->setBlock(1, 1, std::make_shared<FixedDenseMatrix<3, 3>>(Eigen::Matrix3d::Random()));
+  N->setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 2), true));
+  N->updateSize();
+  auto dense = std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(5, 3), true);
+  auto band = std::make_shared<BandMatrix>(Eigen::MatrixXd::Random(4, 4), 1, 0);
+  auto diag = std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true);
+  SparseBlockMatrix M(3, 3, {{0, 0}, {0, 2}, {1, 1}, {2, 0}, {2, 1}, {2, 2}});
+  M.setBlock(0, 0, N);
+  M.setBlock(0, 2, std::make_shared<FloatDenseMatrix>(Eigen::MatrixXd::Random(5, 3)));
+  M.setBlock(1, 1, band);
+  M.setBlock(2, 0, dense, true);
+  M.setBlock(2, 1, std::make_shared<ZeroMatrix>(3, 4));
+  M.setBlock(2, 2, diag);
+  M.updateSize();
+  const MatrixBase & A = M;
+
+  // 2 + 9 + 2 * 6 for N, 15 for each dense block, 7 for the band and 3 for the diagonal.
+  const int nnz = 63;
+  for(bool tr : {false, true})
+  {
+    SparseMatrix S = A.toSparse(tr);
+    FAST_CHECK_UNARY(S.isCompressed());
+    FAST_CHECK_EQ(S.nonZeros(), nnz);
+    Eigen::MatrixXd D = tr ? A.toDense().transpose() : A.toDense();
+    FAST_CHECK_UNARY(Eigen::MatrixXd(S) == D);
+
+    // Refill of the values, with the same structure
+    dense->matrix().setRandom();
+    band->data().setRandom();
+    diag->diagonal().setRandom();
+    A.toSparse(S, tr, true);
+    FAST_CHECK_EQ(S.nonZeros(), nnz);
+    D = tr ? A.toDense().transpose() : A.toDense();
+    FAST_CHECK_UNARY(Eigen::MatrixXd(S) == D);
+  }
+
+  SparseMatrix S = A.toSparse();
+  SparseMatrix T = A.toSparse(true);
+  CHECK_THROWS_AS(A.toSparse(T, false, true), std::runtime_error);
+  M.setBlock(2, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 4), true));
+  CHECK_THROWS_AS(A.toSparse(S, false, true), std::runtime_error);
+
+  // The last column gains elements: detected before any value is written
+  M.setBlock(2, 1, std::make_shared<ZeroMatrix>(3, 4));
+  S = A.toSparse();
+  const SparseMatrix S0 = S;
+  M.setBlock(2, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+  CHECK_THROWS_AS(A.toSparse(S, false, true), std::runtime_error);
+  FAST_CHECK_UNARY(Eigen::MatrixXd(S) == Eigen::MatrixXd(S0));
+}
+
+TEST_CASE("Incremental size update")
+{
+  auto N = std::make_shared<DiagonalBlockMatrix>(2);
+  N->setBlock(0, 0, std::make_shared<IdentityMatrix>(2));
+  N->setBlock(1, 1, std::make_shared<IdentityMatrix>(3));
+  DiagonalBlockMatrix M(2);
+  M.setBlock(0, 0, N);
+  M.setBlock(1, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 4), true));
+  FAST_CHECK_UNARY(M.isSizeDirty());
+  M.updateSize();
+  FAST_CHECK_UNARY(!M.isSizeDirty());
+  FAST_CHECK_UNARY(!N->isSizeDirty());
+  FAST_CHECK_EQ(M.rows(), 9);
+
+  // Changes of the nested matrix are propagated
+  N->resetRowsOfBlock(1);
+  N->resetColsOfBlock(1);
+  N->setBlock(1, 1, std::make_shared<IdentityMatrix>(5));
+  FAST_CHECK_UNARY(N->isSizeDirty());
+  FAST_CHECK_UNARY(M.isSizeDirty());
+  M.resetRowsOfBlock(0);
+  M.resetColsOfBlock(0);
+  M.updateSize();
+  FAST_CHECK_UNARY(!N->isSizeDirty());
+  FAST_CHECK_EQ(N->rows(), 7);
+  FAST_CHECK_EQ(M.rows(), 11);
+  FAST_CHECK_EQ(M.rowOffset(1), 7);
+
+  // A matrix shared by several parents notifies all of them, as long as it is one of their blocks
+  {
+    DiagonalBlockMatrix M2(1);
+    M2.setBlock(0, 0, N);
+    M2.updateSize();
+    N->invalidateSize();
+    FAST_CHECK_UNARY(M.isSizeDirty());
+    FAST_CHECK_UNARY(M2.isSizeDirty());
+    M.updateSize();
+    FAST_CHECK_UNARY(!N->isSizeDirty());
+    FAST_CHECK_UNARY(M2.isSizeDirty());
+    M2.updateSize();
+  }
+  M.setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(7, 7), true));
+  M.updateSize();
+  N->invalidateSize();
+  FAST_CHECK_UNARY(!M.isSizeDirty());
+  N->updateSize();
+
+  // Leaves resized through autoResize notify their parents
+  {
+    auto I = std::make_shared<IdentityMatrix>(2);
+    auto P = std::make_shared<DiagonalBlockMatrix>(1);
+    P->setBlock(0, 0, I);
+    DiagonalBlockMatrix Q(1);
+    Q.setBlock(0, 0, P);
+    Q.updateSize();
+    FAST_CHECK_EQ(Q.rows(), 2);
+    I->autoResize(2, 2);
+    FAST_CHECK_UNARY(!Q.isSizeDirty());
+    I->autoResize(4, 4);
+    FAST_CHECK_UNARY(P->isSizeDirty());
+    FAST_CHECK_UNARY(Q.isSizeDirty());
+    P->resetRowsOfBlock(0);
+    P->resetColsOfBlock(0);
+    Q.resetRowsOfBlock(0);
+    Q.resetColsOfBlock(0);
+    Q.updateSize();
+    FAST_CHECK_EQ(Q.rows(), 4);
+  }
+
+  // Invalid sizes are still reported, and the matrix is kept dirty
+  M.resetRowsOfBlock(0);
+  M.setRowsOfBlock(0, 3);
+  CHECK_THROWS_AS(M.updateSize(), std::runtime_error);
+  FAST_CHECK_UNARY(M.isSizeDirty());
+}
+
+TEST_CASE("Coefficient access with empty blocks")
+{
+  DenseBlockMatrix M(3, 3);
+  Eigen::MatrixXd A = Eigen::MatrixXd::Random(2, 3);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(2, 2);
+  M.setBlock(0, 0, std::make_shared<DenseMatrix>(A, true));
+  M.setBlock(0, 1, std::make_shared<ZeroMatrix>(2, 0));
+  M.setBlock(0, 2, std::make_shared<DenseMatrix>(B, true));
+  M.setBlock(1, 0, std::make_shared<ZeroMatrix>(0, 3));
+  M.setBlock(1, 1, std::make_shared<ZeroMatrix>(0, 0));
+  M.setBlock(1, 2, std::make_shared<ZeroMatrix>(0, 2));
+  M.setBlock(2, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+  M.setBlock(2, 1, std::make_shared<ZeroMatrix>(2, 0));
+  M.setBlock(2, 2, std::make_shared<IdentityMatrix>(2));
+  M.updateSize();
+
+  FAST_CHECK_EQ(M.rowOffset(1), 2);
+  FAST_CHECK_EQ(M.rowOffset(2), 2);
+  FAST_CHECK_EQ(M.colOffset(2), 3);
+  Eigen::MatrixXd D = static_cast<const MatrixBase &>(M).toDense();
+  for(int r = 0; r < 4; ++r)
+  {
+    for(int c = 0; c < 5; ++c)
+      FAST_CHECK_EQ(M(r, c), D(r, c));
+  }
+  FAST_CHECK_EQ(M(1, 4), B(1, 1));
+  FAST_CHECK_EQ(M(3, 3), 0.);
+  FAST_CHECK_EQ(M(3, 4), 1.);
+}
+
+TEST_CASE("Non-stored blocks")
+{
+  BandBlockMatrix M(6, 6, 1, 1);
+  for(int i = 0; i < 6; ++i)
+  {
+    M.setBlock(i, i, std::make_shared<IdentityMatrix>(i % 2 ? 2 : 3));
+    if(i < 5)
+      M.setBlock(i + 1, i, std::make_shared<ZeroMatrix>((i + 1) % 2 ? 2 : 3, i % 2 ? 2 : 3));
+  }
+  M.updateSize();
+
+  const BlockMatrix & cM = M;
+  auto Z = cM.block(4, 0);
+  FAST_CHECK_EQ(Z.rows(), 3);
+  FAST_CHECK_EQ(Z.cols(), 3);
+  FAST_CHECK_EQ(internal::simpleType(*Z.matrix), internal::SimpleType::Zero);
+  FAST_CHECK_UNARY(!Z.matrix->isAutoResizable());
+  // Shared between the blocks of the same size
+  FAST_CHECK_EQ(Z.matrix, cM.block(0, 2).matrix);
+  FAST_CHECK_EQ(Z.matrix, M.block(2, 4).matrix);
+  FAST_CHECK_NE(Z.matrix, cM.block(5, 0).matrix);
+  FAST_CHECK_GT(Z.matrix.use_count(), 1);
+  FAST_CHECK_EQ(cM.block(5, 0).rows(), 2);
+  FAST_CHECK_EQ(cM.block(5, 0).cols(), 3);
+
+  // Sizes changed, but not updated yet: the zero block is created on the fly
+  M.resetRowsOfBlock(5);
+  M.setRowsOfBlock(5, 4);
+  auto Z2 = cM.block(5, 0);
+  FAST_CHECK_EQ(Z2.rows(), 4);
+  FAST_CHECK_EQ(Z2.matrix.use_count(), 1);
+  FAST_CHECK_EQ(Z.rows(), 3);
+
+  // The returned zero block shares the ownership, and outlives the block matrix
+  MatrixConstPtr Z3;
+  {
+    DiagonalBlockMatrix D(3);
+    for(int i = 0; i < 3; ++i)
+      D.setBlock(i, i, std::make_shared<IdentityMatrix>(2));
+    D.updateSize();
+    Z3 = static_cast<const BlockMatrix &>(D).block(1, 0).matrix;
+  }
+  FAST_CHECK_EQ(Z3.use_count(), 1);
+  FAST_CHECK_EQ(Z3->rows(), 2);
+  FAST_CHECK_EQ(Z3->cols(), 2);
+  FAST_CHECK_EQ(internal::simpleType(*Z3), internal::SimpleType::Zero);
+}
+
+TEST_CASE("Block views")
+{
+  static_assert(std::is_trivially_copyable_v<BlockView>);
+  BandBlockMatrix M(4, 4, 1, 1, internal::SymmetricStorage::Lower);
+  const int sizes[] = {2, 3, 1, 2};
+  for(int i = 0; i < 4; ++i)
+  {
+    M.setBlock(i, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i], sizes[i]), true));
+    if(i == 1)
+      M.setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i], sizes[i + 1]), true), true);
+    else if(i < 3)
+      M.setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i + 1], sizes[i]), true));
+  }
+  M.updateSize();
+  Eigen::MatrixXd D = static_cast<const MatrixBase &>(M).toDense();
+
+  for(int r = 0; r < 4; ++r)
+  {
+    for(int c = 0; c < 4; ++c)
+    {
+      const BlockView V = M.blockView(r, c);
+      const auto B = static_cast<const BlockMatrix &>(M).block(r, c);
+      FAST_CHECK_EQ(V.isZero(), std::abs(r - c) > 1);
+      if(!V.isZero())
+      {
+        FAST_CHECK_EQ(V.matrix, B.matrix.get());
+        FAST_CHECK_EQ(V.trans, B.trans);
+      }
+      FAST_CHECK_EQ(V.rows(), sizes[r]);
+      FAST_CHECK_EQ(V.cols(), sizes[c]);
+      FAST_CHECK_EQ(V.rowOffset, M.rowOffset(r));
+      FAST_CHECK_EQ(V.colOffset, M.colOffset(c));
+
+      Eigen::MatrixXd Dv(sizes[r], sizes[c]);
+      V.toDense(Dv, false);
+      FAST_CHECK_UNARY(Dv == D.block(V.rowOffset, V.colOffset, V.rows(), V.cols()));
+      FAST_CHECK_EQ(V(sizes[r] - 1, 0), D(V.rowOffset + sizes[r] - 1, V.colOffset));
+      Eigen::MatrixXd Dt(sizes[c], sizes[r]);
+      V.transposed().toDense(Dt, false);
+      FAST_CHECK_UNARY(Dt == Dv.transpose());
+
+      Eigen::VectorXd x = Eigen::VectorXd::Random(sizes[r]);
+      Eigen::VectorXd y = Eigen::VectorXd::Random(sizes[c]);
+      Eigen::VectorXd y0 = y;
+      V.multiply(x, y, 2, 3, true);
+      FAST_CHECK_UNARY(y.isApprox(2 * Dv.transpose() * x + 3 * y0));
+    }
+  }
+}
+
+TEST_CASE("Arena storage")
+{
+  SUBCASE("Allocation")
+  {
+    TriDiagonalBlockMatrix M(3);
+    for(int i = 0; i < 3; ++i)
+    {
+      M.setRowsOfBlock(i, 2 + i);
+      M.setColsOfBlock(i, 2 + i);
+    }
+    M.allocateArena([](int r, int c) { return r == c; });
+    FAST_CHECK_UNARY(M.hasArena());
+    FAST_CHECK_EQ(M.rows(), 9);
+    FAST_CHECK_UNARY(static_cast<const MatrixBase &>(M).toDense().isZero());
+
+    // Fill the blocks through their views
+    Eigen::MatrixXd D = Eigen::MatrixXd::Zero(9, 9);
+    for(int r = 0; r < 3; ++r)
+    {
+      for(int c = std::max(0, r - 1); c < std::min(3, r + 2); ++c)
+      {
+        auto B = M.block(r, c).matrix;
+        auto Db = D.block(M.rowOffset(r), M.colOffset(c), M.rowsOfBlock(r), M.colsOfBlock(c));
+        if(r == c)
+        {
+          auto d = std::dynamic_pointer_cast<DiagonalMatrix>(B);
+          REQUIRE(d);
+          d->diagonal().setRandom();
+          Db.diagonal() = d->diagonal();
+        }
+        else
+        {
+          auto m = std::dynamic_pointer_cast<DenseMatrix>(B);
+          REQUIRE(m);
+          m->matrix().setRandom();
+          Db = m->matrix();
+        }
+      }
+    }
+    FAST_CHECK_UNARY(static_cast<const MatrixBase &>(M).toDense().isApprox(D));
+
+    // Blocks are contiguous, in the storage order (column by column of the band)
+    auto dense = [&](int r, int c) { return static_cast<const DenseMatrix &>(*M.block(r, c).matrix).matrix().data(); };
+    auto diag = [&](int i) { return static_cast<const DiagonalMatrix &>(*M.block(i, i).matrix).diagonal().data(); };
+    FAST_CHECK_LT(diag(0), dense(1, 0));
+    FAST_CHECK_LT(dense(1, 0), dense(0, 1));
+    FAST_CHECK_LT(dense(0, 1), diag(1));
+    FAST_CHECK_LT(diag(1), dense(2, 1));
+    FAST_CHECK_LT(dense(2, 1), dense(1, 2));
+    FAST_CHECK_LT(dense(1, 2), diag(2));
+
+    TriDiagonalBlockMatrix N(2);
+    N.setRowsOfBlock(0, 2);
+    N.setColsOfBlock(0, 3);
+    N.setRowsOfBlock(1, 2);
+    CHECK_THROWS(N.allocateArena());
+    N.setColsOfBlock(1, 2);
+    CHECK_THROWS(N.allocateArena([](int r, int c) { return r == c; }));
+    CHECK_NOTHROW(N.allocateArena());
+  }
+
+  SUBCASE("Compaction")
+  {
+    for(bool upper : {true, false})
+    {
+      TriDiagonalBlockMatrix M(4, true, upper);
+      for(int i = 0; i < 4; ++i)
+      {
+        Eigen::MatrixXd A = Eigen::MatrixXd::Random(3, 3);
+        if(i % 2)
+          M.setBlock(i, i, std::make_shared<DenseMatrix>(A + A.transpose(), true));
+        else
+          M.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+        if(i < 3)
+        {
+          if(i == 1)
+            M.setBlock(upper ? i : i + 1, upper ? i + 1 : i, std::make_shared<MultipleOfIdentityMatrix>(3, -2.));
+          else if(upper)
+            M.setBlock(i, i + 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true), true);
+          else
+            M.setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+        }
+      }
+      M.updateSize();
+      Eigen::MatrixXd D = static_cast<const MatrixBase &>(M).toDense();
+      auto I = M.block(1, 2).matrix;
+
+      M.compactToArena();
+      FAST_CHECK_UNARY(M.hasArena());
+      FAST_CHECK_UNARY(static_cast<const MatrixBase &>(M).toDense() == D);
+      FAST_CHECK_EQ(M.block(1, 2).matrix, I);
+      FAST_CHECK_UNARY(std::dynamic_pointer_cast<DiagonalMatrix>(M.block(2, 2).matrix));
+
+      // Compacting again is harmless
+      M.compactToArena();
+      FAST_CHECK_UNARY(static_cast<const MatrixBase &>(M).toDense() == D);
+    }
+  }
+}
+
+TEST_CASE("Parallel conversion to dense")
+{
+  auto check = [](const BlockMatrix & M) {
+    Eigen::MatrixXd D(M.rows(), M.cols());
+    Eigen::MatrixXd Dt(M.cols(), M.rows());
+    for(int i = 0; i < M.rows(); ++i)
+    {
+      for(int j = 0; j < M.cols(); ++j)
+        D(i, j) = M(i, j);
+    }
+    for(int threads : {0, 1, 2, 3, 7})
+    {
+      Eigen::MatrixXd P = Eigen::MatrixXd::Constant(M.rows(), M.cols(), 42);
+      M.toDenseParallel(P, false, threads);
+      FAST_CHECK_UNARY(P == D);
+      Eigen::MatrixXd Pt = Eigen::MatrixXd::Constant(M.cols(), M.rows(), 42);
+      M.toDenseParallel(Pt, true, threads);
+      FAST_CHECK_UNARY(Pt == D.transpose());
+    }
+  };
+
+  SUBCASE("Symmetric band")
+  {
+    for(bool upper : {true, false})
+    {
+      BandBlockMatrix M(6, 6, 2, 2, upper ? internal::SymmetricStorage::Upper : internal::SymmetricStorage::Lower);
+      for(int i = 0; i < 6; ++i)
+      {
+        M.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(i % 3 + 1), true));
+        for(int k = 1; k < 3 && i + k < 6; ++k)
+        {
+          auto B = std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(i % 3 + 1, (i + k) % 3 + 1), true);
+          if(upper)
+            M.setBlock(i, i + k, B);
+          else
+            M.setBlock(i + k, i, B, true);
+        }
+      }
+      M.updateSize();
+      check(M);
+    }
+  }
+
+  SUBCASE("Sparse with unset blocks")
+  {
+    SparseBlockMatrix M(4, 3, {{0, 2}, {1, 0}, {1, 1}, {3, 1}, {3, 2}});
+    M.setBlock(0, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+    M.setBlock(1, 0, std::make_shared<IdentityMatrix>(4));
+    M.setBlock(3, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 2), true), true);
+    M.setRowsOfBlock(2, 5);
+    M.setColsOfBlock(1, 1);
+    M.updateSize();
+    check(M);
+  }
+
+  SUBCASE("Exceptions")
+  {
+    // Dense matrix whose conversion to dense fails
+    struct FailingMatrix : public DenseMatrix
+    {
+      using DenseMatrix::DenseMatrix;
+      void toDense(MatrixRef, bool) const override { throw std::runtime_error("Conversion failure"); }
+    };
+
+    // Failure in the calling thread, then in another thread
+    for(int i : {0, 3})
+    {
+      DiagonalBlockMatrix M(4);
+      for(int j = 0; j < 4; ++j)
+      {
+        if(j == i)
+          M.setBlock(j, j, std::make_shared<FailingMatrix>(Eigen::MatrixXd::Random(2, 2), true));
+        else
+          M.setBlock(j, j, std::make_shared<IdentityMatrix>(2));
+      }
+      M.updateSize();
+      Eigen::MatrixXd D(8, 8);
+      CHECK_THROWS_AS(M.toDenseParallel(D, false, 4), std::runtime_error);
+    }
+  }
+}
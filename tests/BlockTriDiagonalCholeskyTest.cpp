@@ -0,0 +1,197 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BlockTriDiagonalCholesky.h>
+#include <mlsm/SimpleMatrix.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+#include "TestUtils.h"
+
+using namespace mls;
+
+// Check the solution of A X = B against the dense solution
+void checkSolve(const BlockMatrix & A)
+{
+  Eigen::MatrixXd Ad = static_cast<const MatrixBase &>(A).toDense();
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(A.rows(), 3);
+  BlockTriDiagonalCholesky chol(A);
+  FAST_CHECK_EQ(chol.size(), A.rows());
+  Eigen::MatrixXd X = chol.solve(B);
+  FAST_CHECK_UNARY((Ad * X).isApprox(B));
+}
+
+TEST_CASE("Dense blocks")
+{
+  const int sizes[] = {3, 2, 4, 4, 1};
+  for(auto sym : {internal::SymmetricStorage::None, internal::SymmetricStorage::Lower,
+                  internal::SymmetricStorage::Upper})
+  {
+    BandBlockMatrix A(5, 5, 1, 1, sym);
+    for(int i = 0; i < 5; ++i)
+    {
+      A.setBlock(i, i, spd(sizes[i]));
+      if(i < 4)
+      {
+        Eigen::MatrixXd B = Eigen::MatrixXd::Random(sizes[i + 1], sizes[i]);
+        if(sym != internal::SymmetricStorage::Upper)
+          A.setBlock(i + 1, i, std::make_shared<DenseMatrix>(B, true));
+        if(sym != internal::SymmetricStorage::Lower)
+          A.setBlock(i, i + 1, std::make_shared<DenseMatrix>(B, true), true);
+      }
+    }
+    A.updateSize();
+    checkSolve(A);
+  }
+}
+
+TEST_CASE("Structured blocks")
+{
+  SUBCASE("Diagonal chain")
+  {
+    // All Schur complements stay diagonal
+    TriDiagonalBlockMatrix A(4, true, false);
+    for(int i = 0; i < 4; ++i)
+    {
+      if(i % 2)
+        A.setBlock(i, i, std::make_shared<MultipleOfIdentityMatrix>(3, 5.));
+      else
+        A.setBlock(i, i, std::make_shared<DiagonalMatrix>(Eigen::Vector3d(4, 5, 6), true));
+      if(i < 3)
+      {
+        if(i == 1)
+          A.setBlock(i + 1, i, std::make_shared<ZeroMatrix>(3, 3));
+        else if(i == 2)
+          A.setBlock(i + 1, i, std::make_shared<IdentityMatrix>(3));
+        else
+          A.setBlock(i + 1, i, std::make_shared<DiagonalMatrix>(Eigen::Vector3d(1, -1, 2), true));
+      }
+    }
+    A.updateSize();
+    checkSolve(A);
+  }
+
+  SUBCASE("Multiple of identity chain")
+  {
+    // Factors stay multiples of the identity, then become diagonal and dense
+    TriDiagonalBlockMatrix A(5, true, false);
+    A.setBlock(0, 0, std::make_shared<MultipleOfIdentityMatrix>(2, 4.));
+    A.setBlock(1, 0, std::make_shared<IdentityMatrix>(2));
+    A.setBlock(1, 1, std::make_shared<MultipleOfIdentityMatrix>(2, 3.));
+    A.setBlock(2, 1, std::make_shared<MultipleOfIdentityMatrix>(2, -1.));
+    A.setBlock(2, 2, std::make_shared<DiagonalMatrix>(Eigen::Vector2d(4, 5), true));
+    A.setBlock(3, 2, std::make_shared<IdentityMatrix>(2));
+    A.setBlock(3, 3, std::make_shared<MultipleOfIdentityMatrix>(2, 6.));
+    A.setBlock(4, 3, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 2), true));
+    A.setBlock(4, 4, spd(3));
+    A.updateSize();
+    checkSolve(A);
+  }
+
+  SUBCASE("Mixed and nested blocks")
+  {
+    auto T = std::make_shared<DiagonalBlockMatrix>(2);
+    T->setBlock(0, 0, spd(2));
+    T->setBlock(1, 1, std::make_shared<MultipleOfIdentityMatrix>(2, 10.));
+    TriDiagonalBlockMatrix A(4, true);
+    A.setBlock(0, 0, std::make_shared<IdentityMatrix>(4));
+    A.setBlock(0, 1, std::make_shared<DenseMatrix>(0.1 * Eigen::MatrixXd::Random(4, 4), true));
+    A.setBlock(1, 1, T);
+    A.setBlock(1, 2, std::make_shared<MultipleOfIdentityMatrix>(4, -1.));
+    A.setBlock(2, 2, std::make_shared<DiagonalMatrix>(Eigen::Vector4d(3, 4, 5, 6), true));
+    A.setBlock(2, 3, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 2), true));
+    A.setBlock(3, 3, spd(2));
+    A.updateSize();
+    checkSolve(A);
+  }
+}
+
+TEST_CASE("Errors")
+{
+  TriDiagonalBlockMatrix A(2, true);
+  A.setBlock(0, 0, std::make_shared<IdentityMatrix>(2));
+  A.setBlock(0, 1, std::make_shared<MultipleOfIdentityMatrix>(2, 2.));
+  A.setBlock(1, 1, std::make_shared<IdentityMatrix>(2));
+  A.updateSize();
+  CHECK_THROWS(BlockTriDiagonalCholesky{A});
+
+  DenseBlockMatrix D(2, 2);
+  CHECK_THROWS(BlockTriDiagonalCholesky{D});
+}
+
+TEST_CASE("Symbolic and numeric phases")
+{
+  // Same pattern with different values
+  auto build = [](double s) {
+    auto A = std::make_shared<TriDiagonalBlockMatrix>(4, true, false);
+    A->setBlock(0, 0, std::make_shared<MultipleOfIdentityMatrix>(2, 3. * s));
+    A->setBlock(1, 0, std::make_shared<DiagonalMatrix>(Eigen::Vector2d(s, -s), true));
+    A->setBlock(1, 1, std::make_shared<DiagonalMatrix>(Eigen::Vector2d(4, 5 * s), true));
+    A->setBlock(2, 1, std::make_shared<DenseMatrix>(s * Eigen::MatrixXd::Random(3, 2), true));
+    A->setBlock(2, 2, spd(3));
+    A->setBlock(3, 3, std::make_shared<IdentityMatrix>(1));
+    A->updateSize();
+    return A;
+  };
+
+  BlockTriDiagonalCholesky chol;
+  auto A0 = build(1);
+  chol.analyzePattern(*A0);
+  FAST_CHECK_EQ(chol.size(), 8);
+  for(double s : {1., 2., 0.5})
+  {
+    auto A = build(s);
+    chol.factorize(*A);
+    Eigen::MatrixXd B = Eigen::MatrixXd::Random(8, 2);
+    Eigen::MatrixXd X = chol.solve(B);
+    FAST_CHECK_UNARY((static_cast<const MatrixBase &>(*A).toDense() * X).isApprox(B));
+  }
+
+  TriDiagonalBlockMatrix other(3, true, false);
+  for(int i = 0; i < 3; ++i)
+    other.setBlock(i, i, std::make_shared<IdentityMatrix>(2));
+  other.updateSize();
+  CHECK_THROWS(chol.factorize(other));
+
+  // Same sizes, but blocks whose types differ from the analyzed ones
+  auto A = build(1);
+  A->setBlock(1, 1, spd(2));
+  CHECK_THROWS_AS(chol.factorize(*A), std::runtime_error);
+  A = build(1);
+  A->setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 2), true));
+  CHECK_THROWS_AS(chol.factorize(*A), std::runtime_error);
+  A = build(1);
+  A->setBlock(3, 2, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(1, 3), true));
+  CHECK_THROWS_AS(chol.factorize(*A), std::runtime_error);
+}
+
+TEST_CASE("Single and mixed precision")
+{
+  const int sizes[] = {3, 2, 4, 4, 1};
+  TriDiagonalBlockMatrix A(5, true, false);
+  for(int i = 0; i < 5; ++i)
+  {
+    if(i == 1)
+      A.setBlock(i, i, std::make_shared<MultipleOfIdentityMatrix>(2, 5.));
+    else
+      A.setBlock(i, i, spd(sizes[i]));
+    if(i < 4)
+      A.setBlock(i + 1, i, std::make_shared<FloatDenseMatrix>(Eigen::MatrixXd::Random(sizes[i + 1], sizes[i])));
+  }
+  A.updateSize();
+  Eigen::MatrixXd Ad = static_cast<const MatrixBase &>(A).toDense();
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(A.rows(), 3);
+
+  BlockTriDiagonalCholeskyF chol(A);
+  Eigen::MatrixXf Xf = chol.solve(B.cast<float>());
+  FAST_CHECK_UNARY((Ad * Xf.cast<double>()).isApprox(B, 1e-4));
+
+  MixedPrecisionBlockTriDiagonalSolver solver(A);
+  FAST_CHECK_EQ(solver.size(), A.rows());
+  Eigen::MatrixXd X = B;
+  int it = solver.solveInPlace(A, X);
+  FAST_CHECK_GT(it, 0);
+  FAST_CHECK_LT(it, 10);
+  FAST_CHECK_UNARY((Ad * X).isApprox(B, 1e-12));
+}
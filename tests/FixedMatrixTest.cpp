@@ -0,0 +1,113 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/BlockMatrix.h>
+#include <mlsm/FixedMatrix.h>
+#include <mlsm/internal/SimpleAccumulator.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+using namespace mls;
+
+TEST_CASE("Fixed dense matrix")
+{
+  Eigen::Matrix<double, 3, 4> A = Eigen::Matrix<double, 3, 4>::Random();
+  MatrixPtr M = std::make_shared<FixedDenseMatrix<3, 4>>(A);
+  FAST_CHECK_EQ(M->rows(), 3);
+  FAST_CHECK_EQ(M->cols(), 4);
+  FAST_CHECK_UNARY(M->isSimple());
+  FAST_CHECK_EQ(M->shape().type(), internal::ShapeType::Dense);
+  FAST_CHECK_EQ(internal::simpleType(*M), internal::SimpleType::Dense);
+  FAST_CHECK_UNARY(internal::denseData(*M) == A);
+  FAST_CHECK_EQ((*M)(2, 1), A(2, 1));
+
+  Eigen::MatrixXd D(3, 4);
+  M->toDense(D, false);
+  FAST_CHECK_UNARY(D == A);
+  Eigen::MatrixXd Dt(4, 3);
+  M->toDense(Dt, true);
+  FAST_CHECK_UNARY(Dt == A.transpose());
+
+  Eigen::VectorXd x = Eigen::VectorXd::Random(4);
+  Eigen::VectorXd y = Eigen::VectorXd::Random(3);
+  Eigen::VectorXd y0 = y;
+  M->multiply(x, y, 2, 3, false);
+  FAST_CHECK_UNARY(y.isApprox(2 * A * x + 3 * y0));
+  Eigen::VectorXd z = M->multiply(y, true);
+  FAST_CHECK_UNARY(z.isApprox(A.transpose() * y));
+
+  // Row vector, stored row-major by Eigen
+  Eigen::RowVector3d r(1, 2, 3);
+  FixedDenseMatrix<1, 3> R(r);
+  FAST_CHECK_UNARY(R.matrix() == r);
+  FAST_CHECK_UNARY(static_cast<const MatrixBase &>(R).toDense() == r);
+}
+
+TEST_CASE("Fixed blocks in BlockMatrix")
+{
+  using Block = FixedDenseMatrix<3, 3>;
+  TriDiagonalBlockMatrix M(4);
+  std::vector<std::shared_ptr<Block>> blocks;
+  for(int i = 0; i < 4; ++i)
+  {
+    for(int j = std::max(0, i - 1); j < std::min(4, i + 2); ++j)
+    {
+      blocks.push_back(std::make_shared<Block>(Eigen::Matrix3d::Random()));
+      M.setBlock(i, j, blocks.back());
+    }
+  }
+  M.updateSize();
+  const MatrixBase & B = M;
+  Eigen::MatrixXd D = B.toDense();
+
+  Eigen::VectorXd x = Eigen::VectorXd::Random(12);
+  FAST_CHECK_UNARY(B.multiply(x).isApprox(D * x));
+  FAST_CHECK_UNARY(B.multiply(x, true).isApprox(D.transpose() * x));
+
+  for(bool tl : {false, true})
+  {
+    for(bool tr : {false, true})
+    {
+      auto P = mult(M, M, tl, tr);
+      Eigen::MatrixXd expected = (tl ? D.transpose() : D) * (tr ? D.transpose() : D);
+      FAST_CHECK_UNARY(static_cast<const MatrixBase &>(*P).toDense().isApprox(expected));
+    }
+  }
+
+  // Values updated in place are seen by the block matrix
+  blocks[0]->fixed().setIdentity();
+  FAST_CHECK_EQ(M(1, 1), 1.);
+  FAST_CHECK_EQ(M(1, 2), 0.);
+
+  // Fixed blocks are not moved to the arena
+  M.compactToArena();
+  FAST_CHECK_UNARY(M.block(0, 0).matrix == blocks[0]);
+}
+
+TEST_CASE("Products with fixed and dynamic blocks")
+{
+  Eigen::MatrixXd A = Eigen::MatrixXd::Random(3, 2);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(2, 5);
+  Eigen::MatrixXd X = Eigen::MatrixXd::Random(4, 3);
+  auto FA = std::make_shared<FixedDenseMatrix<3, 2>>(A);
+  auto DB = std::make_shared<DenseMatrix>(B, true);
+  auto DX = std::make_shared<DenseMatrix>(X, true);
+
+  auto check = [](const constTransposableMatrix & L, const constTransposableMatrix & R,
+                  const Eigen::MatrixXd & expected) {
+    internal::SimpleAccumulator acc(L.rows(), R.cols());
+    acc.addProduct(L, R, 2);
+    acc.addProduct(L, R, -1);
+    FAST_CHECK_EQ(acc.type(), internal::SimpleType::Dense);
+    FAST_CHECK_UNARY(acc.toMatrix()->toDense().isApprox(expected));
+  };
+
+  // op(M) for the product kernels
+  auto op = [](MatrixConstPtr M, bool transpose = false) { return constTransposableMatrix(M, transpose); };
+  check(op(FA), op(DB), A * B);                                         // Fixed on the left
+  check(op(DB, true), op(FA, true), B.transpose() * A.transpose());     // Generic product
+  check(op(DX), op(FA), X * A);                                         // Fixed on the right
+  check(op(FA, true), op(DX, true), A.transpose() * X.transpose());     // Transposed fixed on the left
+  check(op(FA), op(FA, true), A * A.transpose());                       // Fixed on both sides
+}
@@ -0,0 +1,137 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/RiccatiRecursion.h>
+#include <mlsm/SimpleMatrix.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+#include "TestUtils.h"
+
+using namespace mls;
+
+// Dynamics for stages with state sizes nx and control sizes nu
+std::shared_ptr<BandBlockMatrix> dynamics(const std::vector<int> & nx, const std::vector<int> & nu)
+{
+  const int n = static_cast<int>(nx.size());
+  auto G = std::make_shared<BandBlockMatrix>(n, n, 1, 0);
+  for(int k = 0; k < n; ++k)
+  {
+    Eigen::MatrixXd E = Eigen::MatrixXd::Zero(nx[k], nx[k] + nu[k]);
+    E.leftCols(nx[k]) = -Eigen::MatrixXd::Identity(nx[k], nx[k]);
+    G->setBlock(k, k, std::make_shared<DenseMatrix>(E, true));
+    if(k < n - 1)
+      G->setBlock(k + 1, k, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(nx[k + 1], nx[k] + nu[k]), true));
+  }
+  G->updateSize();
+  return G;
+}
+
+// Check the solution of the KKT system against the dense solution
+void checkSolve(const RiccatiRecursion & riccati, const BlockMatrix & H, const BlockMatrix & G)
+{
+  const int nz = H.rows();
+  const int nl = G.rows();
+  Eigen::MatrixXd K = Eigen::MatrixXd::Zero(nz + nl, nz + nl);
+  K.topLeftCorner(nz, nz) = static_cast<const MatrixBase &>(H).toDense();
+  K.bottomLeftCorner(nl, nz) = static_cast<const MatrixBase &>(G).toDense();
+  K.topRightCorner(nz, nl) = K.bottomLeftCorner(nl, nz).transpose();
+
+  FAST_CHECK_EQ(riccati.size(), nz + nl);
+  Eigen::MatrixXd B = Eigen::MatrixXd::Random(nz + nl, 3);
+  Eigen::MatrixXd X = riccati.solve(B);
+  FAST_CHECK_UNARY((K * X).isApprox(B));
+}
+
+TEST_CASE("Dense stages")
+{
+  const std::vector<int> nx = {3, 3, 2, 4, 3};
+  const std::vector<int> nu = {2, 1, 2, 2, 0};
+  DiagonalBlockMatrix H(5);
+  for(int k = 0; k < 5; ++k)
+    H.setBlock(k, k, spd(nx[k] + nu[k]));
+  H.updateSize();
+  auto G = dynamics(nx, nu);
+
+  RiccatiRecursion riccati(H, *G);
+  FAST_CHECK_EQ(riccati.stages(), 5);
+  checkSolve(riccati, H, *G);
+
+  // New values with the same structure
+  for(int k = 0; k < 5; ++k)
+    H.setBlock(k, k, spd(nx[k] + nu[k]));
+  riccati.factorize(H, *G);
+  checkSolve(riccati, H, *G);
+}
+
+TEST_CASE("Structured stages")
+{
+  // Tridiagonal Hessian with zero off-diagonal blocks, and structured stage Hessians
+  const std::vector<int> nx = {2, 2, 2, 2};
+  const std::vector<int> nu = {2, 2, 2, 2};
+  TriDiagonalBlockMatrix H(4, true, false);
+  for(int k = 0; k < 4; ++k)
+  {
+    if(k % 2)
+      H.setBlock(k, k, std::make_shared<DiagonalMatrix>(Eigen::Vector4d(1, 2, 3, 4), true));
+    else
+      H.setBlock(k, k, std::make_shared<IdentityMatrix>(4));
+    if(k < 3)
+      H.setBlock(k + 1, k, std::make_shared<ZeroMatrix>(4, 4));
+  }
+  H.updateSize();
+  auto G = dynamics(nx, nu);
+
+  RiccatiRecursion riccati(H, *G);
+  checkSolve(riccati, H, *G);
+}
+
+TEST_CASE("Errors")
+{
+  const std::vector<int> nx = {2, 2, 2};
+  const std::vector<int> nu = {1, 1, 1};
+  auto G = dynamics(nx, nu);
+
+  // Coupling between stages in the Hessian
+  TriDiagonalBlockMatrix H(3);
+  for(int k = 0; k < 3; ++k)
+    H.setBlock(k, k, spd(3));
+  H.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 3), true));
+  H.updateSize();
+  CHECK_THROWS_AS(RiccatiRecursion(H, *G), std::runtime_error);
+
+  // Wrong dynamics structure
+  TriDiagonalBlockMatrix G2(3);
+  for(int k = 0; k < 3; ++k)
+    G2.setBlock(k, k, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 3), true));
+  G2.updateSize();
+  DiagonalBlockMatrix H2(3);
+  for(int k = 0; k < 3; ++k)
+    H2.setBlock(k, k, spd(3));
+  H2.updateSize();
+  CHECK_THROWS_AS(RiccatiRecursion(H2, G2), std::runtime_error);
+
+  // Controls with a negative definite Hessian
+  H2.setBlock(2, 2, std::make_shared<MultipleOfIdentityMatrix>(3, -1.));
+  CHECK_THROWS_AS(RiccatiRecursion(H2, *G), std::runtime_error);
+
+  // Same total sizes as the analyzed ones, but different stage sizes
+  const std::vector<int> nu2 = {2, 1, 1};
+  const std::vector<int> nu3 = {1, 2, 1};
+  auto G3 = dynamics(nx, nu2);
+  auto G4 = dynamics(nx, nu3);
+  DiagonalBlockMatrix H3(3);
+  DiagonalBlockMatrix H4(3);
+  for(int k = 0; k < 3; ++k)
+  {
+    H3.setBlock(k, k, spd(nx[k] + nu2[k]));
+    H4.setBlock(k, k, spd(nx[k] + nu3[k]));
+  }
+  H3.updateSize();
+  H4.updateSize();
+  RiccatiRecursion riccati(H3, *G3);
+  CHECK_THROWS_AS(riccati.factorize(H4, *G4), std::runtime_error);
+  riccati.factorize(H3, *G3);
+  checkSolve(riccati, H3, *G3);
+}
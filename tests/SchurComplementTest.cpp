@@ -0,0 +1,169 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/SchurComplement.h>
+#include <mlsm/SimpleMatrix.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+#include "TestUtils.h"
+
+using namespace mls;
+
+// Check S and the solution of K X = R against their dense counterparts
+void checkSchur(const BlockMatrix & K, internal::SimpleType expectedType, bool positiveDefinite = false)
+{
+  const int n1 = K.rowsOfBlock(0);
+  const int n2 = K.rowsOfBlock(1);
+  Eigen::MatrixXd Kd = static_cast<const MatrixBase &>(K).toDense();
+  Eigen::MatrixXd A = Kd.topLeftCorner(n1, n1);
+  Eigen::MatrixXd Sd =
+      Kd.bottomRightCorner(n2, n2) - Kd.bottomLeftCorner(n2, n1) * A.lu().solve(Kd.topRightCorner(n1, n2));
+
+  SchurComplement schur(K, positiveDefinite);
+  FAST_CHECK_EQ(schur.size(), n2);
+  FAST_CHECK_EQ(internal::simpleType(*schur.matrix()), expectedType);
+  FAST_CHECK_UNARY(schur.matrix()->toDense().isApprox(Sd));
+
+  Eigen::MatrixXd R = Eigen::MatrixXd::Random(n1 + n2, 3);
+  Eigen::MatrixXd X = schur.solve(K, R);
+  FAST_CHECK_UNARY((Kd * X).isApprox(R));
+}
+
+TEST_CASE("Diagonal blocks")
+{
+  DenseBlockMatrix K(2, 2);
+  K.setBlock(0, 0, std::make_shared<DiagonalMatrix>((Eigen::VectorXd::Random(4).array() + 2).matrix(), true));
+  K.setBlock(0, 1, std::make_shared<MultipleOfIdentityMatrix>(4, 3.));
+  K.setBlock(1, 0, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(4), true));
+  K.setBlock(1, 1, std::make_shared<IdentityMatrix>(4));
+  K.updateSize();
+  checkSchur(K, internal::SimpleType::Diagonal);
+
+  // Without coupling, S is D
+  DenseBlockMatrix K2(2, 2);
+  K2.setBlock(0, 0, std::make_shared<MultipleOfIdentityMatrix>(3, 2.));
+  K2.setBlock(1, 1, std::make_shared<MultipleOfIdentityMatrix>(2, -1.));
+  K2.updateSize();
+  checkSchur(K2, internal::SimpleType::MultipleOfIdentity);
+}
+
+TEST_CASE("Structured (1,1) block")
+{
+  SUBCASE("Block tridiagonal")
+  {
+    // KKT matrix with a zero (2,2) block and C = B^T
+    const int sizes[] = {3, 2, 4};
+    auto H = std::make_shared<TriDiagonalBlockMatrix>(3, true, false);
+    for(int i = 0; i < 3; ++i)
+    {
+      H->setBlock(i, i, spd(sizes[i]));
+      if(i < 2)
+        H->setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i + 1], sizes[i]), true));
+    }
+    H->updateSize();
+    auto B = std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(9, 2), true);
+    SparseBlockMatrix K(2, 2, {{0, 0}, {0, 1}, {1, 0}});
+    K.setBlock(0, 0, H);
+    K.setBlock(0, 1, B);
+    K.setBlock(1, 0, B, true);
+    K.updateSize();
+    checkSchur(K, internal::SimpleType::Dense, true);
+    checkSchur(K, internal::SimpleType::Dense, false);
+  }
+
+  SUBCASE("Non-symmetric block tridiagonal")
+  {
+    const int sizes[] = {3, 2, 4};
+    auto A = std::make_shared<TriDiagonalBlockMatrix>(3);
+    for(int i = 0; i < 3; ++i)
+    {
+      Eigen::MatrixXd D = Eigen::MatrixXd::Random(sizes[i], sizes[i]);
+      D.diagonal().array() += 4;
+      A->setBlock(i, i, std::make_shared<DenseMatrix>(D, true));
+      if(i < 2)
+      {
+        A->setBlock(i + 1, i, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i + 1], sizes[i]), true));
+        A->setBlock(i, i + 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(sizes[i], sizes[i + 1]), true));
+      }
+    }
+    A->updateSize();
+    for(bool tr : {false, true})
+    {
+      DenseBlockMatrix K(2, 2);
+      K.setBlock(0, 0, A, tr);
+      K.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(9, 2), true));
+      K.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(2, 9), true));
+      K.setBlock(1, 1, std::make_shared<IdentityMatrix>(2));
+      K.updateSize();
+      checkSchur(K, internal::SimpleType::Dense);
+    }
+  }
+
+  SUBCASE("Indefinite block diagonal")
+  {
+    Eigen::Matrix2d E;
+    E << 0, 1, 1, 0;
+    auto A = std::make_shared<DiagonalBlockMatrix>(3);
+    for(int i = 0; i < 3; ++i)
+      A->setBlock(i, i, std::make_shared<DenseMatrix>((i + 1) * E, true));
+    A->updateSize();
+    DenseBlockMatrix K(2, 2);
+    K.setBlock(0, 0, A);
+    K.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(6, 3), true));
+    K.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 6), true));
+    K.setBlock(1, 1, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+    K.updateSize();
+    checkSchur(K, internal::SimpleType::Dense);
+    // Wrongly declared positive definite
+    CHECK_THROWS_AS(SchurComplement(K, true), std::runtime_error);
+  }
+
+  SUBCASE("Band")
+  {
+    Eigen::MatrixXd M = Eigen::MatrixXd::Random(6, 6) + 4 * Eigen::MatrixXd::Identity(6, 6);
+    for(bool tr : {false, true})
+    {
+      DenseBlockMatrix K(2, 2);
+      K.setBlock(0, 0, std::make_shared<BandMatrix>(M, 2, 1), tr);
+      K.setBlock(0, 1, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(6, 3), true));
+      K.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(3, 6), true));
+      K.setBlock(1, 1, std::make_shared<DiagonalMatrix>(Eigen::VectorXd::Random(3), true));
+      K.updateSize();
+      checkSchur(K, internal::SimpleType::Dense);
+    }
+  }
+
+  SUBCASE("Dense")
+  {
+    DenseBlockMatrix K(2, 2);
+    K.setBlock(0, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 4), true), true);
+    K.setBlock(0, 1, std::make_shared<IdentityMatrix>(4));
+    K.setBlock(1, 0, std::make_shared<DenseMatrix>(Eigen::MatrixXd::Random(4, 4), true));
+    K.setBlock(1, 1, std::make_shared<ZeroMatrix>(4, 4));
+    K.updateSize();
+    checkSchur(K, internal::SimpleType::Dense);
+  }
+}
+
+TEST_CASE("Errors")
+{
+  DenseBlockMatrix K3(3, 3);
+  for(int i = 0; i < 3; ++i)
+    K3.setBlock(i, i, std::make_shared<IdentityMatrix>(2));
+  K3.updateSize();
+  CHECK_THROWS_AS(SchurComplement{K3}, std::runtime_error);
+
+  DenseBlockMatrix K(2, 2);
+  K.setBlock(0, 0, std::make_shared<DiagonalMatrix>(Eigen::Vector3d(1, 0, 2), true));
+  K.setBlock(1, 1, std::make_shared<IdentityMatrix>(2));
+  K.updateSize();
+  CHECK_THROWS_AS(SchurComplement{K}, std::runtime_error);
+
+  // Singular Schur complement
+  K.setBlock(0, 0, std::make_shared<IdentityMatrix>(3));
+  K.setBlock(1, 1, std::make_shared<ZeroMatrix>(2, 2));
+  K.updateSize();
+  CHECK_THROWS_AS(SchurComplement{K}, std::runtime_error);
+}
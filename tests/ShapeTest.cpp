@@ -193,6 +193,47 @@ TEST_CASE("Dense shape")
   FAST_CHECK_EQ(s->cols(), 5);
 }
 
+TEST_CASE("Sparse shape")
+{
+  // | x . x . |
+  // | . . . . |
+  // | x x . x |
+  SparseShape s(3, 4, {{2, 3}, {0, 2}, {2, 0}, {0, 0}, {2, 1}, {0, 2}});
+  FAST_CHECK_EQ(s.type(), ShapeType::Sparse);
+  FAST_CHECK_EQ(s.rows(), 3);
+  FAST_CHECK_EQ(s.cols(), 4);
+  FAST_CHECK_EQ(s.nnz(), 5);
+  FAST_CHECK_EQ(s.rowStart(), std::vector<int>{0, 2, 2, 5});
+  FAST_CHECK_EQ(s.colIndices(), std::vector<int>{0, 2, 0, 1, 3});
+  FAST_CHECK_EQ(s.colStart(), std::vector<int>{0, 2, 3, 4, 5});
+  FAST_CHECK_EQ(s.rowIndices(), std::vector<int>{0, 2, 2, 0, 2});
+  FAST_CHECK_EQ(s.rowNNZ(0), 2);
+  FAST_CHECK_EQ(s.rowNNZ(1), 0);
+  FAST_CHECK_EQ(s.colNNZ(0), 2);
+  FAST_CHECK_EQ(s.colNNZ(3), 1);
+  FAST_CHECK_UNARY(s.isNonZero(2, 1));
+  FAST_CHECK_UNARY_FALSE(s.isNonZero(1, 1));
+  FAST_CHECK_UNARY_FALSE(s.isNonZero(0, 3));
+  for(int k = 0; k < s.nnz(); ++k)
+    FAST_CHECK_EQ(s.csrToCsc(s.cscToCsr(k)), k);
+  FAST_CHECK_EQ(s.csrToCsc(1), 3);
+  FAST_CHECK_EQ(s.csrPosition(2, 1), 3);
+  FAST_CHECK_EQ(s.cscPosition(2, 1), 2);
+  FAST_CHECK_EQ(s.cscPosition(1, 1), -1);
+
+  ShapePtr t = s.transposed();
+  const auto & st = static_cast<const SparseShape &>(*t);
+  FAST_CHECK_EQ(st.rows(), 4);
+  FAST_CHECK_EQ(st.cols(), 3);
+  for(int i = 0; i < 3; ++i)
+  {
+    for(int j = 0; j < 4; ++j)
+      FAST_CHECK_EQ(s.isNonZero(i, j), st.isNonZero(j, i));
+  }
+
+  CHECK_THROWS(SparseShape(3, 4, {{3, 0}}));
+}
+
 TEST_CASE("Copy")
 {
   SUBCASE("Empty")
@@ -224,6 +265,19 @@ TEST_CASE("Copy")
     FAST_CHECK_EQ(c->rows(), 3);
     FAST_CHECK_EQ(c->cols(), 5);
   }
+
+  SUBCASE("Sparse")
+  {
+    ShapePtr s = std::make_unique<SparseShape>(3, 5, std::vector<std::pair<int, int>>{{0, 4}, {2, 1}});
+    ShapePtr c = s->copy();
+    FAST_CHECK_EQ(c->type(), ShapeType::Sparse);
+    FAST_CHECK_EQ(c->rows(), 3);
+    FAST_CHECK_EQ(c->cols(), 5);
+    const auto & sp = static_cast<const SparseShape &>(*c);
+    FAST_CHECK_EQ(sp.nnz(), 2);
+    FAST_CHECK_UNARY(sp.isNonZero(0, 4));
+    FAST_CHECK_UNARY(sp.isNonZero(2, 1));
+  }
 }
 
 TEST_CASE("Transposed")
@@ -316,6 +370,21 @@ TEST_CASE("Addition of ShapeType")
   FAST_CHECK_EQ(dd->type(), ShapeType::Dense);
   FAST_CHECK_EQ(dd->rows(), 5);
   FAST_CHECK_EQ(dd->cols(), 7);
+
+  ShapePtr s = std::make_unique<SparseShape>(5, 7, std::vector<std::pair<int, int>>{{0, 6}, {1, 0}, {4, 4}});
+  auto bs = add(*b, *s);
+  FAST_CHECK_EQ(bs->type(), ShapeType::Sparse);
+  FAST_CHECK_EQ(static_cast<const SparseShape &>(*bs).nnz(), 18);
+  FAST_CHECK_UNARY(static_cast<const SparseShape &>(*bs).isNonZero(0, 6));
+  FAST_CHECK_UNARY(static_cast<const SparseShape &>(*bs).isNonZero(3, 1));
+  FAST_CHECK_EQ(add(ShapeType::Band, ShapeType::Sparse), ShapeType::Sparse);
+
+  auto ss = add(*s, *s);
+  FAST_CHECK_EQ(ss->type(), ShapeType::Sparse);
+  FAST_CHECK_EQ(static_cast<const SparseShape &>(*ss).nnz(), 3);
+
+  auto sd = add(*s, *d);
+  FAST_CHECK_EQ(sd->type(), ShapeType::Dense);
 }
 
 TEST_CASE("Multiplication of ShapeType")
@@ -373,6 +442,45 @@ TEST_CASE("Multiplication of ShapeType")
   FAST_CHECK_EQ(dd->type(), ShapeType::Dense);
   FAST_CHECK_EQ(dd->rows(), 5);
   FAST_CHECK_EQ(dd->cols(), 5);
+
+  // | . x . . . |
+  // | . . . . . |
+  // | . . . . . |
+  // | . . . . . |
+  // | . . . . . |
+  // | x . . . . |
+  // | . . . . x |
+  ShapePtr s2 = std::make_unique<SparseShape>(7, 5, std::vector<std::pair<int, int>>{{0, 1}, {5, 0}, {6, 4}});
+  auto bs = mult(*b1, *s2);
+  FAST_CHECK_EQ(bs->type(), ShapeType::Sparse);
+  FAST_CHECK_EQ(bs->rows(), 5);
+  FAST_CHECK_EQ(bs->cols(), 5);
+  // Row i of b1 has non-zeros on columns i-2 to i+1
+  const auto & bss = static_cast<const SparseShape &>(*bs);
+  FAST_CHECK_EQ(bss.nnz(), 4);
+  FAST_CHECK_UNARY(bss.isNonZero(0, 1));
+  FAST_CHECK_UNARY(bss.isNonZero(1, 1));
+  FAST_CHECK_UNARY(bss.isNonZero(2, 1));
+  FAST_CHECK_UNARY(bss.isNonZero(4, 0));
+  FAST_CHECK_UNARY_FALSE(bss.isNonZero(4, 4));
+  FAST_CHECK_EQ(mult(ShapeType::Band, ShapeType::Sparse), ShapeType::Sparse);
+  FAST_CHECK_EQ(mult(ShapeType::Sparse, ShapeType::Band), ShapeType::Sparse);
+
+  auto t = s2->transposed();
+  auto sb = mult(*t, *b1->transposed());
+  FAST_CHECK_EQ(sb->type(), ShapeType::Sparse);
+  for(int i = 0; i < 5; ++i)
+  {
+    for(int j = 0; j < 5; ++j)
+      FAST_CHECK_EQ(static_cast<const SparseShape &>(*sb).isNonZero(j, i), bss.isNonZero(i, j));
+  }
+
+  auto ss = mult(*t, *s2);
+  FAST_CHECK_EQ(ss->type(), ShapeType::Sparse);
+  FAST_CHECK_EQ(static_cast<const SparseShape &>(*ss).nnz(), 3);
+
+  auto sd = mult(*t, *d2);
+  FAST_CHECK_EQ(sd->type(), ShapeType::Dense);
 }
 
 TEST_CASE("Line iterators")
@@ -475,4 +583,21 @@ TEST_CASE("Line iterators")
       ++i;
     }
   }
+
+  SUBCASE("Sparse shape")
+  {
+    ShapePtr s = std::make_unique<SparseShape>(4, 5, std::vector<std::pair<int, int>>{{1, 4}, {1, 0}, {3, 4}, {1, 2}});
+    FAST_CHECK_EQ(s->row(0).size(), 0);
+    FAST_CHECK_EQ(s->row(1).size(), 3);
+    FAST_CHECK_EQ(s->col(4).size(), 2);
+    FAST_CHECK_UNARY_FALSE(s->row(1).isContiguous());
+
+    std::vector<int> r1, c4;
+    for(auto k : s->row(1))
+      r1.push_back(k);
+    for(auto k : s->col(4))
+      c4.push_back(k);
+    FAST_CHECK_EQ(r1, std::vector<int>{0, 2, 4});
+    FAST_CHECK_EQ(c4, std::vector<int>{1, 3});
+  }
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#include <mlsm/SimpleMatrix.h>
+#include <mlsm/internal/SimpleAccumulator.h>
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
+#include "doctest/doctest.h"
+
+using namespace mls;
+using namespace mls::internal;
+
+TEST_CASE("Type promotion")
+{
+  Eigen::VectorXd d = Eigen::VectorXd::LinSpaced(4, 1, 4);
+  Eigen::MatrixXd M = Eigen::MatrixXd::Random(4, 4);
+  MatrixConstPtr Z = std::make_shared<ZeroMatrix>(4, 4);
+  MatrixConstPtr I = std::make_shared<IdentityMatrix>(4);
+  MatrixConstPtr S = std::make_shared<MultipleOfIdentityMatrix>(4, 3.);
+  MatrixConstPtr D = std::make_shared<DiagonalMatrix>(d, true);
+  MatrixConstPtr A = std::make_shared<DenseMatrix>(M, true);
+
+  SimpleAccumulator acc(4, 4);
+  Eigen::MatrixXd expected = Eigen::MatrixXd::Zero(4, 4);
+  FAST_CHECK_EQ(acc.type(), SimpleType::Zero);
+
+  acc.addProduct(Z, A);
+  acc.add(Z);
+  FAST_CHECK_EQ(acc.type(), SimpleType::Zero);
+
+  acc.addProduct(I, S, 2);
+  expected.diagonal().array() += 6;
+  FAST_CHECK_EQ(acc.type(), SimpleType::MultipleOfIdentity);
+
+  acc.addProduct(D, D, -1);
+  expected.diagonal() -= d.cwiseAbs2();
+  FAST_CHECK_EQ(acc.type(), SimpleType::Diagonal);
+  FAST_CHECK_UNARY(acc.toMatrix()->toDense().isApprox(expected));
+
+  acc.addProduct({A, true}, D);
+  expected += M.transpose() * d.asDiagonal();
+  FAST_CHECK_EQ(acc.type(), SimpleType::Dense);
+
+  acc.addProduct(A, {A, true}, 0.5);
+  expected += 0.5 * M * M.transpose();
+  acc.add(S);
+  expected.diagonal().array() += 3;
+  FAST_CHECK_EQ(acc.type(), SimpleType::Dense);
+  FAST_CHECK_UNARY(acc.toMatrix()->toDense().isApprox(expected));
+}
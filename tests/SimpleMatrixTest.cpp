@@ -165,4 +165,48 @@ TEST_CASE("Dense matrix")
 
     // TODO when feature is implemented: test writing into M
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Single precision dense matrix")
+{
+  Eigen::MatrixXd A = Eigen::MatrixXd::Random(3, 4);
+  MatrixPtr M = std::make_shared<FloatDenseMatrix>(A);
+  FAST_CHECK_EQ(M->rows(), 3);
+  FAST_CHECK_EQ(M->cols(), 4);
+  FAST_CHECK_UNARY(M->isSimple());
+  FAST_CHECK_EQ(M->shape().type(), internal::ShapeType::Dense);
+  FAST_CHECK_EQ((*M)(2, 1), static_cast<double>(static_cast<float>(A(2, 1))));
+  FAST_CHECK_UNARY(M->toDense().isApprox(A, 1e-6));
+  FAST_CHECK_UNARY(M->toDense() == A.cast<float>().cast<double>());
+}
+
+void checkMultiply(const MatrixBase & M)
+{
+  Eigen::MatrixXd D = M.toDense();
+  Eigen::VectorXd x = Eigen::VectorXd::LinSpaced(M.cols(), -1, 2);
+  Eigen::VectorXd xt = Eigen::VectorXd::LinSpaced(M.rows(), 3, -2);
+  Eigen::VectorXd y0 = Eigen::VectorXd::LinSpaced(M.rows(), 0, 1);
+  Eigen::VectorXd yt0 = Eigen::VectorXd::LinSpaced(M.cols(), 1, 0);
+
+  Eigen::VectorXd y = y0;
+  M.multiply(x, y, 2, 0, false);
+  FAST_CHECK_UNARY(y.isApprox(2 * D * x));
+  y = y0;
+  M.multiply(x, y, -1, 3, false);
+  FAST_CHECK_UNARY(y.isApprox(-D * x + 3 * y0));
+  Eigen::VectorXd yt = yt0;
+  M.multiply(xt, yt, 0.5, -1, true);
+  FAST_CHECK_UNARY(yt.isApprox(0.5 * D.transpose() * xt - yt0));
+}
+
+TEST_CASE("Matrix-vector product")
+{
+  Eigen::MatrixXd mat = Eigen::MatrixXd::Random(4, 6);
+  Eigen::VectorXd d = Eigen::VectorXd::LinSpaced(5, -2, 2);
+  checkMultiply(ZeroMatrix(4, 6));
+  checkMultiply(IdentityMatrix(5));
+  checkMultiply(MultipleOfIdentityMatrix(5, -3.));
+  checkMultiply(DiagonalMatrix(d, false));
+  checkMultiply(DenseMatrix(mat, false));
+  checkMultiply(FloatDenseMatrix(mat));
+}
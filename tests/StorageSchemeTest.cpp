@@ -4,6 +4,8 @@
 
 #include <Eigen/Core>
 
+#include <algorithm>
+
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #define DOCTEST_CONFIG_SUPER_FAST_ASSERTS
 #include "doctest/doctest.h"
@@ -134,6 +136,30 @@ void testBandShape(int r, int c, int l, int u, SymmetricStorage sym)
       }
     }
   }
+
+  // Test line iterators against index
+  for(int i = 0; i < r; ++i)
+  {
+    int n = 0;
+    for(const auto & e : storage->row(i))
+    {
+      const auto & res = storage->index(i, e.i);
+      FAST_CHECK_EQ(e, LIV{e.i, res.first, res.second});
+      ++n;
+    }
+    FAST_CHECK_EQ(n, shape.rowNNZ(i));
+  }
+  for(int j = 0; j < c; ++j)
+  {
+    int n = 0;
+    for(const auto & e : storage->col(j))
+    {
+      const auto & res = storage->index(e.i, j);
+      FAST_CHECK_EQ(e, LIV{e.i, res.first, res.second});
+      ++n;
+    }
+    FAST_CHECK_EQ(n, shape.colNNZ(j));
+  }
 }
 
 TEST_CASE("Band storage")
@@ -235,4 +261,75 @@ TEST_CASE("Band storage iterators")
     ++i;
     ++idx;
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Sparse storage")
+{
+  // Symmetric pattern
+  // | x x . x |
+  // | x . . . |
+  // | . . x x |
+  // | x . x . |
+  std::vector<std::pair<int, int>> nz = {{0, 0}, {0, 1}, {1, 0}, {0, 3}, {3, 0}, {2, 2}, {2, 3}, {3, 2}};
+  SparseShape shape(4, 4, nz);
+
+  for(auto sym : {SymmetricStorage::None, SymmetricStorage::Lower, SymmetricStorage::Upper})
+  {
+    std::unique_ptr<StorageScheme> storage = std::make_unique<SparseStorageScheme>(sym);
+    storage->setShape(shape);
+    FAST_CHECK_EQ(storage->size(), sym == SymmetricStorage::None ? 8 : 5);
+
+    // Indices are all different and cover [0, size) for the stored elements, and the transposed
+    // elements refer to the stored ones.
+    std::vector<int> count(storage->size(), 0);
+    for(int i = 0; i < 4; ++i)
+    {
+      for(int j = 0; j < 4; ++j)
+      {
+        auto [idx, tr] = storage->index(i, j);
+        FAST_CHECK_EQ(idx >= 0, shape.isNonZero(i, j));
+        if(idx < 0)
+          continue;
+        FAST_CHECK_EQ(storage->isStored(i, j), !tr);
+        FAST_CHECK_EQ(tr, (sym == SymmetricStorage::Lower && i < j) || (sym == SymmetricStorage::Upper && i > j));
+        if(tr)
+          FAST_CHECK_EQ(storage->index(j, i), std::make_pair(idx, false));
+        else
+          ++count[idx];
+      }
+    }
+    FAST_CHECK_EQ(std::count(count.begin(), count.end(), 1), storage->size());
+
+    // Elements are stored column by column
+    if(sym == SymmetricStorage::None)
+    {
+      FAST_CHECK_EQ(storage->index(3, 0).first, 2);
+      FAST_CHECK_EQ(storage->index(0, 1).first, 3);
+    }
+
+    // Line iterators against index
+    for(int i = 0; i < 4; ++i)
+    {
+      int n = 0;
+      for(const auto & e : storage->row(i))
+      {
+        const auto & res = storage->index(i, e.i);
+        FAST_CHECK_EQ(e, LIV{e.i, res.first, res.second});
+        ++n;
+      }
+      FAST_CHECK_EQ(n, shape.rowNNZ(i));
+      n = 0;
+      for(const auto & e : storage->col(i))
+      {
+        const auto & res = storage->index(e.i, i);
+        FAST_CHECK_EQ(e, LIV{e.i, res.first, res.second});
+        ++n;
+      }
+      FAST_CHECK_EQ(n, shape.colNNZ(i));
+    }
+  }
+
+  SparseShape nonSymmetric(3, 3, {{0, 1}, {1, 1}});
+  SparseStorageScheme storage(SymmetricStorage::Lower);
+  CHECK_THROWS(storage.setShape(nonSymmetric));
+}
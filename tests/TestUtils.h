@@ -0,0 +1,12 @@
+/** Copyright 2021 CNRS-AIST JRL*/
+
+#pragma once
+
+#include <mlsm/SimpleMatrix.h>
+
+/** Random n x n symmetric positive definite dense matrix.*/
+inline mls::MatrixPtr spd(int n)
+{
+  Eigen::MatrixXd M = Eigen::MatrixXd::Random(n, n);
+  return std::make_shared<mls::DenseMatrix>(M * M.transpose() + 4 * n * Eigen::MatrixXd::Identity(n, n), true);
+}